@@ -1,9 +1,36 @@
 #include "app/application.hpp"
 
 #include "app/main_window.hpp"
+#include "app/session_starter.hpp"
+
+#include <gdkmm/display.h>
+#include <gdkmm/monitor.h>
 
 namespace syzygy::app {
 
+namespace {
+
+// The window has no surface yet, so its monitor is unknown; the first one
+// is the best guess for MatchDisplay. Zero when there is none.
+double first_monitor_refresh_hz() {
+  auto display = Gdk::Display::get_default();
+  if (!display) {
+    return 0.0;
+  }
+  auto monitors = display->get_monitors();
+  if (!monitors) {
+    return 0.0;
+  }
+  auto monitor =
+      std::dynamic_pointer_cast<Gdk::Monitor>(monitors->get_object(0));
+  if (!monitor || monitor->get_refresh_rate() <= 0) {
+    return 0.0;
+  }
+  return static_cast<double>(monitor->get_refresh_rate()) / 1000.0;
+}
+
+}  // namespace
+
 Application::Application()
     : Gtk::Application("dev.zeocities.syzygy") {}
 
@@ -15,7 +42,11 @@ void Application::on_activate() {
   Gtk::Application::on_activate();
 
   if (!main_window_) {
-    main_window_ = new MainWindow();
+    // The last device opens and starts streaming while the widgets are
+    // built and the device scan runs.
+    main_window_ = new MainWindow(
+        settings_, SessionStarter::for_last_device(
+                       settings_, first_monitor_refresh_hz()));
     add_window(*main_window_);
     main_window_->set_icon_name("syzygy");
   }
@@ -2,6 +2,8 @@
 
 // Copyright (c) 2025 Zoe Gates <zoe@zeocities.dev>
 
+#include "settings/settings_manager.hpp"
+
 #include <gtkmm/application.h>
 
 namespace syzygy::app {
@@ -18,6 +20,7 @@ class Application : public Gtk::Application {
   static Glib::RefPtr<Application> create();
 
  private:
+  settings::SettingsManager settings_;
   MainWindow* main_window_{nullptr};
 };
 
@@ -0,0 +1,245 @@
+#include "app/compare_view.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+namespace syzygy::app {
+
+namespace {
+
+constexpr auto kReportInterval = std::chrono::seconds(1);
+
+std::string format_psnr(double db) {
+  if (std::isinf(db)) {
+    return "identical";
+  }
+  std::ostringstream text;
+  text << std::fixed << std::setprecision(1) << db << " dB";
+  return text.str();
+}
+
+}  // namespace
+
+CompareView::CompareView(const settings::SettingsManager& settings)
+    : Gtk::Box(Gtk::Orientation::VERTICAL, 6), settings_(settings) {
+  auto* pickers = Gtk::make_managed<Gtk::Box>(Gtk::Orientation::HORIZONTAL, 12);
+  const auto add_picker = [&](Side& side, const char* title) {
+    auto* column = Gtk::make_managed<Gtk::Box>(Gtk::Orientation::VERTICAL, 4);
+    auto* label = Gtk::make_managed<Gtk::Label>(title);
+    label->set_halign(Gtk::Align::START);
+    label->add_css_class("dim-label");
+    column->append(*label);
+    column->append(side.combo);
+    pickers->append(*column);
+    side.combo.signal_changed().connect(
+        sigc::mem_fun(*this, &CompareView::on_selection_changed));
+  };
+  add_picker(a_, "Input A");
+  add_picker(b_, "Input B");
+  append(*pickers);
+
+  auto* panes = Gtk::make_managed<Gtk::Box>(Gtk::Orientation::HORIZONTAL, 4);
+  panes->set_homogeneous(true);
+  panes->set_vexpand(true);
+  for (VideoWidget* video : {&a_.video, &b_.video, &heat_view_}) {
+    video->set_hexpand(true);
+    video->set_vexpand(true);
+    panes->append(*video);
+  }
+  a_.video.show_placeholder("No input selected");
+  b_.video.show_placeholder("No input selected");
+  heat_view_.show_placeholder("Differences appear here");
+  append(*panes);
+
+  stats_label_.set_halign(Gtk::Align::START);
+  stats_label_.add_css_class("dim-label");
+  append(stats_label_);
+
+  add_tick_callback(sigc::mem_fun(*this, &CompareView::on_tick));
+}
+
+CompareView::~CompareView() {
+  stop();
+}
+
+void CompareView::show_devices(
+    const std::vector<capture::CaptureDevice>& devices,
+    double display_refresh_hz) {
+  devices_ = devices;
+  display_refresh_hz_ = display_refresh_hz;
+
+  suppress_selection_ = true;
+  for (Side* side : {&a_, &b_}) {
+    const bool chosen = side->combo.get_active_row_number() >= 0;
+    const std::string previous = side->combo.get_active_id().raw();
+    side->combo.remove_all();
+    side->combo.append("", "None");
+    for (const auto& device : devices_) {
+      side->combo.append(device.path,
+                         device.name.empty() ? device.path : device.name);
+    }
+    const size_t fallback = side == &a_ ? 0 : 1;
+    const std::string wanted =
+        chosen ? previous
+               : (fallback < devices_.size() ? devices_[fallback].path : "");
+    if (!side->combo.set_active_id(wanted)) {
+      side->combo.set_active_id("");
+    }
+  }
+  suppress_selection_ = false;
+  on_selection_changed();
+}
+
+void CompareView::stop() {
+  comparator_.reset();
+  suppress_selection_ = true;
+  for (Side* side : {&a_, &b_}) {
+    retire(*side);
+    side->path.clear();
+    side->last_generation = 0;
+    side->combo.unset_active();
+    side->video.show_placeholder("No input selected");
+  }
+  suppress_selection_ = false;
+  last_pair_generation_ = 0;
+  heat_map_.reset();
+  heat_view_.show_placeholder("Differences appear here");
+  stats_label_.set_text("");
+}
+
+void CompareView::on_selection_changed() {
+  if (suppress_selection_) {
+    return;
+  }
+  const std::string path_a = a_.combo.get_active_id().raw();
+  const std::string path_b = b_.combo.get_active_id().raw();
+  start_side(a_, path_a);
+  // A node can only be streamed once.
+  if (!path_b.empty() && path_b == path_a) {
+    start_side(b_, "");
+    b_.video.show_placeholder("Same device as input A");
+    return;
+  }
+  start_side(b_, path_b);
+}
+
+void CompareView::start_side(Side& side, const std::string& path) {
+  if (side.path == path) {
+    return;
+  }
+  // The comparator reads from both sessions.
+  comparator_.reset();
+  last_pair_generation_ = 0;
+  heat_map_.reset();
+  heat_view_.show_placeholder("Differences appear here");
+
+  retire(side);
+  side.path = path;
+  side.last_generation = 0;
+  const auto device = std::find_if(
+      devices_.begin(), devices_.end(),
+      [&](const auto& candidate) { return candidate.path == path; });
+  if (path.empty() || device == devices_.end()) {
+    side.video.show_placeholder("No input selected");
+    return;
+  }
+  side.video.show_placeholder("Starting capture...");
+  // Full-size frames, held long enough to be matched against the other
+  // input.
+  side.starter = std::make_unique<SessionStarter>(
+      settings_, *device, display_refresh_hz_, nullptr,
+      capture::FrameComparator::kHeldFrames, grabs_);
+}
+
+void CompareView::retire(Side& side) {
+  if (side.starter || side.session) {
+    retirer_.retire(
+        std::make_pair(std::move(side.starter), std::move(side.session)));
+  }
+}
+
+bool CompareView::on_tick(const Glib::RefPtr<Gdk::FrameClock>&) {
+  update_side(a_);
+  update_side(b_);
+  const auto now = syzygy::clock::now();
+  if (!comparator_ && a_.session && b_.session) {
+    comparator_ =
+        std::make_unique<capture::FrameComparator>(*a_.session, *b_.session);
+    heat_view_.show_placeholder("Matching frames...");
+    last_report_ = now;
+  }
+
+  if (comparator_) {
+    const auto pair = comparator_->latest_pair();
+    if (pair.generation != last_pair_generation_) {
+      last_pair_generation_ = pair.generation;
+      a_.video.update_frame(pair.a);
+      b_.video.update_frame(pair.b);
+      if (pair.heat_map && pair.heat_map != heat_map_) {
+        heat_map_ = pair.heat_map;
+        heat_view_.show_snapshot(*heat_map_);
+      }
+    }
+  }
+
+  if (now - last_report_ >= kReportInterval) {
+    report();
+    last_report_ = now;
+  }
+  return true;
+}
+
+void CompareView::update_side(Side& side) {
+  if (side.starter) {
+    if (!side.starter->ready()) {
+      return;
+    }
+    side.session = side.starter->take_session();
+    side.starter.reset();
+    if (!side.session) {
+      side.video.show_placeholder("Unable to start capture");
+      return;
+    }
+  }
+  if (!side.session || comparator_) {
+    return;
+  }
+  const uint64_t generation = side.session->frame_generation();
+  if (generation == side.last_generation) {
+    return;
+  }
+  side.last_generation = generation;
+  if (const auto frame = side.session->latest_frame()) {
+    side.video.update_frame(frame);
+  }
+}
+
+void CompareView::report() {
+  if (!comparator_) {
+    stats_label_.set_text("Comparing needs two running inputs");
+    return;
+  }
+  const auto stats = comparator_->stats();
+  std::ostringstream text;
+  text.setf(std::ios::fixed);
+  if (!stats.valid) {
+    text << "Waiting for matching frames";
+  } else {
+    text << stats.pairs << " pairs  PSNR " << format_psnr(stats.psnr_db)
+         << " (worst " << format_psnr(stats.min_psnr_db)
+         << ")  max difference " << stats.max_abs_diff << " (worst "
+         << stats.worst_abs_diff << ")  B " << std::setprecision(1)
+         << std::abs(stats.offset_ms) << " ms "
+         << (stats.offset_ms >= 0.0 ? "behind" : "ahead of") << " A  "
+         << std::setprecision(2) << stats.compare_ms << " ms per pair";
+  }
+  if (stats.unmatched != 0 || stats.size_mismatches != 0) {
+    text << "  unmatched " << stats.unmatched << ", other size "
+         << stats.size_mismatches;
+  }
+  stats_label_.set_text(text.str());
+}
+
+}  // namespace syzygy::app
@@ -0,0 +1,81 @@
+#pragma once
+
+// Copyright (c) 2025 Zoe Gates <zoe@zeocities.dev>
+//
+// Two inputs side by side with a heat map of where they differ, e.g. the
+// same source through two capture paths. Frames are paired by content
+// within a capture-time window, and PSNR, the largest difference and the
+// time offset between the inputs are reported below.
+
+#include "app/retirer.hpp"
+#include "app/session_starter.hpp"
+#include "app/video_widget.hpp"
+#include "capture/capture_device.hpp"
+#include "capture/capture_session.hpp"
+#include "capture/frame_comparator.hpp"
+#include "settings/settings_manager.hpp"
+
+#include <gtkmm/box.h>
+#include <gtkmm/comboboxtext.h>
+#include <gtkmm/label.h>
+
+#include "syzygy/clock.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace syzygy::app {
+
+class CompareView : public Gtk::Box {
+ public:
+  explicit CompareView(const settings::SettingsManager& settings);
+  ~CompareView() override;
+
+  // Refreshes both pickers and starts whatever they select; by default the
+  // first two devices. A side whose device went away stops.
+  void show_devices(const std::vector<capture::CaptureDevice>& devices,
+                    double display_refresh_hz);
+  void stop();
+  // Sides wait for preview grabs of their device before opening it.
+  void set_grab_tracker(std::shared_ptr<capture::GrabTracker> grabs) {
+    grabs_ = std::move(grabs);
+  }
+
+ private:
+  struct Side {
+    Gtk::ComboBoxText combo;
+    VideoWidget video;
+    // The device being shown, or empty.
+    std::string path;
+    std::unique_ptr<SessionStarter> starter;
+    std::unique_ptr<capture::CaptureSession> session;
+    uint64_t last_generation{0};
+  };
+
+  void on_selection_changed();
+  void start_side(Side& side, const std::string& path);
+  // Stops the side's starter and session off the UI thread.
+  void retire(Side& side);
+  bool on_tick(const Glib::RefPtr<Gdk::FrameClock>& clock);
+  // Until the comparator runs, a side shows its own frames.
+  void update_side(Side& side);
+  void report();
+
+  const settings::SettingsManager& settings_;
+  Side a_;
+  Side b_;
+  VideoWidget heat_view_;
+  Gtk::Label stats_label_;
+  std::vector<capture::CaptureDevice> devices_;
+  double display_refresh_hz_{0.0};
+  std::shared_ptr<capture::GrabTracker> grabs_;
+  bool suppress_selection_{false};
+  std::unique_ptr<capture::FrameComparator> comparator_;
+  uint64_t last_pair_generation_{0};
+  std::shared_ptr<const capture::FrameSnapshot> heat_map_;
+  syzygy::clock::TimePoint last_report_;
+  Retirer retirer_;
+};
+
+}  // namespace syzygy::app
@@ -0,0 +1,248 @@
+#include "app/grid_view.hpp"
+
+#include "syzygy/log.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+#include <tuple>
+
+namespace syzygy::app {
+
+namespace {
+
+constexpr auto kReportInterval = std::chrono::seconds(1);
+
+}  // namespace
+
+GridView::GridView(const settings::SettingsManager& settings)
+    : Gtk::Box(Gtk::Orientation::VERTICAL, 6), settings_(settings) {
+  grid_.set_row_homogeneous(true);
+  grid_.set_column_homogeneous(true);
+  grid_.set_row_spacing(4);
+  grid_.set_column_spacing(4);
+  grid_.set_hexpand(true);
+  grid_.set_vexpand(true);
+  append(grid_);
+
+  summary_label_.set_halign(Gtk::Align::START);
+  summary_label_.add_css_class("dim-label");
+  append(summary_label_);
+
+  add_tick_callback(sigc::mem_fun(*this, &GridView::on_tick));
+}
+
+GridView::~GridView() {
+  stop();
+  retirer_.wait();
+}
+
+void GridView::show_devices(const std::vector<capture::CaptureDevice>& devices,
+                            double display_refresh_hz) {
+  if (!pool_) {
+    pool_ = std::make_shared<capture::ConversionPool>();
+  }
+
+  // Tiles whose device went away.
+  std::vector<std::unique_ptr<Tile>> gone;
+  for (auto it = tiles_.begin(); it != tiles_.end();) {
+    const bool present =
+        std::any_of(devices.begin(), devices.end(), [&](const auto& device) {
+          return device.path == (*it)->device.path;
+        });
+    if (present) {
+      ++it;
+      continue;
+    }
+    grid_.remove((*it)->overlay);
+    gone.push_back(std::move(*it));
+    it = tiles_.erase(it);
+  }
+  retire(std::move(gone));
+
+  for (const auto& device : devices) {
+    if (tiles_.size() >= kMaxTiles) {
+      syzygy::log::warn("GridView: showing the first", kMaxTiles, "of",
+                        devices.size(), "devices");
+      break;
+    }
+    const bool shown =
+        std::any_of(tiles_.begin(), tiles_.end(), [&](const auto& tile) {
+          return tile->device.path == device.path;
+        });
+    if (shown) {
+      continue;
+    }
+
+    auto tile = std::make_unique<Tile>();
+    tile->device = device;
+    tile->video.set_hexpand(true);
+    tile->video.set_vexpand(true);
+    tile->video.show_placeholder("Starting capture...");
+    tile->caption.set_text(device.name.empty() ? device.path : device.name);
+    tile->caption.set_halign(Gtk::Align::START);
+    tile->caption.set_valign(Gtk::Align::END);
+    tile->caption.set_margin(6);
+    tile->caption.add_css_class("osd");
+    tile->overlay.set_child(tile->video);
+    tile->overlay.add_overlay(tile->caption);
+    tile->starter = std::make_unique<SessionStarter>(
+        settings_, device, display_refresh_hz, pool_, 0, grabs_);
+    tiles_.push_back(std::move(tile));
+  }
+
+  layout_tiles();
+  report_began_ = syzygy::clock::now();
+  for (auto& tile : tiles_) {
+    tile->shown_at_report = tile->shown;
+    if (tile->session) {
+      tile->cpu_ms_at_report = tile_cpu_ms(*tile->session);
+    }
+  }
+}
+
+void GridView::stop() {
+  for (auto& tile : tiles_) {
+    grid_.remove(tile->overlay);
+  }
+  retire(std::move(tiles_), std::move(pool_));
+  tiles_.clear();
+  summary_label_.set_text("");
+}
+
+void GridView::retire(std::vector<std::unique_ptr<Tile>> tiles,
+                      std::shared_ptr<capture::ConversionPool> pool) {
+  // Up to nine sessions stopping would stall the UI; the widgets stay here.
+  std::vector<std::unique_ptr<SessionStarter>> starters;
+  std::vector<std::unique_ptr<capture::CaptureSession>> sessions;
+  for (auto& tile : tiles) {
+    if (tile->starter) {
+      starters.push_back(std::move(tile->starter));
+    }
+    if (tile->session) {
+      sessions.push_back(std::move(tile->session));
+    }
+  }
+  tiles.clear();
+  if (starters.empty() && sessions.empty() && !pool) {
+    return;
+  }
+  // Sessions hold the pool too, so it outlives them whatever the order.
+  retirer_.retire(std::make_tuple(std::move(starters), std::move(sessions),
+                                  std::move(pool)));
+}
+
+void GridView::layout_tiles() {
+  for (auto& tile : tiles_) {
+    if (tile->overlay.get_parent() != nullptr) {
+      grid_.remove(tile->overlay);
+    }
+  }
+  if (tiles_.empty()) {
+    return;
+  }
+  const auto columns = static_cast<int>(
+      std::ceil(std::sqrt(static_cast<double>(tiles_.size()))));
+  for (size_t i = 0; i < tiles_.size(); ++i) {
+    const int index = static_cast<int>(i);
+    grid_.attach(tiles_[i]->overlay, index % columns, index / columns);
+  }
+}
+
+bool GridView::on_tick(const Glib::RefPtr<Gdk::FrameClock>&) {
+  for (auto& tile : tiles_) {
+    update_tile(*tile);
+  }
+  if (!tiles_.empty() &&
+      syzygy::clock::now() - report_began_ >= kReportInterval) {
+    report(syzygy::clock::milliseconds_since(report_began_));
+    report_began_ = syzygy::clock::now();
+  }
+  return true;
+}
+
+void GridView::update_tile(Tile& tile) {
+  if (tile.starter) {
+    if (!tile.starter->ready()) {
+      return;
+    }
+    tile.session = tile.starter->take_session();
+    tile.starter.reset();
+    if (!tile.session) {
+      tile.video.show_placeholder("Unable to start capture");
+      return;
+    }
+    tile.cpu_ms_at_report = tile_cpu_ms(*tile.session);
+  }
+  if (!tile.session) {
+    return;
+  }
+
+  // Converting only what the tile shows is most of the saving; the
+  // session rounds this so resizing does not reallocate every frame.
+  const int scale = get_scale_factor();
+  tile.session->set_output_size(
+      static_cast<uint32_t>(std::max(0, tile.video.get_width() * scale)),
+      static_cast<uint32_t>(std::max(0, tile.video.get_height() * scale)));
+
+  const auto signal = tile.session->signal_state();
+  if (signal != tile.last_signal) {
+    tile.last_signal = signal;
+    if (signal == capture::SignalState::NoSignal) {
+      tile.video.show_placeholder("No signal");
+    }
+  }
+  const uint64_t generation = tile.session->frame_generation();
+  if (generation == tile.last_generation) {
+    return;
+  }
+  tile.last_generation = generation;
+  if (const auto frame = tile.session->latest_frame()) {
+    tile.video.update_frame(frame);
+    tile.shown++;
+  }
+}
+
+double GridView::tile_cpu_ms(const capture::CaptureSession& session) {
+  const auto stats = session.stats();
+  return stats.capture_cpu_ms + stats.convert_cpu_ms + stats.decoder.cpu_ms;
+}
+
+void GridView::report(double interval_ms) {
+  double total_percent = 0.0;
+  size_t streaming = 0;
+  for (auto& tile : tiles_) {
+    if (!tile->session) {
+      continue;
+    }
+    const double cpu_ms = tile_cpu_ms(*tile->session);
+    tile->cpu_percent =
+        std::max(0.0, cpu_ms - tile->cpu_ms_at_report) / interval_ms * 100.0;
+    tile->cpu_ms_at_report = cpu_ms;
+    const double fps = static_cast<double>(tile->shown -
+                                           tile->shown_at_report) *
+                       1000.0 / interval_ms;
+    tile->shown_at_report = tile->shown;
+    total_percent += tile->cpu_percent;
+    streaming++;
+
+    std::ostringstream caption;
+    caption.setf(std::ios::fixed);
+    caption << (tile->device.name.empty() ? tile->device.path
+                                          : tile->device.name)
+            << "  " << std::setprecision(0) << fps << " fps  "
+            << std::setprecision(1) << tile->cpu_percent << "% CPU";
+    tile->caption.set_text(caption.str());
+  }
+
+  std::ostringstream summary;
+  summary.setf(std::ios::fixed);
+  summary << streaming << " of " << tiles_.size() << " inputs streaming, "
+          << std::setprecision(1) << total_percent
+          << "% of one core in total; "
+          << (pool_ ? pool_->worker_count() : 0) << " conversion workers";
+  summary_label_.set_text(summary.str());
+}
+
+}  // namespace syzygy::app
@@ -0,0 +1,86 @@
+#pragma once
+
+// Copyright (c) 2025 Zoe Gates <zoe@zeocities.dev>
+//
+// Every capture device at once, tiled in a grid. All sessions convert on
+// one shared ConversionPool, each at its tile's on-screen size, and every
+// tile reports the CPU its input costs.
+
+#include "app/retirer.hpp"
+#include "app/session_starter.hpp"
+#include "app/video_widget.hpp"
+#include "capture/capture_device.hpp"
+#include "capture/capture_session.hpp"
+#include "capture/conversion_pool.hpp"
+#include "settings/settings_manager.hpp"
+
+#include <gtkmm/box.h>
+#include <gtkmm/grid.h>
+#include <gtkmm/label.h>
+#include <gtkmm/overlay.h>
+
+#include "syzygy/clock.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace syzygy::app {
+
+class GridView : public Gtk::Box {
+ public:
+  explicit GridView(const settings::SettingsManager& settings);
+  ~GridView() override;
+
+  // Starts a tile for each new device (up to kMaxTiles) and drops tiles
+  // whose device is gone; tiles that stay keep streaming.
+  void show_devices(const std::vector<capture::CaptureDevice>& devices,
+                    double display_refresh_hz);
+  void stop();
+  bool running() const noexcept { return !tiles_.empty(); }
+  // Tiles wait for preview grabs of their device before opening it.
+  void set_grab_tracker(std::shared_ptr<capture::GrabTracker> grabs) {
+    grabs_ = std::move(grabs);
+  }
+
+  static constexpr size_t kMaxTiles = 9;
+
+ private:
+  struct Tile {
+    capture::CaptureDevice device;
+    std::unique_ptr<SessionStarter> starter;
+    std::unique_ptr<capture::CaptureSession> session;
+    // Owned here rather than by the grid, so re-laying out the grid does
+    // not destroy them.
+    Gtk::Overlay overlay;
+    VideoWidget video;
+    Gtk::Label caption;
+    uint64_t last_generation{0};
+    capture::SignalState last_signal{capture::SignalState::Unknown};
+    uint64_t shown{0};
+    // Counts at the start of the current report interval.
+    uint64_t shown_at_report{0};
+    double cpu_ms_at_report{0.0};
+    double cpu_percent{0.0};
+  };
+
+  void layout_tiles();
+  bool on_tick(const Glib::RefPtr<Gdk::FrameClock>& clock);
+  void update_tile(Tile& tile);
+  void report(double interval_ms);
+  static double tile_cpu_ms(const capture::CaptureSession& session);
+  // Destroys the tiles' widgets here and stops their starters and
+  // sessions, and `pool` when given, on a worker thread.
+  void retire(std::vector<std::unique_ptr<Tile>> tiles,
+              std::shared_ptr<capture::ConversionPool> pool = {});
+
+  const settings::SettingsManager& settings_;
+  Gtk::Grid grid_;
+  Gtk::Label summary_label_;
+  std::shared_ptr<capture::ConversionPool> pool_;
+  std::shared_ptr<capture::GrabTracker> grabs_;
+  std::vector<std::unique_ptr<Tile>> tiles_;
+  syzygy::clock::TimePoint report_began_;
+  Retirer retirer_;
+};
+
+}  // namespace syzygy::app
@@ -1,5 +1,8 @@
 #include "app/main_window.hpp"
 
+#include "capture/edid.hpp"
+#include "capture/frame_snapshot.hpp"
+
 #include "syzygy/log.hpp"
 
 #include <algorithm>
@@ -9,18 +12,70 @@
 #include <gdkmm/display.h>
 #include <gdkmm/monitor.h>
 #include <giomm/listmodel.h>
+#include <glibmm/bytes.h>
 #include <glibmm/main.h>
 #include <gtkmm/separator.h>
 #include <iomanip>
 #include <memory>
 #include <sstream>
+#include <utility>
 #include <sigc++/sigc++.h>
 
 namespace syzygy::app {
 
-MainWindow::MainWindow()
+namespace {
+
+const char* policy_title(capture::ModePolicy policy) {
+  switch (policy) {
+    case capture::ModePolicy::LowestLatency:
+      return "Lowest latency";
+    case capture::ModePolicy::MatchDisplay:
+      return "Match display";
+    case capture::ModePolicy::MaxQuality:
+    default:
+      return "Max quality";
+  }
+}
+
+const char* preset_title(capture::LatencyPreset preset) {
+  switch (preset) {
+    case capture::LatencyPreset::UltraLow:
+      return "Ultra low (2 buffers)";
+    case capture::LatencyPreset::Balanced:
+      return "Balanced (4 buffers)";
+    case capture::LatencyPreset::Safe:
+      return "Safe (6 buffers)";
+    case capture::LatencyPreset::Adaptive:
+    default:
+      return "Adaptive";
+  }
+}
+
+// Wide enough to fill the window at startup without a slow save on exit.
+constexpr uint32_t kSnapshotWidth = 640;
+
+// Device picker previews; small enough that a grab decodes in a few ms.
+constexpr uint32_t kThumbnailWidth = 160;
+
+// An incoming device that shows nothing for this long replaces the current
+// one anyway, so a dead input cannot block switching away.
+constexpr auto kSwitchTimeout = std::chrono::seconds(3);
+
+// How long a resumed device's audio node is waited for.
+constexpr int kAudioRematchAttempts = 10;
+constexpr auto kAudioRematchInterval = std::chrono::milliseconds(500);
+
+}  // namespace
+
+MainWindow::MainWindow(settings::SettingsManager& settings,
+                       std::unique_ptr<SessionStarter> fast_start)
     : Gtk::ApplicationWindow(),
-      capture_session_() {
+      grid_view_(settings),
+      compare_view_(settings),
+      settings_(settings),
+      capture_session_(std::make_unique<capture::CaptureSession>()),
+      fast_start_(std::move(fast_start)),
+      audio_controller_(std::make_unique<audio::PipeWireController>()) {
   set_title("Syzygy Preview");
   set_default_size(1280, 720);
 
@@ -37,10 +92,44 @@ MainWindow::MainWindow()
   add_controller(key_controller_);
 
   build_ui();
+  install_session_callbacks();
   volume_scale_.set_value(settings_.data().audio_gain);
-  audio_controller_.set_gain(static_cast<float>(settings_.data().audio_gain));
+  audio_controller_->set_gain(static_cast<float>(settings_.data().audio_gain));
+
+  thumbnail_service_ = std::make_unique<capture::ThumbnailService>(
+      kThumbnailWidth,
+      [this](const std::string& path, capture::ThumbnailResult result) {
+        Glib::signal_idle().connect_once(
+            [this, path, result = std::move(result)]() {
+              apply_thumbnail(path, result);
+            });
+      });
+  grid_view_.set_grab_tracker(thumbnail_service_->grabs());
+  compare_view_.set_grab_tracker(thumbnail_service_->grabs());
+  if (fast_start_) {
+    set_live_device(fast_start_->device_path());
+  }
 
   update_fullscreen_ui();
+  device_enumerator_ = std::make_unique<capture::DeviceEnumerator>(
+      [this](std::vector<capture::CaptureDevice> devices) {
+        Glib::signal_idle().connect_once(
+            [this, devices = std::move(devices)]() {
+              apply_device_list(devices);
+            });
+      });
+  first_frame_wait_began_ =
+      fast_start_ ? fast_start_->began() : syzygy::clock::now();
+  if (fast_start_) {
+    if (const auto snapshot = capture::load_snapshot(
+            last_frame_path(), fast_start_->device_path())) {
+      video_widget_.show_snapshot(*snapshot);
+    } else {
+      video_widget_.show_placeholder("Starting capture...");
+    }
+  } else {
+    video_widget_.show_placeholder("Looking for capture devices...");
+  }
   refresh_device_list(true);
   audio_status_label_.set_text("Audio: idle");
   capture_stats_label_.set_text("Resolution: —");
@@ -48,15 +137,32 @@ MainWindow::MainWindow()
 
   add_tick_callback(sigc::mem_fun(*this, &MainWindow::on_frame_tick));
 
-  device_monitor_ = std::make_unique<capture::DeviceMonitor>([this]() {
-    Glib::signal_idle().connect_once(
-        sigc::bind(sigc::mem_fun(*this, &MainWindow::refresh_device_list), false));
-  });
+  device_monitor_ = std::make_unique<capture::DeviceMonitor>(
+      [this](const capture::DeviceEvent& event) {
+        Glib::signal_idle().connect_once(
+            [this, event]() { on_device_event(event); });
+      });
 }
 
 MainWindow::~MainWindow() {
-  capture_session_.stop();
-  audio_controller_.stop();
+  thumbnail_service_.reset();
+  grid_view_.stop();
+  compare_view_.stop();
+  device_monitor_.reset();
+  device_enumerator_.reset();
+  fast_start_.reset();
+  incoming_.reset();
+  audio_rematch_.reset();
+  retirer_.wait();
+  if (capture_session_->is_running()) {
+    if (const auto frame = capture_session_->latest_frame()) {
+      capture::save_snapshot(capture::make_snapshot(*frame, kSnapshotWidth),
+                             capture_session_->device_path(),
+                             last_frame_path());
+    }
+  }
+  capture_session_->stop();
+  audio_controller_->stop();
 }
 
 void MainWindow::build_ui() {
@@ -78,12 +184,101 @@ void MainWindow::build_ui() {
   device_column->append(device_combo_);
 
   control_bar_.append(*device_column);
+
+  auto* edid_column =
+      Gtk::make_managed<Gtk::Box>(Gtk::Orientation::VERTICAL, 4);
+  auto* edid_label = Gtk::make_managed<Gtk::Label>("Advertised modes");
+  edid_label->set_halign(Gtk::Align::START);
+  edid_label->add_css_class("dim-label");
+  edid_column->append(*edid_label);
+  edid_combo_.set_sensitive(false);
+  edid_column->append(edid_combo_);
+  control_bar_.append(*edid_column);
+
+  auto* policy_column =
+      Gtk::make_managed<Gtk::Box>(Gtk::Orientation::VERTICAL, 4);
+  auto* policy_label = Gtk::make_managed<Gtk::Label>("Mode policy");
+  policy_label->set_halign(Gtk::Align::START);
+  policy_label->add_css_class("dim-label");
+  policy_column->append(*policy_label);
+  for (const auto policy :
+       {capture::ModePolicy::MaxQuality, capture::ModePolicy::LowestLatency,
+        capture::ModePolicy::MatchDisplay}) {
+    policy_combo_.append(std::string(capture::to_string(policy)),
+                         policy_title(policy));
+  }
+  policy_column->append(policy_combo_);
+  control_bar_.append(*policy_column);
+
+  auto* preset_column =
+      Gtk::make_managed<Gtk::Box>(Gtk::Orientation::VERTICAL, 4);
+  auto* preset_label = Gtk::make_managed<Gtk::Label>("Latency");
+  preset_label->set_halign(Gtk::Align::START);
+  preset_label->add_css_class("dim-label");
+  preset_column->append(*preset_label);
+  for (const auto preset :
+       {capture::LatencyPreset::Adaptive, capture::LatencyPreset::UltraLow,
+        capture::LatencyPreset::Balanced, capture::LatencyPreset::Safe}) {
+    preset_combo_.append(std::string(capture::to_string(preset)),
+                         preset_title(preset));
+  }
+  preset_combo_.set_active_id(
+      std::string(capture::to_string(settings_.data().latency_preset)));
+  preset_column->append(preset_combo_);
+  control_bar_.append(*preset_column);
+
+  auto* userptr_column =
+      Gtk::make_managed<Gtk::Box>(Gtk::Orientation::VERTICAL, 4);
+  auto* userptr_label = Gtk::make_managed<Gtk::Label>("Hugepage buffers");
+  userptr_label->set_halign(Gtk::Align::START);
+  userptr_label->add_css_class("dim-label");
+  userptr_column->append(*userptr_label);
+  userptr_switch_.set_halign(Gtk::Align::START);
+  userptr_switch_.set_active(settings_.data().userptr_capture);
+  userptr_column->append(userptr_switch_);
+  control_bar_.append(*userptr_column);
+
+  auto* thumbnails_column =
+      Gtk::make_managed<Gtk::Box>(Gtk::Orientation::VERTICAL, 4);
+  auto* thumbnails_label = Gtk::make_managed<Gtk::Label>("Previews");
+  thumbnails_label->set_halign(Gtk::Align::START);
+  thumbnails_label->add_css_class("dim-label");
+  thumbnails_column->append(*thumbnails_label);
+  thumbnails_switch_.set_halign(Gtk::Align::START);
+  thumbnails_switch_.set_active(settings_.data().thumbnails);
+  thumbnails_column->append(thumbnails_switch_);
+  control_bar_.append(*thumbnails_column);
+
+  auto* view_column =
+      Gtk::make_managed<Gtk::Box>(Gtk::Orientation::VERTICAL, 4);
+  auto* view_label = Gtk::make_managed<Gtk::Label>("View");
+  view_label->set_halign(Gtk::Align::START);
+  view_label->add_css_class("dim-label");
+  view_column->append(*view_label);
+  view_combo_.append("single", "Single input");
+  view_combo_.append("grid", "All inputs");
+  view_combo_.append("compare", "Compare two");
+  view_combo_.set_active_id("single");
+  view_column->append(view_combo_);
+  control_bar_.append(*view_column);
   root_.append(control_bar_);
 
+  thumbnail_strip_.set_spacing(8);
+  thumbnail_scroller_.set_policy(Gtk::PolicyType::AUTOMATIC,
+                                 Gtk::PolicyType::NEVER);
+  thumbnail_scroller_.set_child(thumbnail_strip_);
+  root_.append(thumbnail_scroller_);
+
   video_widget_.set_hexpand(true);
   video_widget_.set_vexpand(true);
   video_widget_.show_placeholder("Awaiting capture frame...");
-  root_.append(video_widget_);
+  video_stack_.set_hexpand(true);
+  video_stack_.set_vexpand(true);
+  video_stack_.add(video_widget_, "single");
+  video_stack_.add(grid_view_, "grid");
+  video_stack_.add(compare_view_, "compare");
+  video_stack_.set_visible_child(video_widget_);
+  root_.append(video_stack_);
 
   auto* separator = Gtk::make_managed<Gtk::Separator>(Gtk::Orientation::HORIZONTAL);
   separator->set_margin_top(8);
@@ -129,12 +324,47 @@ void MainWindow::build_ui() {
 
   device_combo_.signal_changed().connect(
       sigc::mem_fun(*this, &MainWindow::on_device_changed));
+  edid_combo_.signal_changed().connect(
+      sigc::mem_fun(*this, &MainWindow::on_edid_changed));
+  policy_combo_.signal_changed().connect(
+      sigc::mem_fun(*this, &MainWindow::on_policy_changed));
+  preset_combo_.signal_changed().connect(
+      sigc::mem_fun(*this, &MainWindow::on_preset_changed));
+  userptr_switch_.property_active().signal_changed().connect(
+      sigc::mem_fun(*this, &MainWindow::on_userptr_toggled));
   volume_scale_.signal_value_changed().connect(
       sigc::mem_fun(*this, &MainWindow::on_volume_changed));
+  thumbnails_switch_.property_active().signal_changed().connect(
+      sigc::mem_fun(*this, &MainWindow::on_thumbnails_toggled));
+  view_combo_.signal_changed().connect(
+      sigc::mem_fun(*this, &MainWindow::on_view_changed));
 }
 
 void MainWindow::refresh_device_list(bool restart_stream) {
-  devices_ = capture::enumerate_devices();
+  restart_after_scan_ = restart_after_scan_ || restart_stream;
+  device_enumerator_->request();
+}
+
+void MainWindow::apply_device_list(
+    std::vector<capture::CaptureDevice> devices) {
+  // A live node missing from the scan was unplugged, whether or not its
+  // remove event was seen.
+  if (single_view() && !lost_device_ && !fast_start_ && !incoming_ &&
+      capture_session_->is_running() &&
+      std::none_of(devices.begin(), devices.end(), [&](const auto& device) {
+        return device.path == capture_session_->device_path();
+      })) {
+    mark_device_lost(capture_session_->device_path());
+  }
+  devices_ = std::move(devices);
+  thumbnail_service_->set_devices(devices_);
+  rebuild_thumbnails();
+  const std::string view = view_combo_.get_active_id().raw();
+  if (view == "grid") {
+    grid_view_.show_devices(devices_, 1000.0 / monitor_interval_ms_);
+  } else if (view == "compare") {
+    compare_view_.show_devices(devices_, 1000.0 / monitor_interval_ms_);
+  }
   const auto previous_id = device_combo_.get_active_id();
 
   suppress_device_callback_ = true;
@@ -150,26 +380,419 @@ void MainWindow::refresh_device_list(bool restart_stream) {
     desired = previous_id;
   }
 
+  const capture::CaptureDevice* returned = find_returned_device();
+  if (returned) {
+    desired = returned->path;
+  }
+
   if (!desired.empty()) {
     device_combo_.set_active_id(desired);
   } else if (!devices_.empty()) {
     device_combo_.set_active(0);
   }
   suppress_device_callback_ = false;
-  if (restart_stream) {
+  devices_scanned_ = true;
+  if (returned) {
+    // Resuming starts the device; nothing is left for finish_startup().
+    restart_after_scan_ = false;
+    resume_device(*returned);
+    return;
+  }
+  // With a fast start still opening the device, adopt_fast_start() picks
+  // this up instead.
+  if (!fast_start_) {
+    finish_startup();
+  }
+}
+
+void MainWindow::install_session_callbacks() {
+  // Frames resuming overwrite the label through update_capture_stats().
+  capture_session_->set_recovery_callback(
+      [this](const capture::RecoveryEvent&) {
+        Glib::signal_idle().connect_once([this]() {
+          capture_stats_label_.set_text("Capture stalled, recovering...");
+        });
+      });
+}
+
+// A preset picked while a session was still starting only reached the
+// session it replaces.
+void MainWindow::apply_saved_preset() {
+  const auto preset = settings_.data().latency_preset;
+  if (capture_session_->latency_preset() != preset) {
+    capture_session_->set_latency_preset(preset);
+  }
+}
+
+void MainWindow::adopt_fast_start() {
+  auto session = fast_start_->take_session();
+  fast_start_.reset();
+  // A device picked by hand in the meantime wins over the fast start.
+  if (session && !capture_session_->is_running()) {
+    capture_session_ = std::move(session);
+    install_session_callbacks();
+    apply_saved_preset();
+    update_monitor_interval();
+  }
+  if (devices_scanned_) {
+    finish_startup();
+  }
+}
+
+void MainWindow::finish_startup() {
+  if (!std::exchange(restart_after_scan_, false)) {
+    return;
+  }
+  const std::string id = device_combo_.get_active_id().raw();
+  if (id.empty() || !capture_session_->is_running() ||
+      capture_session_->device_path() != id) {
     start_current_device();
+    return;
   }
+
+  // The fast-started session already runs on the selected device; only the
+  // parts that needed the scan are left.
+  const capture::CaptureDevice* device = find_device(id);
+  update_edid_choices(device);
+  sync_policy_combo(capture_session_->mode_policy());
+  on_capture_started(id, device);
+  show_audio_route(start_audio_route(*audio_controller_, device));
+}
+
+void MainWindow::sync_policy_combo(capture::ModePolicy policy) {
+  suppress_device_callback_ = true;
+  policy_combo_.set_active_id(std::string(capture::to_string(policy)));
+  suppress_device_callback_ = false;
+}
+
+void MainWindow::begin_switch(const std::string& id,
+                              const capture::CaptureDevice* device) {
+  cancel_switch();
+  syzygy::log::info("Preparing capture device", id);
+
+  capture::CaptureDevice target{};
+  if (device) {
+    target = *device;
+  } else {
+    target.path = id;
+  }
+  update_edid_choices(device);
+  sync_policy_combo(saved_mode_policy(settings_, device));
+  set_live_device(id);
+
+  incoming_ = std::make_unique<CaptureRoute>();
+  incoming_->id = id;
+  incoming_->began = syzygy::clock::now();
+  incoming_->starter = std::make_unique<SessionStarter>(
+      settings_, target, 1000.0 / monitor_interval_ms_, nullptr, 0,
+      thumbnail_service_->grabs());
+  // Silent until the swap; both routes play for a moment otherwise.
+  incoming_->audio = std::make_unique<audio::PipeWireController>();
+  incoming_->audio->set_gain(0.0f);
+  incoming_->audio_started =
+      std::async(std::launch::async,
+                 [audio = incoming_->audio.get(), target]() {
+                   return start_audio_route(*audio, &target);
+                 });
+  capture_stats_label_.set_text("Switching...");
+}
+
+void MainWindow::advance_switch() {
+  if (incoming_->starter) {
+    if (!incoming_->starter->ready()) {
+      return;
+    }
+    incoming_->session = incoming_->starter->take_session();
+    incoming_->starter.reset();
+    if (!incoming_->session) {
+      // Two devices at once may not fit, e.g. on one USB bus; close the
+      // current device first and try again the slow way.
+      syzygy::log::warn("Unable to open", incoming_->id,
+                        "alongside the current device; switching directly");
+      retire(std::move(incoming_));
+      capture_session_->stop();
+      start_current_device();
+      return;
+    }
+    incoming_->session->set_display_refresh_hz(1000.0 / monitor_interval_ms_);
+  }
+
+  // The swap needs the audio route; checked here so the UI never waits.
+  if (incoming_->audio_started.wait_for(std::chrono::seconds(0)) !=
+      std::future_status::ready) {
+    return;
+  }
+  const bool first_frame = incoming_->session->frame_generation() != 0;
+  const bool no_signal =
+      incoming_->session->signal_state() == capture::SignalState::NoSignal;
+  if (first_frame || no_signal ||
+      syzygy::clock::now() - incoming_->began > kSwitchTimeout) {
+    complete_switch();
+  }
+}
+
+void MainWindow::complete_switch() {
+  auto incoming = std::move(incoming_);
+  const bool first_frame = incoming->session->frame_generation() != 0;
+  syzygy::log::info("Switched to", incoming->id,
+                    first_frame ? "first frame after" : "without a frame after",
+                    syzygy::clock::milliseconds_since(incoming->began), "ms");
+
+  const AudioRoute audio = incoming->audio_started.get();
+  auto outgoing = std::make_unique<CaptureRoute>();
+  outgoing->id = capture_session_->device_path();
+  outgoing->session = std::exchange(capture_session_,
+                                    std::move(incoming->session));
+  outgoing->audio = std::exchange(audio_controller_,
+                                  std::move(incoming->audio));
+  install_session_callbacks();
+  apply_saved_preset();
+  retire(std::move(outgoing));
+
+  last_frame_generation_ = 0;
+  last_signal_state_ = capture::SignalState::Unknown;
+  reset_video_timeline();
+  on_capture_started(incoming->id, find_device(incoming->id));
+  show_audio_route(audio);
+}
+
+void MainWindow::cancel_switch() {
+  if (incoming_) {
+    syzygy::log::info("Abandoning switch to", incoming_->id);
+    retire(std::move(incoming_));
+    set_live_device(capture_session_->is_running()
+                        ? capture_session_->device_path()
+                        : std::string());
+  }
+}
+
+void MainWindow::retire(std::unique_ptr<CaptureRoute> route) {
+  retirer_.retire(std::move(route));
+}
+
+void MainWindow::on_device_event(const capture::DeviceEvent& event) {
+  using Action = capture::DeviceEvent::Action;
+  if (event.action == Action::Remove && single_view() && !fast_start_ &&
+      !incoming_ && !lost_device_ && capture_session_->is_running() &&
+      event.node == capture_session_->device_path()) {
+    mark_device_lost(event.node);
+  } else if (event.action == Action::Add && lost_device_ &&
+             !event.node.empty()) {
+    lost_device_->added.emplace(event.node, event.time);
+  }
+  refresh_device_list(false);
+}
+
+void MainWindow::mark_device_lost(const std::string& path) {
+  capture::CaptureDevice known{};
+  known.path = path;
+  if (const auto* device = find_device(path)) {
+    known = *device;
+  }
+  lost_device_ = LostDevice{};
+  lost_device_->identity = capture::device_identity(known);
+  lost_device_->bus = known.bus;
+  lost_device_->name = known.name.empty() ? path : known.name;
+  syzygy::log::info("Capture device", path, "disconnected; waiting for",
+                    lost_device_->identity);
+
+  // The session would otherwise keep reopening a node that is gone, or
+  // that now belongs to another device.
+  capture_session_->stop();
+  set_live_device({});
+  audio_controller_->stop();
+  audio_rematch_.reset();
+  reset_video_timeline();
+  video_widget_.show_placeholder(lost_device_->name +
+                                 " disconnected; waiting for it to return");
+  capture_stats_label_.set_text("Device disconnected");
+  audio_status_label_.set_text("Audio: idle");
+  audio_level_smooth_ = 0.0;
+  audio_level_bar_.set_value(0.0);
+  audio_using_fallback_ = false;
+}
+
+const capture::CaptureDevice* MainWindow::find_returned_device() const {
+  if (!lost_device_ || !single_view()) {
+    return nullptr;
+  }
+  const capture::CaptureDevice* match = nullptr;
+  for (const auto& device : devices_) {
+    if (capture::device_identity(device) != lost_device_->identity) {
+      continue;
+    }
+    // Same serial in the same port is certainly it.
+    if (device.bus == lost_device_->bus) {
+      return &device;
+    }
+    if (!match) {
+      match = &device;
+    }
+  }
+  return match;
+}
+
+void MainWindow::resume_device(const capture::CaptureDevice& device) {
+  const auto added = lost_device_->added.find(device.path);
+  resume_began_ = added != lost_device_->added.end()
+                      ? added->second
+                      : syzygy::clock::now();
+  syzygy::log::info("Capture device", lost_device_->identity, "is back as",
+                    device.path, "; resuming");
+  // Opens with the cached capabilities and the device's saved policy,
+  // EDID and audio route, like any other start.
+  start_current_device();
+  if (capture_session_->is_running() && audio_using_fallback_) {
+    audio_rematch_.emplace();
+    audio_rematch_->id = device.path;
+    audio_rematch_->attempts_left = kAudioRematchAttempts;
+    audio_rematch_->next_attempt =
+        syzygy::clock::now() + kAudioRematchInterval;
+  }
+}
+
+void MainWindow::advance_audio_rematch() {
+  if (!audio_rematch_) {
+    return;
+  }
+  AudioRematch& rematch = *audio_rematch_;
+  if (!audio_using_fallback_ || !capture_session_->is_running() ||
+      capture_session_->device_path() != rematch.id) {
+    audio_rematch_.reset();
+    return;
+  }
+  if (!rematch.started.valid()) {
+    if (syzygy::clock::now() < rematch.next_attempt) {
+      return;
+    }
+    const capture::CaptureDevice* device = find_device(rematch.id);
+    if (!device) {
+      audio_rematch_.reset();
+      return;
+    }
+    rematch.audio = std::make_unique<audio::PipeWireController>();
+    rematch.audio->set_gain(0.0f);
+    rematch.started = std::async(
+        std::launch::async,
+        [audio = rematch.audio.get(), target = *device]() {
+          return start_audio_route(*audio, &target);
+        });
+    return;
+  }
+  if (rematch.started.wait_for(std::chrono::seconds(0)) !=
+      std::future_status::ready) {
+    return;
+  }
+
+  const AudioRoute route = rematch.started.get();
+  if (route.started && !route.fallback) {
+    syzygy::log::info("Capture audio for", rematch.id,
+                      "appeared; leaving the default route");
+    audio_controller_->stop();
+    audio_controller_ = std::move(rematch.audio);
+    audio_rematch_.reset();
+    show_audio_route(route);
+    return;
+  }
+  rematch.audio.reset();
+  if (--rematch.attempts_left <= 0) {
+    syzygy::log::warn("No capture audio for", rematch.id,
+                      "after resuming; keeping the default route");
+    audio_rematch_.reset();
+    return;
+  }
+  rematch.next_attempt = syzygy::clock::now() + kAudioRematchInterval;
+}
+
+void MainWindow::rebuild_thumbnails() {
+  for (const auto& [path, tile] : thumbnail_tiles_) {
+    thumbnail_strip_.remove(*tile.button);
+  }
+  thumbnail_tiles_.clear();
+
+  for (const auto& device : devices_) {
+    ThumbnailTile tile{};
+    tile.name = device.name.empty() ? device.path : device.name;
+    tile.picture = Gtk::make_managed<Gtk::Picture>();
+    tile.picture->set_size_request(kThumbnailWidth, kThumbnailWidth * 9 / 16);
+    tile.picture->set_can_shrink(true);
+    tile.caption = Gtk::make_managed<Gtk::Label>(
+        device.path == live_device_ ? tile.name + " (live)" : tile.name);
+    tile.caption->set_ellipsize(Pango::EllipsizeMode::END);
+    tile.caption->set_max_width_chars(20);
+
+    auto* column = Gtk::make_managed<Gtk::Box>(Gtk::Orientation::VERTICAL, 4);
+    column->append(*tile.picture);
+    column->append(*tile.caption);
+    tile.button = Gtk::make_managed<Gtk::Button>();
+    tile.button->add_css_class("flat");
+    tile.button->set_tooltip_text(device.path);
+    tile.button->set_child(*column);
+    tile.button->signal_clicked().connect(
+        [this, path = device.path]() { device_combo_.set_active_id(path); });
+    thumbnail_strip_.append(*tile.button);
+    thumbnail_tiles_.emplace(device.path, tile);
+  }
+}
+
+void MainWindow::apply_thumbnail(const std::string& path,
+                                 const capture::ThumbnailResult& result) {
+  const auto it = thumbnail_tiles_.find(path);
+  if (it == thumbnail_tiles_.end() || path == live_device_) {
+    return;
+  }
+  ThumbnailTile& tile = it->second;
+  if (result.status != capture::ThumbnailStatus::Ok) {
+    tile.caption->set_text(tile.name + " (" +
+                           std::string(capture::to_string(result.status)) +
+                           ")");
+    // A busy device keeps its last picture; a dead input shows nothing.
+    if (result.status == capture::ThumbnailStatus::NoSignal) {
+      tile.picture->set_paintable(nullptr);
+    }
+    return;
+  }
+  const auto& image = result.image;
+  auto bytes = Glib::Bytes::create(image.rgb.data(), image.rgb.size());
+  tile.picture->set_paintable(Gdk::MemoryTexture::create(
+      image.width, image.height, Gdk::MemoryTexture::Format::R8G8B8, bytes,
+      image.width * 3));
+  tile.caption->set_text(tile.name);
+}
+
+void MainWindow::set_live_device(const std::string& path) {
+  live_device_ = path;
+  thumbnail_service_->set_active_device(path);
+  for (const auto& [tile_path, tile] : thumbnail_tiles_) {
+    tile.caption->set_text(tile_path == path ? tile.name + " (live)"
+                                             : tile.name);
+  }
+}
+
+void MainWindow::update_thumbnail_service() {
+  // The other views already show their devices live.
+  const bool enabled =
+      settings_.data().thumbnails && !fullscreen_ && single_view();
+  thumbnail_scroller_.set_visible(enabled);
+  thumbnail_service_->set_enabled(enabled);
 }
 
 void MainWindow::start_current_device() {
-  if (suppress_device_callback_) {
+  if (suppress_device_callback_ || !single_view()) {
     return;
   }
 
+  // Whatever is picked now replaces a device waiting to come back.
+  lost_device_.reset();
+  audio_rematch_.reset();
+
   const Glib::ustring active_id = device_combo_.get_active_id();
   if (active_id.empty()) {
-    capture_session_.stop();
-    audio_controller_.stop();
+    cancel_switch();
+    update_edid_choices(nullptr);
+    capture_session_->stop();
+    set_live_device({});
+    audio_controller_->stop();
     video_widget_.show_placeholder("Select a capture device");
     reset_video_timeline();
     audio_status_label_.set_text("Audio: idle");
@@ -184,13 +807,36 @@ void MainWindow::start_current_device() {
   }
 
   const std::string id = active_id.raw();
+  const capture::CaptureDevice* device = find_device(id);
+  if (capture_session_->is_running()) {
+    if (capture_session_->device_path() != id) {
+      begin_switch(id, device);
+      return;
+    }
+    // Picked the live device again before a switch away from it finished.
+    if (incoming_) {
+      cancel_switch();
+      update_edid_choices(device);
+      sync_policy_combo(capture_session_->mode_policy());
+      capture_stats_label_.set_text("Awaiting frames...");
+      return;
+    }
+  }
+  cancel_switch();
 
-  audio_controller_.stop();
+  audio_controller_->stop();
   reset_video_timeline();
 
   syzygy::log::info("Switching capture device", id);
-  constexpr auto preset = capture::LatencyPreset::UltraLow;
-  if (!capture_session_.start(id, preset)) {
+  update_edid_choices(device);
+  const auto preset = settings_.data().latency_preset;
+  apply_session_settings(*capture_session_, settings_, device);
+  sync_policy_combo(capture_session_->mode_policy());
+  update_monitor_interval();
+  set_live_device(id);
+  thumbnail_service_->grabs()->wait_released(id);
+  if (!capture_session_->start(id, preset)) {
+    set_live_device({});
     video_widget_.show_placeholder("Unable to start capture");
     capture_stats_label_.set_text("Capture unavailable");
     audio_status_label_.set_text("Audio: idle");
@@ -202,7 +848,12 @@ void MainWindow::start_current_device() {
     }
     return;
   }
+  on_capture_started(id, device);
+  show_audio_route(start_audio_route(*audio_controller_, device));
+}
 
+void MainWindow::on_capture_started(const std::string& id,
+                                    const capture::CaptureDevice* device) {
   settings_.set_last_video_device(id);
   if (title_label_) {
     std::string heading = "Syzygy";
@@ -213,62 +864,85 @@ void MainWindow::start_current_device() {
     title_label_->set_text(heading);
   }
   capture_stats_label_.set_text("Awaiting frames...");
-  audio_status_label_.set_text("Audio: connecting...");
+}
+
+MainWindow::AudioRoute MainWindow::start_audio_route(
+    audio::PipeWireController& audio, const capture::CaptureDevice* device) {
+  AudioRoute route{};
   std::optional<std::string> bus_path;
   std::optional<std::string> label;
-  const auto it = std::find_if(devices_.begin(), devices_.end(),
-                               [&](const capture::CaptureDevice& device) {
-                                 return device.path == id;
-                               });
-  if (it != devices_.end()) {
-    if (!it->bus.empty()) {
-      bus_path = it->bus;
+  if (device) {
+    if (!device->bus.empty()) {
+      bus_path = device->bus;
     }
-    if (!it->name.empty()) {
-      label = it->name;
+    if (!device->name.empty()) {
+      label = device->name;
     }
   }
+  route.bus = bus_path.value_or("");
+  route.label = label.value_or("");
 
-  bool used_fallback = false;
-  bool audio_started = audio_controller_.start(std::nullopt, bus_path, label);
-  if (!audio_started) {
-    used_fallback = true;
+  route.started = audio.start(std::nullopt, bus_path, label);
+  if (!route.started) {
+    route.fallback = true;
     syzygy::log::warn("Unable to match capture audio node; falling back to default route");
-    audio_started = audio_controller_.start();
+    route.started = audio.start();
   }
-  if (!audio_started) {
+  return route;
+}
+
+void MainWindow::show_audio_route(const AudioRoute& route) {
+  audio_level_smooth_ = 0.0;
+  audio_level_bar_.set_value(0.0);
+  if (!route.started) {
     syzygy::log::warn("Unable to start PipeWire capture stream");
     audio_status_label_.set_text("Audio: unavailable");
-    audio_level_smooth_ = 0.0;
-    audio_level_bar_.set_value(0.0);
     audio_using_fallback_ = false;
     return;
   }
-  audio_using_fallback_ = used_fallback;
-  const uint32_t active_rate = audio_controller_.sample_rate();
-  const uint32_t active_channels = audio_controller_.channels();
+  audio_using_fallback_ = route.fallback;
+  const uint32_t active_rate = audio_controller_->sample_rate();
+  const uint32_t active_channels = audio_controller_->channels();
   std::ostringstream status;
   status.setf(std::ios::fixed);
-  status << (used_fallback ? "Audio: default route" : "Audio: capture source")
+  status << (route.fallback ? "Audio: default route" : "Audio: capture source")
          << " (" << active_channels << "ch @ "
          << std::setprecision(1) << (static_cast<double>(active_rate) / 1000.0)
          << " kHz)";
   audio_status_label_.set_text(status.str());
-  audio_level_smooth_ = 0.0;
-  audio_level_bar_.set_value(0.0);
   const double gain = volume_scale_.get_value();
-  audio_controller_.set_gain(static_cast<float>(gain));
+  audio_controller_->set_gain(static_cast<float>(gain));
   syzygy::log::info("Audio route",
-                    used_fallback ? "default" : "matched",
+                    route.fallback ? "default" : "matched",
                     "gain", gain,
-                    "bus", bus_path.value_or(""),
-                    "label", label.value_or(""));
+                    "bus", route.bus,
+                    "label", route.label);
 }
 
 bool MainWindow::on_frame_tick(const Glib::RefPtr<Gdk::FrameClock>& clock) {
   (void)clock;
-  if (capture_session_.is_running()) {
-    if (auto frame = capture_session_.latest_frame()) {
+  if (fast_start_ && fast_start_->ready()) {
+    adopt_fast_start();
+  }
+  if (incoming_) {
+    advance_switch();
+  }
+  advance_audio_rematch();
+  const auto signal = capture_session_->signal_state();
+  if (signal != last_signal_state_) {
+    last_signal_state_ = signal;
+    if (signal == capture::SignalState::NoSignal) {
+      video_widget_.show_placeholder("No signal");
+      capture_stats_label_.set_text("No signal");
+      reset_video_timeline();
+    } else if (capture_session_->is_running()) {
+      capture_stats_label_.set_text("Awaiting frames...");
+    }
+  }
+  const uint64_t generation = capture_session_->frame_generation();
+  if (capture_session_->is_running() && generation != last_frame_generation_) {
+    last_frame_generation_ = generation;
+    if (auto frame = capture_session_->latest_frame()) {
       if (!video_base_time_) {
         video_base_time_ = frame->capture_time;
       }
@@ -287,11 +961,25 @@ bool MainWindow::on_frame_tick(const Glib::RefPtr<Gdk::FrameClock>& clock) {
       }
       last_frame_time_ = frame->capture_time;
       update_capture_stats(*frame);
+      if (first_frame_wait_began_) {
+        syzygy::log::info("Time to first frame:",
+                          syzygy::clock::milliseconds_since(
+                              *first_frame_wait_began_),
+                          "ms");
+        first_frame_wait_began_.reset();
+      }
+      if (resume_began_) {
+        syzygy::log::info("Resumed", capture_session_->device_path(),
+                          "after hotplug: udev add to first frame",
+                          syzygy::clock::milliseconds_since(*resume_began_),
+                          "ms");
+        resume_began_.reset();
+      }
 
-      video_widget_.update_frame(*frame);
+      video_widget_.update_frame(frame);
     }
   }
-  const double peak = std::clamp(static_cast<double>(audio_controller_.peak_level()), 0.0, 1.0);
+  const double peak = std::clamp(static_cast<double>(audio_controller_->peak_level()), 0.0, 1.0);
   audio_level_smooth_ = (audio_level_smooth_ * 0.85) + (peak * 0.15);
   audio_level_bar_.set_value(std::clamp(audio_level_smooth_, 0.0, 1.0));
   return true;
@@ -304,6 +992,13 @@ void MainWindow::update_capture_stats(const capture::Frame& frame) {
   if (current_fps_ > 0.1) {
     oss << " @ " << std::setprecision(1) << current_fps_ << " Hz";
   }
+  const auto counters = capture_session_->counters();
+  if (counters.dropped != 0) {
+    oss << ", " << counters.dropped << " dropped";
+  }
+  if (counters.errored != 0) {
+    oss << ", " << counters.errored << " errored";
+  }
   if (audio_using_fallback_) {
     oss << " (audio fallback)";
   }
@@ -317,12 +1012,132 @@ void MainWindow::on_device_changed() {
   start_current_device();
 }
 
+void MainWindow::on_edid_changed() {
+  if (suppress_device_callback_) {
+    return;
+  }
+  const auto* device = find_device(device_combo_.get_active_id().raw());
+  if (!device) {
+    return;
+  }
+  settings_.set_edid_profile(device_key(*device),
+                             edid_combo_.get_active_id().raw());
+  start_current_device();
+}
+
+void MainWindow::on_policy_changed() {
+  if (suppress_device_callback_) {
+    return;
+  }
+  const auto* device = find_device(device_combo_.get_active_id().raw());
+  if (!device) {
+    return;
+  }
+  settings_.set_mode_policy(device_key(*device),
+                            policy_combo_.get_active_id().raw());
+  start_current_device();
+}
+
+void MainWindow::on_preset_changed() {
+  const auto preset =
+      capture::latency_preset_from_string(preset_combo_.get_active_id().raw());
+  if (!preset) {
+    return;
+  }
+  settings_.set_latency_preset(*preset);
+  capture_session_->set_latency_preset(*preset);
+}
+
+void MainWindow::update_edid_choices(const capture::CaptureDevice* device) {
+  const bool supported = device && device->supports_edid;
+  suppress_device_callback_ = true;
+  edid_combo_.remove_all();
+  edid_combo_.append("", "Card default");
+  if (supported) {
+    for (const auto& profile : capture::edid_profiles()) {
+      edid_combo_.append(profile.id, profile.description);
+    }
+    const auto profile = settings_.edid_profile(device_key(*device));
+    if (!edid_combo_.set_active_id(profile)) {
+      edid_combo_.set_active_id("");
+    }
+  } else {
+    edid_combo_.set_active_id("");
+  }
+  edid_combo_.set_sensitive(supported);
+  suppress_device_callback_ = false;
+}
+
+const capture::CaptureDevice* MainWindow::find_device(
+    const std::string& path) const {
+  const auto it = std::find_if(devices_.begin(), devices_.end(),
+                               [&](const capture::CaptureDevice& device) {
+                                 return device.path == path;
+                               });
+  return it == devices_.end() ? nullptr : &*it;
+}
+
+// The memory mode is fixed once buffers are queued.
+void MainWindow::on_userptr_toggled() {
+  settings_.set_userptr_capture(userptr_switch_.get_active());
+  start_current_device();
+}
+
 void MainWindow::on_volume_changed() {
   const double gain = volume_scale_.get_value();
-  audio_controller_.set_gain(static_cast<float>(gain));
+  audio_controller_->set_gain(static_cast<float>(gain));
   settings_.set_audio_gain(gain);
 }
 
+void MainWindow::on_thumbnails_toggled() {
+  settings_.set_thumbnails(thumbnails_switch_.get_active());
+  update_thumbnail_service();
+}
+
+void MainWindow::on_view_changed() {
+  const std::string view = view_combo_.get_active_id().raw();
+  if (view != "grid") {
+    grid_view_.stop();
+  }
+  if (view != "compare") {
+    compare_view_.stop();
+  }
+  if (view == "single") {
+    video_stack_.set_visible_child(video_widget_);
+    device_combo_.set_sensitive(true);
+    update_thumbnail_service();
+    start_current_device();
+    return;
+  }
+
+  // These views open their devices themselves; the single view lets go of
+  // its device first, fast start included.
+  lost_device_.reset();
+  resume_began_.reset();
+  audio_rematch_.reset();
+  fast_start_.reset();
+  cancel_switch();
+  capture_session_->stop();
+  audio_controller_->stop();
+  // Previews stop, and running grabs are cancelled, before clearing the
+  // live device could let another grab start. The new sessions wait for
+  // those still finishing.
+  update_thumbnail_service();
+  set_live_device({});
+  reset_video_timeline();
+  audio_status_label_.set_text("Audio: idle");
+  device_combo_.set_sensitive(false);
+  if (view == "grid") {
+    capture_stats_label_.set_text("All inputs");
+    grid_view_.show_devices(devices_, 1000.0 / monitor_interval_ms_);
+    video_stack_.set_visible_child(grid_view_);
+  } else {
+    capture_stats_label_.set_text("Comparing two inputs");
+    compare_view_.show_devices(devices_, 1000.0 / monitor_interval_ms_);
+    video_stack_.set_visible_child(compare_view_);
+  }
+}
+
 void MainWindow::update_fullscreen_ui() {
   set_decorated(!fullscreen_);
   if (header_bar_) {
@@ -333,6 +1148,7 @@ void MainWindow::update_fullscreen_ui() {
   root_.set_spacing(fullscreen_ ? 0 : 12);
   control_bar_.set_visible(!fullscreen_);
   status_bar_.set_visible(!fullscreen_);
+  update_thumbnail_service();
   if (fullscreen_) {
     video_widget_.set_hexpand(true);
     video_widget_.set_vexpand(true);
@@ -350,6 +1166,11 @@ void MainWindow::set_fullscreen_state(bool enable) {
     unfullscreen();
   }
 
+  update_monitor_interval();
+  update_fullscreen_ui();
+}
+
+void MainWindow::update_monitor_interval() {
   auto display = Gdk::Display::get_default();
   if (display) {
     Glib::RefPtr<Gdk::Monitor> monitor;
@@ -370,11 +1191,11 @@ void MainWindow::set_fullscreen_state(bool enable) {
       if (refresh_millihz > 0) {
         monitor_interval_ms_ =
             1000000.0 / static_cast<double>(refresh_millihz);
+        capture_session_->set_display_refresh_hz(
+            static_cast<double>(refresh_millihz) / 1000.0);
       }
     }
   }
-
-  update_fullscreen_ui();
 }
 
 bool MainWindow::on_key_pressed(guint keyval, guint, Gdk::ModifierType) {
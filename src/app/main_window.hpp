@@ -2,57 +2,178 @@
 
 // Copyright (c) 2025 Zoe Gates <zoe@zeocities.dev>
 
+#include "app/compare_view.hpp"
+#include "app/grid_view.hpp"
+#include "app/retirer.hpp"
+#include "app/session_starter.hpp"
 #include "app/video_widget.hpp"
 #include "audio/pipewire_controller.hpp"
 #include "capture/capture_device.hpp"
 #include "capture/capture_session.hpp"
+#include "capture/device_enumerator.hpp"
 #include "capture/device_monitor.hpp"
+#include "capture/thumbnail_service.hpp"
 #include "settings/settings_manager.hpp"
 
 #include <gtkmm/applicationwindow.h>
 #include <gtkmm/box.h>
+#include <gtkmm/button.h>
 #include <gtkmm/centerbox.h>
 #include <gtkmm/comboboxtext.h>
 #include <gtkmm/eventcontrollerkey.h>
 #include <gtkmm/headerbar.h>
 #include <gtkmm/label.h>
 #include <gtkmm/levelbar.h>
+#include <gtkmm/picture.h>
 #include <gtkmm/scale.h>
+#include <gtkmm/scrolledwindow.h>
+#include <gtkmm/stack.h>
+#include <gtkmm/switch.h>
 #include <gtkmm/window.h>
 
 #include "syzygy/clock.hpp"
 
+#include <future>
+#include <map>
+#include <memory>
 #include <optional>
 
 namespace syzygy::app {
 
 class MainWindow : public Gtk::ApplicationWindow {
  public:
-  MainWindow();
+  // `fast_start` may hold a session already opening the last device.
+  MainWindow(settings::SettingsManager& settings,
+             std::unique_ptr<SessionStarter> fast_start);
   ~MainWindow() override;
 
  private:
+  struct AudioRoute {
+    bool started{false};
+    bool fallback{false};
+    std::string bus;
+    std::string label;
+  };
+
+  // A capture session with its audio route: starting up beside the live
+  // one during a device switch, or shutting down after being replaced.
+  struct CaptureRoute {
+    std::string id;
+    syzygy::clock::TimePoint began;
+    std::unique_ptr<capture::CaptureSession> session;
+    std::unique_ptr<audio::PipeWireController> audio;
+    // Declared last so they finish before what they point into goes away.
+    std::unique_ptr<SessionStarter> starter;
+    std::future<AudioRoute> audio_started;
+  };
+
+  // The live device while it is unplugged.
+  struct LostDevice {
+    std::string identity;
+    std::string bus;
+    std::string name;
+    // udev add times of nodes that appeared since, by node.
+    std::map<std::string, syzygy::clock::TimePoint> added;
+  };
+
+  // A resumed device's audio often reaches PipeWire after its video node.
+  // While the default route plays, the match is retried on a silent
+  // controller that replaces the live one once it succeeds.
+  struct AudioRematch {
+    std::string id;
+    int attempts_left{0};
+    syzygy::clock::TimePoint next_attempt;
+    std::unique_ptr<audio::PipeWireController> audio;
+    // Declared last so it finishes before the controller goes away.
+    std::future<AudioRoute> started;
+  };
+
+  struct ThumbnailTile {
+    Gtk::Button* button{nullptr};
+    Gtk::Picture* picture{nullptr};
+    Gtk::Label* caption{nullptr};
+    std::string name;
+  };
+
   void build_ui();
   void refresh_device_list(bool restart_stream);
+  void apply_device_list(std::vector<capture::CaptureDevice> devices);
   void start_current_device();
+  void on_capture_started(const std::string& id,
+                          const capture::CaptureDevice* device);
+  void install_session_callbacks();
+  void apply_saved_preset();
+  void adopt_fast_start();
+  void finish_startup();
+  void sync_policy_combo(capture::ModePolicy policy);
+  void show_audio_route(const AudioRoute& route);
+  // Blocks on the PipeWire node lookup; switches run it off the main thread.
+  static AudioRoute start_audio_route(audio::PipeWireController& audio,
+                                      const capture::CaptureDevice* device);
+
+  void begin_switch(const std::string& id,
+                    const capture::CaptureDevice* device);
+  void advance_switch();
+  void complete_switch();
+  void cancel_switch();
+  void retire(std::unique_ptr<CaptureRoute> route);
+
+  void on_device_event(const capture::DeviceEvent& event);
+  // Stops the session on an unplugged device and waits for a device with
+  // the same identity to come back.
+  void mark_device_lost(const std::string& path);
+  const capture::CaptureDevice* find_returned_device() const;
+  void resume_device(const capture::CaptureDevice& device);
+  void advance_audio_rematch();
+
+  void rebuild_thumbnails();
+  void apply_thumbnail(const std::string& path,
+                       const capture::ThumbnailResult& result);
+  // Keeps previews off the device a session is (about to be) streaming.
+  void set_live_device(const std::string& path);
+  void update_thumbnail_service();
+
   bool on_frame_tick(const Glib::RefPtr<Gdk::FrameClock>& clock);
   void update_capture_stats(const capture::Frame& frame);
   void update_fullscreen_ui();
   void set_fullscreen_state(bool enable);
+  void update_monitor_interval();
   bool on_key_pressed(guint keyval, guint keycode, Gdk::ModifierType state);
   void reset_video_timeline();
 
+  void update_edid_choices(const capture::CaptureDevice* device);
+  const capture::CaptureDevice* find_device(const std::string& path) const;
+
   void on_device_changed();
+  void on_edid_changed();
+  void on_policy_changed();
+  void on_preset_changed();
+  void on_userptr_toggled();
   void on_volume_changed();
+  void on_thumbnails_toggled();
+  void on_view_changed();
+  bool single_view() const { return view_combo_.get_active_id() == "single"; }
 
   Gtk::Box root_{Gtk::Orientation::VERTICAL};
   Gtk::Box control_bar_{Gtk::Orientation::HORIZONTAL};
   Gtk::ComboBoxText device_combo_;
+  Gtk::ComboBoxText edid_combo_;
+  Gtk::ComboBoxText policy_combo_;
+  Gtk::ComboBoxText preset_combo_;
+  Gtk::Switch userptr_switch_;
+  Gtk::Switch thumbnails_switch_;
+  Gtk::ComboBoxText view_combo_;
+  Gtk::ScrolledWindow thumbnail_scroller_;
+  Gtk::Box thumbnail_strip_{Gtk::Orientation::HORIZONTAL};
   Gtk::Scale volume_scale_;
   Gtk::LevelBar audio_level_bar_;
   Gtk::Label audio_status_label_;
   Gtk::Label capture_stats_label_;
+  // The single-device view, every device at once, or two compared.
+  Gtk::Stack video_stack_;
   VideoWidget video_widget_;
+  GridView grid_view_;
+  CompareView compare_view_;
   Gtk::HeaderBar* header_bar_{nullptr};
   Gtk::Label* title_label_{nullptr};
   Gtk::CenterBox status_bar_;
@@ -60,16 +181,36 @@ class MainWindow : public Gtk::ApplicationWindow {
   Gtk::Box status_center_{Gtk::Orientation::HORIZONTAL};
   Gtk::Box status_right_{Gtk::Orientation::HORIZONTAL};
 
-  settings::SettingsManager settings_;
-  capture::CaptureSession capture_session_;
-  audio::PipeWireController audio_controller_;
+  settings::SettingsManager& settings_;
+  std::unique_ptr<capture::CaptureSession> capture_session_;
+  // Until its session has been adopted or given up on.
+  std::unique_ptr<SessionStarter> fast_start_;
+  bool devices_scanned_{false};
+  std::optional<syzygy::clock::TimePoint> first_frame_wait_began_;
+  std::unique_ptr<audio::PipeWireController> audio_controller_;
+  std::optional<AudioRematch> audio_rematch_;
+  std::optional<LostDevice> lost_device_;
+  // udev add of a returning device, until its first frame.
+  std::optional<syzygy::clock::TimePoint> resume_began_;
+  // The device being switched to while the current one keeps showing.
+  std::unique_ptr<CaptureRoute> incoming_;
+  // Stops replaced sessions off the main thread.
+  Retirer retirer_;
   std::unique_ptr<capture::DeviceMonitor> device_monitor_;
+  std::unique_ptr<capture::DeviceEnumerator> device_enumerator_;
+  std::unique_ptr<capture::ThumbnailService> thumbnail_service_;
+  std::map<std::string, ThumbnailTile> thumbnail_tiles_;
+  std::string live_device_;
   std::vector<capture::CaptureDevice> devices_;
+  // Set by refresh_device_list() until the scan it asked for lands.
+  bool restart_after_scan_{false};
   bool suppress_device_callback_{false};
   bool fullscreen_{false};
   Glib::RefPtr<Gtk::EventControllerKey> key_controller_;
   std::optional<syzygy::clock::TimePoint> video_base_time_;
   std::optional<syzygy::clock::TimePoint> last_frame_time_;
+  uint64_t last_frame_generation_{0};
+  capture::SignalState last_signal_state_{capture::SignalState::Unknown};
   double current_fps_{0.0};
   double audio_level_smooth_{0.0};
   bool audio_using_fallback_{false};
@@ -0,0 +1,51 @@
+#pragma once
+
+// Copyright (c) 2025 Zoe Gates <zoe@zeocities.dev>
+//
+// Destroys objects whose destructors block, such as capture sessions
+// joining their threads or starters waiting for start(), on worker threads
+// so the UI never waits for them. Each teardown gets its own thread; the
+// destructor waits for all of them.
+
+#include <chrono>
+#include <future>
+#include <utility>
+#include <vector>
+
+namespace syzygy::app {
+
+class Retirer {
+ public:
+  Retirer() = default;
+  ~Retirer() { wait(); }
+
+  Retirer(const Retirer&) = delete;
+  Retirer& operator=(const Retirer&) = delete;
+
+  // `owned` is destroyed on a worker thread.
+  template <typename Owned>
+  void retire(Owned owned) {
+    std::erase_if(pending_, [](const std::future<void>& task) {
+      return task.wait_for(std::chrono::seconds(0)) ==
+             std::future_status::ready;
+    });
+    pending_.push_back(std::async(std::launch::async,
+                                  [owned = std::move(owned)]() mutable {
+                                    [[maybe_unused]] Owned gone =
+                                        std::move(owned);
+                                  }));
+  }
+
+  // Blocks until every retired object is gone.
+  void wait() {
+    for (auto& task : pending_) {
+      task.wait();
+    }
+    pending_.clear();
+  }
+
+ private:
+  std::vector<std::future<void>> pending_;
+};
+
+}  // namespace syzygy::app
@@ -0,0 +1,107 @@
+#include "app/session_starter.hpp"
+
+#include "capture/device_capabilities.hpp"
+#include "util/paths.hpp"
+
+#include "syzygy/log.hpp"
+
+namespace syzygy::app {
+
+std::string device_key(const capture::CaptureDevice& device) {
+  return device.bus.empty() ? device.path : device.bus;
+}
+
+capture::ModePolicy saved_mode_policy(const settings::SettingsManager& settings,
+                                      const capture::CaptureDevice* device) {
+  return capture::mode_policy_from_string(
+             device ? settings.mode_policy(device_key(*device))
+                    : std::string{})
+      .value_or(capture::ModePolicy::MaxQuality);
+}
+
+void apply_session_settings(capture::CaptureSession& session,
+                            const settings::SettingsManager& settings,
+                            const capture::CaptureDevice* device) {
+  session.set_memory_mode(settings.data().userptr_capture
+                              ? capture::MemoryMode::UserPtr
+                              : capture::MemoryMode::Mmap);
+  session.set_newest_only(settings.data().newest_only);
+  session.set_edid_profile(device && device->supports_edid
+                               ? settings.edid_profile(device_key(*device))
+                               : std::string{});
+  session.set_mode_policy(saved_mode_policy(settings, device));
+}
+
+std::filesystem::path last_frame_path() {
+  return util::cache_directory() / "last_frame.ppm";
+}
+
+SessionStarter::SessionStarter(const settings::SettingsManager& settings,
+                               const capture::CaptureDevice& device,
+                               double display_refresh_hz,
+                               std::shared_ptr<capture::ConversionPool>
+                                   conversion_pool,
+                               uint32_t held_frames,
+                               std::shared_ptr<capture::GrabTracker> grabs)
+    : device_path_(device.path),
+      began_(syzygy::clock::now()),
+      session_(std::make_unique<capture::CaptureSession>()) {
+  apply_session_settings(*session_, settings, &device);
+  if (display_refresh_hz > 0.0) {
+    session_->set_display_refresh_hz(display_refresh_hz);
+  }
+  if (conversion_pool) {
+    session_->set_conversion_pool(std::move(conversion_pool));
+  }
+  session_->set_held_frames(held_frames);
+  const auto preset = settings.data().latency_preset;
+  started_ = std::async(
+      std::launch::async, [session = session_.get(), path = device_path_,
+                           preset, grabs = std::move(grabs)]() {
+        if (grabs) {
+          grabs->wait_released(path);
+        }
+        return session->start(path, preset);
+      });
+}
+
+std::unique_ptr<SessionStarter> SessionStarter::for_last_device(
+    const settings::SettingsManager& settings, double display_refresh_hz) {
+  const std::string& path = settings.data().last_video_device;
+  if (path.empty()) {
+    return nullptr;
+  }
+  const auto cached = capture::capability_cache().find_by_path(path);
+  if (!cached) {
+    syzygy::log::info("SessionStarter: no cached capabilities for", path);
+    return nullptr;
+  }
+
+  // Enough of a CaptureDevice for the settings lookups; the scan fills in
+  // the rest later.
+  capture::CaptureDevice device{};
+  device.path = path;
+  device.name = cached->card;
+  device.driver = cached->driver;
+  device.bus = cached->bus;
+  device.supports_dma_buf = cached->dma_buf;
+  device.supports_edid = cached->edid;
+  return std::make_unique<SessionStarter>(settings, device,
+                                          display_refresh_hz);
+}
+
+std::unique_ptr<capture::CaptureSession> SessionStarter::take_session() {
+  if (!started_.valid()) {
+    return nullptr;
+  }
+  const bool started = started_.get();
+  syzygy::log::info("SessionStarter:", device_path_,
+                    started ? "streaming after" : "failed after",
+                    syzygy::clock::milliseconds_since(began_), "ms");
+  if (!started) {
+    session_.reset();
+  }
+  return std::move(session_);
+}
+
+}  // namespace syzygy::app
@@ -0,0 +1,85 @@
+#pragma once
+
+// Copyright (c) 2025 Zoe Gates <zoe@zeocities.dev>
+//
+// Configures a CaptureSession from the saved settings and runs its start()
+// on a worker thread, so opening a device never blocks the UI. Used for the
+// fast start of the last device at launch and for make-before-break device
+// switches.
+
+#include "capture/capture_device.hpp"
+#include "capture/capture_session.hpp"
+#include "capture/thumbnail_service.hpp"
+#include "settings/settings_manager.hpp"
+
+#include "syzygy/clock.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <string>
+
+namespace syzygy::app {
+
+// bus_info survives /dev/videoN renumbering across replugs.
+std::string device_key(const capture::CaptureDevice& device);
+
+// Mode policy saved for `device`; a null device gets the default.
+capture::ModePolicy saved_mode_policy(const settings::SettingsManager& settings,
+                                      const capture::CaptureDevice* device);
+
+// Memory mode, newest-only, EDID profile and mode policy as saved for
+// `device`; a null device gets the defaults.
+void apply_session_settings(capture::CaptureSession& session,
+                            const settings::SettingsManager& settings,
+                            const capture::CaptureDevice* device);
+
+// Where the last displayed frame is kept between runs.
+std::filesystem::path last_frame_path();
+
+class SessionStarter {
+ public:
+  // Begins immediately. `display_refresh_hz` feeds the MatchDisplay policy;
+  // zero when the display is not known yet. Sessions given a
+  // `conversion_pool` convert on it instead of a thread of their own;
+  // `held_frames` is passed to CaptureSession::set_held_frames(). With
+  // `grabs`, the worker first waits for a preview grab of the device to
+  // let go of it.
+  SessionStarter(const settings::SettingsManager& settings,
+                 const capture::CaptureDevice& device,
+                 double display_refresh_hz = 0.0,
+                 std::shared_ptr<capture::ConversionPool> conversion_pool = {},
+                 uint32_t held_frames = 0,
+                 std::shared_ptr<capture::GrabTracker> grabs = {});
+
+  // The last used device, when the capability cache knows it: its formats
+  // are then known without enumeration and its per-device settings can be
+  // resolved before the device scan. Null otherwise.
+  static std::unique_ptr<SessionStarter> for_last_device(
+      const settings::SettingsManager& settings,
+      double display_refresh_hz = 0.0);
+
+  SessionStarter(const SessionStarter&) = delete;
+  SessionStarter& operator=(const SessionStarter&) = delete;
+
+  bool pending() const noexcept { return started_.valid(); }
+  bool ready() const {
+    return started_.valid() && started_.wait_for(std::chrono::seconds(0)) ==
+                                   std::future_status::ready;
+  }
+  const std::string& device_path() const noexcept { return device_path_; }
+  syzygy::clock::TimePoint began() const noexcept { return began_; }
+
+  // Blocks until start() returned. The running session, or nullptr when
+  // it failed.
+  std::unique_ptr<capture::CaptureSession> take_session();
+
+ private:
+  std::string device_path_;
+  syzygy::clock::TimePoint began_;
+  std::unique_ptr<capture::CaptureSession> session_;
+  std::future<bool> started_;
+};
+
+}  // namespace syzygy::app
@@ -20,31 +20,52 @@ VideoWidget::VideoWidget() {
 void VideoWidget::show_placeholder(const Glib::ustring& message) {
   placeholder_message_ = message;
   texture_.reset();
-  frame_data_.clear();
   frame_width_ = frame_height_ = frame_stride_ = 0;
   queue_resize();
   queue_draw();
 }
 
-void VideoWidget::update_frame(const capture::Frame& frame) {
+void VideoWidget::show_snapshot(const capture::FrameSnapshot& snapshot) {
+  if (snapshot.rgb.empty()) {
+    return;
+  }
+  placeholder_message_.clear();
+  frame_width_ = snapshot.width;
+  frame_height_ = snapshot.height;
+  frame_stride_ = snapshot.width * 3;
+  auto bytes = Glib::Bytes::create(snapshot.rgb.data(), snapshot.rgb.size());
+  texture_ = Gdk::MemoryTexture::create(frame_width_, frame_height_,
+                                        Gdk::MemoryTexture::Format::R8G8B8,
+                                        bytes, frame_stride_);
+  queue_draw();
+}
+
+void VideoWidget::update_frame(const capture::FrameRef& frame) {
   placeholder_message_.clear();
   update_texture(frame);
   queue_draw();
 }
 
-void VideoWidget::update_texture(const capture::Frame& frame) {
-  frame_width_ = frame.width;
-  frame_height_ = frame.height;
-  frame_stride_ = frame.stride;
-  frame_data_ = frame.rgb;
+void VideoWidget::update_texture(const capture::FrameRef& frame) {
+  frame_width_ = frame->width;
+  frame_height_ = frame->height;
+  frame_stride_ = frame->stride;
   preferred_width_ = static_cast<int>(frame_width_);
   preferred_height_ = static_cast<int>(frame_height_);
 
-  auto bytes =
-      Glib::Bytes::create(frame_data_.data(), frame_data_.size());
-  texture_ = Gdk::MemoryTexture::create(
-      frame_width_, frame_height_, Gdk::MemoryTexture::Format::R8G8B8, bytes,
-      frame_stride_);
+  // The texture borrows the pooled frame; the ref is dropped when GTK
+  // releases the bytes, handing the frame back to the pool.
+  auto* holder = new capture::FrameRef(frame);
+  GBytes* raw = g_bytes_new_with_free_func(
+      frame->rgb.data(), frame->rgb.size(),
+      [](gpointer data) { delete static_cast<capture::FrameRef*>(data); },
+      holder);
+  auto bytes = Glib::wrap(raw);
+  const auto format = frame->layout == capture::PixelLayout::Bgr24
+                          ? Gdk::MemoryTexture::Format::B8G8R8
+                          : Gdk::MemoryTexture::Format::R8G8B8;
+  texture_ = Gdk::MemoryTexture::create(frame_width_, frame_height_, format,
+                                        bytes, frame_stride_);
 }
 
 void VideoWidget::snapshot_vfunc(const Glib::RefPtr<Gtk::Snapshot>& snapshot) {
@@ -3,22 +3,23 @@
 // Copyright (c) 2025 Zoe Gates <zoe@zeocities.dev>
 
 #include "capture/capture_session.hpp"
+#include "capture/frame_snapshot.hpp"
 
 #include <gdkmm/memorytexture.h>
 #include <gtkmm/snapshot.h>
 #include <gtkmm/widget.h>
 #include <glibmm/bytes.h>
 
-#include <vector>
-
 namespace syzygy::app {
 
 class VideoWidget : public Gtk::Widget {
  public:
   VideoWidget();
 
-  void update_frame(const capture::Frame& frame);
+  void update_frame(const capture::FrameRef& frame);
   void show_placeholder(const Glib::ustring& message);
+  // A still picture shown until the next update_frame() or placeholder.
+  void show_snapshot(const capture::FrameSnapshot& snapshot);
 
  protected:
   void snapshot_vfunc(const Glib::RefPtr<Gtk::Snapshot>& snapshot) override;
@@ -27,10 +28,9 @@ class VideoWidget : public Gtk::Widget {
                      int& natural_baseline) const override;
 
  private:
-  void update_texture(const capture::Frame& frame);
+  void update_texture(const capture::FrameRef& frame);
 
   Glib::RefPtr<Gdk::Texture> texture_;
-  std::vector<uint8_t> frame_data_;
   uint32_t frame_width_{0};
   uint32_t frame_height_{0};
   uint32_t frame_stride_{0};
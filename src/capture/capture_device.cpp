@@ -1,95 +1,254 @@
 #include "capture/capture_device.hpp"
 
+#include "capture/device_capabilities.hpp"
+#include "capture/v4l2_util.hpp"
+#include "util/thread_pool.hpp"
+
 #include "syzygy/log.hpp"
 
 #include <algorithm>
-#include <array>
 #include <cerrno>
 #include <cstring>
 #include <filesystem>
+#include <fstream>
+#include <future>
 #include <fcntl.h>
+#include <libudev.h>
 #include <linux/videodev2.h>
-#include <sys/ioctl.h>
 #include <unistd.h>
 
 namespace syzygy::capture {
 
 namespace {
 
-std::string fourcc_to_string(uint32_t code) {
-  std::array<char, 5> fourcc{};
-  fourcc[0] = static_cast<char>(code & 0xFF);
-  fourcc[1] = static_cast<char>((code >> 8) & 0xFF);
-  fourcc[2] = static_cast<char>((code >> 16) & 0xFF);
-  fourcc[3] = static_cast<char>((code >> 24) & 0xFF);
-  return std::string(fourcc.data());
+namespace fs = std::filesystem;
+
+// Probing is mostly waiting on drivers; a few threads cover a dozen nodes.
+constexpr size_t kMaxProbeWorkers = 4;
+
+std::string read_attribute(const fs::path& path) {
+  std::ifstream input(path);
+  std::string value;
+  std::getline(input, value);
+  return value;
 }
 
-}  // namespace
+// udev's v4l_id tags every node with what it can do (":capture:",
+// ":video_output:", ...), so this needs no open of the node.
+std::optional<std::string> udev_v4l_capabilities(const std::string& name) {
+  udev* udev_ctx = udev_new();
+  if (!udev_ctx) {
+    return std::nullopt;
+  }
+  std::optional<std::string> caps;
+  if (udev_device* device = udev_device_new_from_subsystem_sysname(
+          udev_ctx, "video4linux", name.c_str())) {
+    if (const char* value =
+            udev_device_get_property_value(device, "ID_V4L_CAPABILITIES")) {
+      caps = value;
+    }
+    udev_device_unref(device);
+  }
+  udev_unref(udev_ctx);
+  return caps;
+}
 
-std::vector<CaptureDevice> enumerate_devices() {
-  std::vector<CaptureDevice> devices;
-  std::vector<std::filesystem::path> nodes;
-  for (const auto& entry : std::filesystem::directory_iterator("/dev")) {
-    if (!entry.is_character_file()) {
-      continue;
+bool is_capture_node(const fs::path& sysfs_entry) {
+  if (const auto caps = udev_v4l_capabilities(sysfs_entry.filename())) {
+    return caps->find(":capture:") != std::string::npos;
+  }
+  // Without udev data: UVC functions register the stream first and the
+  // metadata node second.
+  std::error_code ec;
+  const auto driver = fs::read_symlink(sysfs_entry / "device" / "driver", ec);
+  if (!ec && driver.filename() == "uvcvideo") {
+    return read_attribute(sysfs_entry / "index") == "0";
+  }
+  return true;
+}
+
+// The node's parent is the USB interface; the serial sits on the device
+// above it. Stops at the first USB device so a hub's serial is never
+// taken for the card's.
+std::string usb_serial(const fs::path& node) {
+  std::error_code ec;
+  auto dir = fs::canonical(
+      fs::path("/sys/class/video4linux") / node.filename() / "device", ec);
+  if (ec) {
+    return {};
+  }
+  for (int depth = 0; depth < 3 && !dir.empty(); ++depth) {
+    if (fs::exists(dir / "idVendor", ec)) {
+      return read_attribute(dir / "serial");
     }
-    const auto name = entry.path().filename().string();
-    if (name.rfind("video", 0) == 0) {
-      nodes.push_back(entry.path());
+    dir = dir.parent_path();
+  }
+  return {};
+}
+
+std::vector<fs::path> capture_candidates() {
+  std::vector<fs::path> nodes;
+  std::error_code ec;
+  const fs::path sysfs("/sys/class/video4linux");
+  if (fs::is_directory(sysfs, ec)) {
+    for (const auto& entry : fs::directory_iterator(sysfs, ec)) {
+      const auto name = entry.path().filename().string();
+      if (name.rfind("video", 0) != 0 || !is_capture_node(entry.path())) {
+        continue;
+      }
+      const fs::path node = fs::path("/dev") / name;
+      if (fs::is_character_file(node, ec)) {
+        nodes.push_back(node);
+      }
+    }
+  } else {
+    for (const auto& entry : fs::directory_iterator("/dev", ec)) {
+      const auto name = entry.path().filename().string();
+      if (name.rfind("video", 0) == 0 && entry.is_character_file(ec)) {
+        nodes.push_back(entry.path());
+      }
     }
   }
   std::sort(nodes.begin(), nodes.end());
+  return nodes;
+}
 
-  for (const auto& node : nodes) {
-    int fd = ::open(node.c_str(), O_RDWR | O_NONBLOCK);
-    if (fd < 0) {
-      syzygy::log::warn("enumerate_devices: unable to open", node.string(),
-                        std::strerror(errno));
-      continue;
-    }
+std::optional<CaptureDevice> probe_device(const fs::path& node) {
+  int fd = ::open(node.c_str(), O_RDWR | O_NONBLOCK);
+  if (fd < 0) {
+    syzygy::log::warn("enumerate_devices: unable to open", node.string(),
+                      std::strerror(errno));
+    return std::nullopt;
+  }
+
+  v4l2_capability caps{};
+  if (!xioctl(fd, VIDIOC_QUERYCAP, &caps)) {
+    syzygy::log::warn("VIDIOC_QUERYCAP failed for", node.string(),
+                      std::strerror(errno));
+    ::close(fd);
+    return std::nullopt;
+  }
+
+  // `capabilities` covers the whole physical device, so a UVC metadata node
+  // would claim VIDEO_CAPTURE through it.
+  const uint32_t device_caps = (caps.capabilities & V4L2_CAP_DEVICE_CAPS)
+                                   ? caps.device_caps
+                                   : caps.capabilities;
+  if (!(device_caps &
+        (V4L2_CAP_VIDEO_CAPTURE | V4L2_CAP_VIDEO_CAPTURE_MPLANE))) {
+    ::close(fd);
+    return std::nullopt;
+  }
 
-    v4l2_capability caps{};
-    if (ioctl(fd, VIDIOC_QUERYCAP, &caps) != 0) {
-      syzygy::log::warn("VIDIOC_QUERYCAP failed for", node.string(),
-                        std::strerror(errno));
-      ::close(fd);
-      continue;
+  CaptureDevice device{};
+  device.path = node.string();
+  device.name = reinterpret_cast<const char*>(caps.card);
+  device.driver = reinterpret_cast<const char*>(caps.driver);
+  device.bus = reinterpret_cast<const char*>(caps.bus_info);
+  device.serial = usb_serial(node);
+  device.supports_streaming = (device_caps & V4L2_CAP_STREAMING) != 0;
+
+  const uint32_t buffer_type = (device_caps & V4L2_CAP_VIDEO_CAPTURE)
+                                   ? V4L2_BUF_TYPE_VIDEO_CAPTURE
+                                   : V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+  const auto cached =
+      capability_cache().find(device.driver, device.bus, device.name);
+  if (cached && cached->buffer_type == buffer_type) {
+    for (const auto& format : cached->formats) {
+      device.pixel_formats.emplace_back(fourcc_to_string(format.pixel_format));
     }
+    device.supports_dma_buf = cached->dma_buf;
+    device.supports_edid = cached->edid;
+    ::close(fd);
+    return device;
+  }
 
-    CaptureDevice device{};
-    device.path = node.string();
-    device.name = reinterpret_cast<const char*>(caps.card);
-    device.driver = reinterpret_cast<const char*>(caps.driver);
-    device.bus = reinterpret_cast<const char*>(caps.bus_info);
-    device.supports_streaming = (caps.capabilities & V4L2_CAP_STREAMING) != 0;
-
-    if (caps.capabilities & V4L2_CAP_VIDEO_CAPTURE ||
-        caps.capabilities & V4L2_CAP_VIDEO_CAPTURE_MPLANE) {
-      v4l2_fmtdesc fmt{};
-      fmt.type = (caps.capabilities & V4L2_CAP_VIDEO_CAPTURE_MPLANE)
-                     ? V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE
-                     : V4L2_BUF_TYPE_VIDEO_CAPTURE;
-
-      while (ioctl(fd, VIDIOC_ENUM_FMT, &fmt) == 0) {
-        device.pixel_formats.emplace_back(fourcc_to_string(fmt.pixelformat));
-        fmt.index++;
-      }
+  v4l2_fmtdesc fmt{};
+  fmt.type = buffer_type;
+  for (fmt.index = 0; xioctl(fd, VIDIOC_ENUM_FMT, &fmt); fmt.index++) {
+    device.pixel_formats.emplace_back(fourcc_to_string(fmt.pixelformat));
+  }
 
-      v4l2_exportbuffer export_buffer{};
-      export_buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-      export_buffer.index = 0;
-      if (ioctl(fd, VIDIOC_EXPBUF, &export_buffer) == 0) {
-        device.supports_dma_buf = true;
-        ::close(export_buffer.fd);
-      }
+  // EXPBUF needs allocated buffers; a zero-count REQBUFS reports the
+  // queue's capabilities without allocating any.
+  v4l2_requestbuffers req{};
+  req.type = buffer_type;
+  req.memory = V4L2_MEMORY_MMAP;
+  if (xioctl(fd, VIDIOC_REQBUFS, &req)) {
+    device.supports_dma_buf =
+        (req.capabilities & V4L2_BUF_CAP_SUPPORTS_DMABUF) != 0;
+  }
+
+  v4l2_edid edid{};
+  device.supports_edid = xioctl(fd, VIDIOC_G_EDID, &edid);
+
+  ::close(fd);
+  return device;
+}
+
+}  // namespace
+
+std::vector<CaptureDevice> enumerate_devices() {
+  const auto nodes = capture_candidates();
+  std::vector<std::optional<CaptureDevice>> probed(nodes.size());
+  if (nodes.size() <= 1) {
+    for (size_t i = 0; i < nodes.size(); ++i) {
+      probed[i] = probe_device(nodes[i]);
+    }
+  } else {
+    util::ThreadPool pool(std::min(nodes.size(), kMaxProbeWorkers));
+    std::vector<std::future<std::optional<CaptureDevice>>> results;
+    results.reserve(nodes.size());
+    for (const auto& node : nodes) {
+      results.push_back(pool.enqueue(probe_device, node));
+    }
+    for (size_t i = 0; i < results.size(); ++i) {
+      probed[i] = results[i].get();
     }
+  }
 
-    devices.emplace_back(std::move(device));
-    ::close(fd);
+  std::vector<CaptureDevice> devices;
+  for (auto& device : probed) {
+    if (device) {
+      devices.push_back(std::move(*device));
+    }
   }
   return devices;
 }
 
+std::string device_identity(const CaptureDevice& device) {
+  if (!device.serial.empty()) {
+    return "serial:" + device.name + "/" + device.serial;
+  }
+  if (!device.bus.empty()) {
+    return "bus:" + device.bus;
+  }
+  return "node:" + device.path;
+}
+
+std::string_view to_string(LatencyPreset preset) {
+  switch (preset) {
+    case LatencyPreset::UltraLow:
+      return "ultra_low";
+    case LatencyPreset::Balanced:
+      return "balanced";
+    case LatencyPreset::Safe:
+      return "safe";
+    case LatencyPreset::Adaptive:
+    default:
+      return "adaptive";
+  }
+}
+
+std::optional<LatencyPreset> latency_preset_from_string(std::string_view name) {
+  for (const auto preset : {LatencyPreset::UltraLow, LatencyPreset::Balanced,
+                            LatencyPreset::Safe, LatencyPreset::Adaptive}) {
+    if (to_string(preset) == name) {
+      return preset;
+    }
+  }
+  return std::nullopt;
+}
+
 }  // namespace syzygy::capture
 
@@ -2,7 +2,9 @@
 
 // Copyright (c) 2025 Zoe Gates <zoe@zeocities.dev>
 
+#include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace syzygy::capture {
@@ -10,7 +12,8 @@ namespace syzygy::capture {
 enum class LatencyPreset {
   UltraLow,
   Balanced,
-  Safe
+  Safe,
+  Adaptive  // Queue depth tuned at runtime from drops and jitter.
 };
 
 struct CaptureDevice {
@@ -18,12 +21,25 @@ struct CaptureDevice {
   std::string name;
   std::string driver;
   std::string bus;
+  // USB serial number, when the device reports one.
+  std::string serial;
   bool supports_streaming{false};
   bool supports_dma_buf{false};
+  // HDMI receivers whose EDID can be replaced (VIDIOC_G/S_EDID).
+  bool supports_edid{false};
   std::vector<std::string> pixel_formats;
 };
 
 std::vector<CaptureDevice> enumerate_devices();
 
+// Names the physical device across replugs, where the node number can
+// change: card name and USB serial when there is a serial, otherwise the
+// bus position, otherwise the node. Cheap cards may share a serial, so
+// compare bus as well when several devices match.
+std::string device_identity(const CaptureDevice& device);
+
+std::string_view to_string(LatencyPreset preset);
+std::optional<LatencyPreset> latency_preset_from_string(std::string_view name);
+
 }  // namespace syzygy::capture
 
@@ -1,32 +1,34 @@
 #include "capture/capture_session.hpp"
 
+#include "capture/edid.hpp"
+#include "capture/v4l2_util.hpp"
+
 #include "syzygy/clock.hpp"
 #include "syzygy/log.hpp"
 
 #include <fcntl.h>
 #include <linux/videodev2.h>
 #include <poll.h>
+#include <pthread.h>
 #include <sys/ioctl.h>
-#include <sys/mman.h>
 #include <unistd.h>
 
 #include <limits>
 #include <algorithm>
-#include <array>
 #include <chrono>
+#include <cmath>
 #include <cstring>
+#include <ctime>
 
 namespace syzygy::capture {
 
 namespace {
 
-bool xioctl(int fd, unsigned long request, void* arg) {
-  int r;
-  do {
-    r = ioctl(fd, request, arg);
-  } while (r == -1 && errno == EINTR);
-  return r != -1;
-}
+// Driver queue depths the Adaptive preset moves between. Buffers for the
+// deepest setting are allocated up front; the rest sit parked in the pool.
+constexpr uint32_t kAdaptiveMinDepth = 2;
+constexpr uint32_t kAdaptiveInitialDepth = 3;
+constexpr uint32_t kAdaptiveMaxDepth = 6;
 
 uint32_t preset_to_buffer_count(LatencyPreset preset) {
   switch (preset) {
@@ -34,12 +36,79 @@ uint32_t preset_to_buffer_count(LatencyPreset preset) {
       return 2;
     case LatencyPreset::Balanced:
       return 4;
+    case LatencyPreset::Adaptive:
+      return kAdaptiveMaxDepth;
     case LatencyPreset::Safe:
     default:
       return 6;
   }
 }
 
+// The session keeps the newest buffer leased for zero-copy consumers, so one
+// extra buffer is requested to keep the preset's depth queued with the driver.
+constexpr uint32_t kPublishedLeases = 1;
+
+// Three mailbox slots, one frame being converted and two held by the display
+// (the current texture and the one GTK may still be presenting).
+constexpr uint32_t kFramePoolCapacity = 6;
+
+size_t mjpeg_worker_count() {
+  const size_t cores = std::thread::hardware_concurrency();
+  return std::clamp<size_t>(cores / 2, 2, 4);
+}
+
+// Packed RGB frames are displayed straight from the capture buffer, so the
+// display's two textures hold leases too.
+constexpr uint32_t kDisplayHeldLeases = 2;
+
+// One frame converting and up to two waiting; anything more would only
+// add latency.
+constexpr size_t kConvertQueueDepth = 2;
+
+// Scaled output sizes are rounded up to this many pixels of width, so a
+// window being resized does not rebuild the frame pool on every step.
+constexpr uint32_t kOutputWidthStep = 64;
+
+// Wake-up period while waiting for a signal to come back.
+constexpr auto kIdlePollInterval = std::chrono::milliseconds(10);
+
+// Stall detection: a stream is stalled after this many missing frames,
+// bounded so slow modes still recover well inside a second. Each further
+// step waits one timeout longer than the last, up to kMaxStallSteps.
+constexpr double kStallFrames = 6.0;
+constexpr auto kMinStallTimeout = std::chrono::milliseconds(100);
+constexpr auto kMaxStallTimeout = std::chrono::milliseconds(300);
+constexpr uint32_t kMaxStallSteps = 4;
+// UVC bridges can take this long to deliver their first frame.
+constexpr auto kFirstFrameGrace = std::chrono::milliseconds(1000);
+// Reopen retries back off from here while the node is unusable.
+constexpr auto kReopenRetryInterval = std::chrono::milliseconds(250);
+constexpr uint32_t kMaxReopenBackoffShift = 4;
+constexpr int kWatchdogPollMs = 50;
+
+// Sequence jumps this large are a restarted counter, not dropped frames.
+constexpr uint32_t kMaxSequenceGap = 1000;
+
+const char* to_string(RecoveryAction action) {
+  switch (action) {
+    case RecoveryAction::RequeueBuffers:
+      return "requeue buffers";
+    case RecoveryAction::RestartStream:
+      return "restart stream";
+    case RecoveryAction::ReopenDevice:
+    default:
+      return "reopen device";
+  }
+}
+
+bool capture_format_supported(uint32_t pixfmt) {
+  const auto* format = find_pixel_format(pixfmt);
+  if (!format) {
+    return false;
+  }
+  return !format->compressed || MjpegDecoder::available();
+}
+
 }  // namespace
 
 CaptureSession::CaptureSession() = default;
@@ -53,7 +122,20 @@ bool CaptureSession::start(const std::string& device_path,
   stop();
 
   device_path_ = device_path;
-  preset_ = preset;
+  preset_.store(preset, std::memory_order_relaxed);
+  preset_change_pending_.store(false, std::memory_order_relaxed);
+  reset_depth_controller();
+  mailbox_.reset();
+  last_published_capture_ = {};
+  signal_state_.store(SignalState::Unknown, std::memory_order_release);
+  last_recovery_time_ = {};
+  frame_since_start_ = false;
+  frame_counts_ = {};
+  counters_.store(frame_counts_);
+  recovery_step_ = 0;
+  if (conversion_pool_) {
+    pool_client_ = conversion_pool_->add_client();
+  }
 
   if (!configure_device()) {
     syzygy::log::warn("CaptureSession: configure_device failed for",
@@ -64,41 +146,87 @@ bool CaptureSession::start(const std::string& device_path,
 
   running_ = true;
   worker_ = std::thread([this]() { streaming_loop(); });
+  capture_clock_valid_ =
+      pthread_getcpuclockid(worker_.native_handle(), &capture_clock_) == 0;
   return true;
 }
 
 void CaptureSession::stop() {
-  if (!running_) {
-    teardown_buffers();
-    return;
-  }
-  running_ = false;
-  if (worker_.joinable()) {
-    worker_.join();
+  if (running_) {
+    running_ = false;
+    capture_clock_valid_ = false;
+    if (worker_.joinable()) {
+      worker_.join();
+    }
   }
   teardown_buffers();
+  if (pool_client_ != 0) {
+    conversion_pool_->remove_client(pool_client_);
+    pool_client_ = 0;
+  }
 }
 
-bool CaptureSession::set_latency_preset(LatencyPreset preset) {
-  if (preset == preset_) {
-    return true;
-  }
-  preset_ = preset;
+void CaptureSession::set_latency_preset(LatencyPreset preset) {
   if (!running_) {
-    return true;
+    preset_.store(preset, std::memory_order_relaxed);
+    return;
   }
+  requested_preset_.store(preset, std::memory_order_relaxed);
+  preset_change_pending_.store(true, std::memory_order_release);
+}
 
-  const std::string device = device_path_;
-  stop();
-  return start(device, preset_);
+FrameRef CaptureSession::latest_frame() {
+  const FrameRef* frame = mailbox_.read();
+  return frame ? *frame : FrameRef{};
+}
+
+FrameLease CaptureSession::acquire_lease() const {
+  std::lock_guard<std::mutex> lock(lease_mutex_);
+  return latest_lease_;
 }
 
-std::optional<Frame> CaptureSession::latest_frame() const {
-  std::lock_guard<std::mutex> lock(frame_mutex_);
-  if (!frame_ready_) {
-    return std::nullopt;
+CaptureStats CaptureSession::stats() const {
+  CaptureStats stats{};
+  std::shared_ptr<LeasePool> pool;
+  std::shared_ptr<FramePool> frames;
+  // Created once by the capture thread and kept until the session dies.
+  const MjpegDecoder* decoder = nullptr;
+  const ConvertStage* convert = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(lease_mutex_);
+    pool = lease_pool_;
+    frames = frame_pool_;
+    decoder = mjpeg_decoder_.get();
+    convert = convert_stage_.get();
+    stats.frame_pool_rebuilds = frame_pool_rebuilds_;
+  }
+  stats.counters = counters_.load();
+  if (pool) {
+    stats.leases = pool->stats();
+  }
+  if (frames) {
+    stats.frames = frames->stats();
+  }
+  if (decoder) {
+    stats.decoder = decoder->stats();
+  }
+  stats.recoveries = recoveries_.load(std::memory_order_relaxed);
+  timespec cpu{};
+  if (running_ && capture_clock_valid_ &&
+      clock_gettime(capture_clock_, &cpu) == 0) {
+    stats.capture_cpu_ms = static_cast<double>(cpu.tv_sec) * 1e3 +
+                           static_cast<double>(cpu.tv_nsec) / 1e6;
   }
-  return latest_frame_;
+  stats.dequeue = dequeue_meter_.stats();
+  if (pool_client_ != 0) {
+    const auto client = conversion_pool_->client_stats(pool_client_);
+    stats.convert = client.stage;
+    stats.convert_cpu_ms = client.cpu_ms;
+  } else if (convert) {
+    stats.convert = convert->stats();
+  }
+  stats.publish = publish_meter_.stats();
+  return stats;
 }
 
 bool CaptureSession::configure_device() {
@@ -116,6 +244,62 @@ bool CaptureSession::configure_device() {
     return false;
   }
 
+  const uint32_t device_caps = (caps.capabilities & V4L2_CAP_DEVICE_CAPS)
+                                   ? caps.device_caps
+                                   : caps.capabilities;
+  if (device_caps & V4L2_CAP_VIDEO_CAPTURE) {
+    buffer_type_ = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  } else if (device_caps & V4L2_CAP_VIDEO_CAPTURE_MPLANE) {
+    buffer_type_ = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+  } else {
+    syzygy::log::warn("CaptureSession: device lacks VIDEO_CAPTURE capability");
+    return false;
+  }
+  if (!(device_caps & V4L2_CAP_STREAMING)) {
+    syzygy::log::warn("CaptureSession: device lacks STREAMING capability");
+    return false;
+  }
+
+  capabilities_ = cached_capabilities(fd_, caps, buffer_type_, device_path_);
+
+  v4l2_event_subscription subscription{};
+  subscription.type = V4L2_EVENT_SOURCE_CHANGE;
+  if (!xioctl(fd_, VIDIOC_SUBSCRIBE_EVENT, &subscription)) {
+    syzygy::log::info("CaptureSession: no source change events on",
+                      device_path_);
+  }
+
+  if (!edid_profile_.empty()) {
+    if (const auto profile = find_edid_profile(edid_profile_)) {
+      // A new EDID makes the source retrain; the timings queried below may
+      // report no signal until the source change event arrives.
+      apply_edid_profile(fd_, *profile, capabilities_.bus);
+    } else {
+      syzygy::log::warn("CaptureSession: unknown EDID profile", edid_profile_);
+    }
+  } else if (capabilities_.edid) {
+    restore_card_edid(fd_, capabilities_.bus);
+  }
+
+  // HDMI receivers report the incoming timings; capturing at exactly that
+  // size and rate keeps the card from scaling or rate converting.
+  const SignalState signal = lock_dv_timings();
+  signal_state_.store(signal, std::memory_order_release);
+  if (signal == SignalState::NoSignal) {
+    syzygy::log::info("CaptureSession: no signal on", device_path_,
+                      "waiting for source change");
+    return true;
+  }
+  const bool locked = signal == SignalState::Locked;
+
+  if (!select_mode(locked)) {
+    return false;
+  }
+
+  return start_streaming();
+}
+
+bool CaptureSession::select_mode(bool locked) {
   struct BestMode {
     uint32_t pixel_format = V4L2_PIX_FMT_YUYV;
     uint32_t width = 0;
@@ -128,112 +312,94 @@ bool CaptureSession::configure_device() {
 
   best.width = width_;
   best.height = height_;
-  best.score = static_cast<double>(width_) * static_cast<double>(height_) * best.fps;
+
+  ModeContext context{};
+  context.display_refresh_hz =
+      display_refresh_hz_.load(std::memory_order_relaxed);
+  const ModePolicy policy = mode_policy();
+  context.usb_link_mbps = usb_link_mbps(device_path_);
+  context.decode_workers = mjpeg_worker_count();
+  context.decode_ms_per_megapixel = MjpegDecoder::estimated_ms_per_megapixel();
 
   const auto evaluate_mode = [&](uint32_t pixfmt, uint32_t width, uint32_t height,
                                  const v4l2_fract& interval) {
     if (interval.numerator == 0 || interval.denominator == 0) {
       return;
     }
-    const double fps = static_cast<double>(interval.denominator) /
-                       static_cast<double>(interval.numerator);
-    if (fps <= 0.0) {
-      return;
-    }
-    const double area = static_cast<double>(width) * static_cast<double>(height);
-    double score = area * fps;
-    if (!best.valid || score > best.score) {
+    ModeCandidate candidate{};
+    candidate.format = find_pixel_format(pixfmt);
+    candidate.width = width;
+    candidate.height = height;
+    candidate.fps = static_cast<double>(interval.denominator) /
+                    static_cast<double>(interval.numerator);
+    const auto score = score_mode(policy, candidate, context);
+    if (score && (!best.valid || *score > best.score)) {
       best.valid = true;
       best.pixel_format = pixfmt;
       best.width = width;
       best.height = height;
       best.interval = interval;
-      best.fps = fps;
-      best.score = score;
+      best.fps = candidate.fps;
+      best.score = *score;
     }
   };
 
-  v4l2_fmtdesc fmt_desc{};
-  fmt_desc.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-  for (fmt_desc.index = 0; ioctl(fd_, VIDIOC_ENUM_FMT, &fmt_desc) == 0;
-       fmt_desc.index++) {
-    const uint32_t pixfmt = fmt_desc.pixelformat;
-
-    if (pixfmt != V4L2_PIX_FMT_YUYV) {
-      continue;
+  if (locked) {
+    const v4l2_fract signal_interval{
+        1000, static_cast<uint32_t>(std::lround(fps_ * 1000.0))};
+    for (const auto& format : capabilities_.formats) {
+      if (capture_format_supported(format.pixel_format) &&
+          format.supports_size(signal_width_, signal_height_)) {
+        evaluate_mode(format.pixel_format, signal_width_, signal_height_,
+                      signal_interval);
+      }
+    }
+    if (!best.valid) {
+      syzygy::log::warn("CaptureSession: no format matches the signal",
+                        signal_width_, "x", signal_height_,
+                        "using the best available mode");
     }
+  }
 
-    v4l2_frmsizeenum frmsize{};
-    frmsize.pixel_format = pixfmt;
-    for (frmsize.index = 0; ioctl(fd_, VIDIOC_ENUM_FRAMESIZES, &frmsize) == 0;
-         frmsize.index++) {
-      if (frmsize.type == V4L2_FRMSIZE_TYPE_DISCRETE) {
-        const uint32_t w = frmsize.discrete.width;
-        const uint32_t h = frmsize.discrete.height;
-
-        v4l2_frmivalenum frmival{};
-        frmival.pixel_format = pixfmt;
-        frmival.width = w;
-        frmival.height = h;
-
-        for (frmival.index = 0;
-             ioctl(fd_, VIDIOC_ENUM_FRAMEINTERVALS, &frmival) == 0;
-             frmival.index++) {
-          if (frmival.type == V4L2_FRMIVAL_TYPE_DISCRETE) {
-            evaluate_mode(pixfmt, w, h, frmival.discrete);
-          } else if (frmival.type == V4L2_FRMIVAL_TYPE_STEPWISE) {
-            evaluate_mode(pixfmt, w, h, frmival.stepwise.min);
-            evaluate_mode(pixfmt, w, h, frmival.stepwise.max);
-          }
+  if (!best.valid) {
+    for (const auto& format : capabilities_.formats) {
+      if (!capture_format_supported(format.pixel_format)) {
+        continue;
+      }
+      for (const auto& size : format.sizes) {
+        for (const auto& interval : size.intervals) {
+          evaluate_mode(format.pixel_format, size.width, size.height,
+                        v4l2_fract{interval.numerator, interval.denominator});
         }
       }
     }
   }
 
-  if (!(caps.capabilities & V4L2_CAP_VIDEO_CAPTURE)) {
-    syzygy::log::warn("CaptureSession: device lacks VIDEO_CAPTURE capability");
-    return false;
-  }
-  if (!(caps.capabilities & V4L2_CAP_STREAMING)) {
-    syzygy::log::warn("CaptureSession: device lacks STREAMING capability");
-    return false;
-  }
-
   if (best.valid) {
     width_ = best.width;
     height_ = best.height;
   }
 
-  v4l2_format fmt{};
-  fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-  fmt.fmt.pix.width = width_;
-  fmt.fmt.pix.height = height_;
-  fmt.fmt.pix.pixelformat = best.valid ? best.pixel_format : V4L2_PIX_FMT_YUYV;
-  fmt.fmt.pix.field = V4L2_FIELD_NONE;
-
-  if (!xioctl(fd_, VIDIOC_S_FMT, &fmt)) {
-    syzygy::log::warn("CaptureSession: VIDIOC_S_FMT failed",
-                      std::strerror(errno));
+  if (!set_format(best.valid ? best.pixel_format : V4L2_PIX_FMT_YUYV,
+                  width_, height_)) {
     return false;
   }
 
-  width_ = fmt.fmt.pix.width;
-  height_ = fmt.fmt.pix.height;
-
-  char fourcc[5]{0};
-  std::memcpy(fourcc, &fmt.fmt.pix.pixelformat, 4);
+  const std::string fourcc = fourcc_to_string(pixel_format_);
   if (best.valid && best.interval.numerator != 0 && best.interval.denominator != 0) {
     const double fps = static_cast<double>(best.interval.denominator) /
                        static_cast<double>(best.interval.numerator);
     syzygy::log::info("CaptureSession mode", width_, "x", height_, fourcc,
-                      "@", fps, "Hz");
+                      "@", fps, "Hz", "policy", to_string(policy));
   } else {
     syzygy::log::info("CaptureSession mode", width_, "x", height_, fourcc);
   }
 
-  if (best.valid && best.interval.numerator != 0 && best.interval.denominator != 0) {
+  // DV receivers run at the signal's rate; S_PARM does not apply.
+  if (!locked && best.valid && best.interval.numerator != 0 &&
+      best.interval.denominator != 0) {
     v4l2_streamparm parm{};
-    parm.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    parm.type = buffer_type_;
     parm.parm.capture.timeperframe = best.interval;
     parm.parm.capture.capability = V4L2_CAP_TIMEPERFRAME;
     if (!xioctl(fd_, VIDIOC_S_PARM, &parm)) {
@@ -241,73 +407,371 @@ bool CaptureSession::configure_device() {
                         std::strerror(errno));
     }
   }
+  if (!locked) {
+    fps_ = best.valid ? best.fps : 0.0;
+  }
+  return true;
+}
 
-  v4l2_requestbuffers req{};
-  req.count = preset_to_buffer_count(preset_);
-  req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-  req.memory = V4L2_MEMORY_MMAP;
+bool CaptureSession::set_format(uint32_t pixel_format, uint32_t width,
+                                uint32_t height) {
+  v4l2_format fmt{};
+  fmt.type = buffer_type_;
+  if (buffer_type_ == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE) {
+    fmt.fmt.pix_mp.width = width;
+    fmt.fmt.pix_mp.height = height;
+    fmt.fmt.pix_mp.pixelformat = pixel_format;
+    fmt.fmt.pix_mp.field = V4L2_FIELD_NONE;
+  } else {
+    fmt.fmt.pix.width = width;
+    fmt.fmt.pix.height = height;
+    fmt.fmt.pix.pixelformat = pixel_format;
+    fmt.fmt.pix.field = V4L2_FIELD_NONE;
+  }
 
-  if (!xioctl(fd_, VIDIOC_REQBUFS, &req)) {
-    syzygy::log::warn("CaptureSession: VIDIOC_REQBUFS failed",
+  if (!xioctl(fd_, VIDIOC_S_FMT, &fmt)) {
+    syzygy::log::warn("CaptureSession: VIDIOC_S_FMT failed",
                       std::strerror(errno));
     return false;
   }
+  return read_format();
+}
 
-  buffers_.resize(req.count);
-  for (uint32_t i = 0; i < req.count; ++i) {
-    v4l2_buffer buf{};
-    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    buf.memory = V4L2_MEMORY_MMAP;
-    buf.index = i;
+bool CaptureSession::read_format() {
+  v4l2_format fmt{};
+  fmt.type = buffer_type_;
+  if (!xioctl(fd_, VIDIOC_G_FMT, &fmt)) {
+    syzygy::log::warn("CaptureSession: VIDIOC_G_FMT failed",
+                      std::strerror(errno));
+    return false;
+  }
 
-    if (!xioctl(fd_, VIDIOC_QUERYBUF, &buf)) {
-      syzygy::log::warn("CaptureSession: VIDIOC_QUERYBUF failed",
-                        std::strerror(errno));
-      return false;
+  bytes_per_line_ = {};
+  if (buffer_type_ == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE) {
+    const auto& pix = fmt.fmt.pix_mp;
+    width_ = pix.width;
+    height_ = pix.height;
+    pixel_format_ = pix.pixelformat;
+    num_planes_ = pix.num_planes;
+    size_image_ = 0;
+    for (uint32_t p = 0; p < std::min<uint32_t>(num_planes_, kMaxPlanes);
+         ++p) {
+      bytes_per_line_[p] = pix.plane_fmt[p].bytesperline;
+      size_image_ += pix.plane_fmt[p].sizeimage;
     }
+  } else {
+    width_ = fmt.fmt.pix.width;
+    height_ = fmt.fmt.pix.height;
+    pixel_format_ = fmt.fmt.pix.pixelformat;
+    num_planes_ = 1;
+    bytes_per_line_[0] = fmt.fmt.pix.bytesperline;
+    size_image_ = fmt.fmt.pix.sizeimage;
+  }
 
-    void* start = mmap(nullptr, buf.length, PROT_READ | PROT_WRITE, MAP_SHARED,
-                       fd_, buf.m.offset);
-    if (start == MAP_FAILED) {
-      syzygy::log::warn("CaptureSession: mmap failed", std::strerror(errno));
-      return false;
-    }
+  format_ = find_pixel_format(pixel_format_);
+  if (!format_ || !capture_format_supported(pixel_format_)) {
+    syzygy::log::warn("CaptureSession: driver negotiated unsupported format",
+                      fourcc_to_string(pixel_format_));
+    return false;
+  }
+  if (num_planes_ != format_->memory_planes) {
+    syzygy::log::warn("CaptureSession: unexpected plane count", num_planes_,
+                      "for", fourcc_to_string(pixel_format_));
+    return false;
+  }
+  return true;
+}
 
-    buffers_[i].start = start;
-    buffers_[i].length = buf.length;
+void CaptureSession::output_dimensions(uint32_t& width,
+                                       uint32_t& height) const {
+  width = width_;
+  height = height_;
+  const uint64_t packed = output_size_.load(std::memory_order_relaxed);
+  const auto max_width = static_cast<uint32_t>(packed >> 32);
+  const auto max_height = static_cast<uint32_t>(packed);
+  // The MJPEG decoder always writes full frames.
+  if (!conversion_pool_ || format_ == nullptr || format_->compressed ||
+      max_width == 0 || max_height == 0 ||
+      (max_width >= width_ && max_height >= height_)) {
+    return;
+  }
+  const double scale =
+      std::min(static_cast<double>(max_width) / width_,
+               static_cast<double>(max_height) / height_);
+  const auto scaled = static_cast<uint32_t>(std::ceil(width_ * scale));
+  width = std::min(width_, (scaled + kOutputWidthStep - 1) /
+                               kOutputWidthStep * kOutputWidthStep);
+  const auto fitted =
+      static_cast<uint32_t>(static_cast<uint64_t>(height_) * width / width_);
+  height = std::max<uint32_t>(2, fitted & ~1u);
+}
 
-    if (!xioctl(fd_, VIDIOC_QBUF, &buf)) {
-      syzygy::log::warn("CaptureSession: VIDIOC_QBUF failed",
-                        std::strerror(errno));
-      return false;
+bool CaptureSession::fit_frame_pool() {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  output_dimensions(width, height);
+  const uint32_t capacity = std::min(kFramePoolCapacity + held_frames_,
+                                     FramePool::kMaxCapacity);
+  if (frame_pool_ && frame_pool_->matches(width, height) &&
+      frame_pool_->capacity() == capacity) {
+    return true;
+  }
+  auto frames = std::make_shared<FramePool>(
+      width, height, capacity, memory_mode_ == MemoryMode::UserPtr);
+  if (!frames->valid()) {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(lease_mutex_);
+  frame_pool_ = std::move(frames);
+  frame_pool_rebuilds_++;
+  return true;
+}
+
+bool CaptureSession::start_streaming() {
+  if (pixel_format_ == V4L2_PIX_FMT_MJPEG && !mjpeg_decoder_) {
+    auto decoder = std::make_unique<MjpegDecoder>(mjpeg_worker_count());
+    std::lock_guard<std::mutex> lock(lease_mutex_);
+    mjpeg_decoder_ = std::move(decoder);
+  }
+
+  if (!conversion_pool_ && !convert_stage_) {
+    auto stage = std::make_unique<ConvertStage>(kConvertQueueDepth);
+    std::lock_guard<std::mutex> lock(lease_mutex_);
+    convert_stage_ = std::move(stage);
+  }
+  if (!fit_frame_pool()) {
+    return false;
+  }
+
+  uint32_t buffer_count =
+      preset_to_buffer_count(latency_preset()) + kPublishedLeases;
+  if (format_->compressed) {
+    // Buffers being decoded are leased; keep the preset depth queued.
+    buffer_count += static_cast<uint32_t>(mjpeg_decoder_->max_in_flight());
+  } else if (conversion_pool_) {
+    // Passed through at full size, converted when scaled down.
+    buffer_count += static_cast<uint32_t>(ConversionPool::max_in_flight());
+    if (format_->passthrough) {
+      buffer_count += kDisplayHeldLeases + held_frames_;
     }
+  } else if (format_->passthrough) {
+    buffer_count += kDisplayHeldLeases + held_frames_;
+  } else {
+    buffer_count += static_cast<uint32_t>(convert_stage_->max_in_flight());
+  }
+  if (depth_controller_) {
+    depth_controller_->reset(fps_);
+  }
+  if (!allocate_buffers(buffer_count)) {
+    return false;
+  }
+  if (fps_ > 0.0) {
+    lease_pool_->set_hold_budget(
+        std::chrono::duration_cast<syzygy::clock::Clock::duration>(
+            std::chrono::duration<double>(2.0 / fps_)));
   }
 
-  v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  auto type = static_cast<v4l2_buf_type>(buffer_type_);
   if (!xioctl(fd_, VIDIOC_STREAMON, &type)) {
     syzygy::log::warn("CaptureSession: VIDIOC_STREAMON failed",
                       std::strerror(errno));
     return false;
   }
+  streaming_ = true;
+  last_frame_time_ = syzygy::clock::now();
+  // Sequence numbers restart with every STREAMON.
+  sequence_valid_ = false;
 
   syzygy::log::info("CaptureSession streaming", device_path_, width_, "x",
-                    height_, "buffers", req.count);
+                    height_, "planes", num_planes_, "buffers",
+                    lease_pool_->size(), "preset", to_string(latency_preset()),
+                    lease_pool_->memory() == V4L2_MEMORY_USERPTR ? "userptr"
+                                                                 : "mmap");
   return true;
 }
 
-void CaptureSession::teardown_buffers() {
-  if (fd_ >= 0) {
-    v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+void CaptureSession::stop_streaming() {
+  if (streaming_) {
+    auto type = static_cast<v4l2_buf_type>(buffer_type_);
     xioctl(fd_, VIDIOC_STREAMOFF, &type);
+    streaming_ = false;
+  }
+  if (mjpeg_decoder_) {
+    mjpeg_decoder_->drain();
+  }
+  if (convert_stage_) {
+    convert_stage_->drain();
+  }
+  if (pool_client_ != 0) {
+    conversion_pool_->drain(pool_client_);
   }
-  for (auto& buffer : buffers_) {
-    if (buffer.start && buffer.length) {
-      munmap(buffer.start, buffer.length);
+
+  // Outstanding leases keep their mappings alive; retiring the pool only
+  // stops them from being requeued once the queue is gone.
+  std::shared_ptr<LeasePool> pool;
+  FrameLease lease;
+  {
+    std::lock_guard<std::mutex> lock(lease_mutex_);
+    pool = std::move(lease_pool_);
+    lease = std::move(latest_lease_);
+  }
+  if (pool) {
+    pool->retire();
+  }
+}
+
+SignalState CaptureSession::lock_dv_timings() {
+  // Not an HDMI/DV receiver (UVC and friends).
+  if (!capabilities_.dv_timings) {
+    return SignalState::Unknown;
+  }
+  v4l2_dv_timings timings{};
+  if (!xioctl(fd_, VIDIOC_QUERY_DV_TIMINGS, &timings)) {
+    if (errno == ENOLINK || errno == ENOLCK || errno == ERANGE) {
+      return SignalState::NoSignal;
+    }
+    return SignalState::Unknown;
+  }
+  if (!xioctl(fd_, VIDIOC_S_DV_TIMINGS, &timings)) {
+    syzygy::log::warn("CaptureSession: VIDIOC_S_DV_TIMINGS failed",
+                      std::strerror(errno));
+  }
+
+  const auto& bt = timings.bt;
+  signal_width_ = bt.width;
+  signal_height_ = bt.height;
+  const uint64_t htotal = V4L2_DV_BT_FRAME_WIDTH(&bt);
+  const uint64_t vtotal = V4L2_DV_BT_FRAME_HEIGHT(&bt);
+  if (bt.pixelclock != 0 && htotal != 0 && vtotal != 0) {
+    fps_ = static_cast<double>(bt.pixelclock) /
+           static_cast<double>(htotal * vtotal);
+  }
+  syzygy::log::info("CaptureSession: signal", signal_width_, "x",
+                    signal_height_, "@", fps_, "Hz",
+                    bt.interlaced ? "interlaced" : "progressive");
+  return SignalState::Locked;
+}
+
+bool CaptureSession::handle_source_change() {
+  const auto started = syzygy::clock::now();
+  stop_streaming();
+
+  const SignalState state = lock_dv_timings();
+  signal_state_.store(state, std::memory_order_release);
+  if (state == SignalState::NoSignal) {
+    syzygy::log::info("CaptureSession: no signal on", device_path_);
+    return true;
+  }
+
+  if (state == SignalState::Unknown) {
+    v4l2_streamparm parm{};
+    parm.type = buffer_type_;
+    if (xioctl(fd_, VIDIOC_G_PARM, &parm) &&
+        parm.parm.capture.timeperframe.numerator != 0) {
+      fps_ = static_cast<double>(parm.parm.capture.timeperframe.denominator) /
+             static_cast<double>(parm.parm.capture.timeperframe.numerator);
+    }
+  }
+  const bool configured =
+      state == SignalState::Locked ? select_mode(true) : read_format();
+  if (!configured || !start_streaming()) {
+    return false;
+  }
+
+  syzygy::log::info("CaptureSession: source change handled in",
+                    syzygy::clock::milliseconds_since(started), "ms");
+  return true;
+}
+
+bool CaptureSession::apply_latency_preset(LatencyPreset preset) {
+  if (preset == latency_preset()) {
+    return true;
+  }
+  const auto started = syzygy::clock::now();
+  preset_.store(preset, std::memory_order_relaxed);
+  reset_depth_controller();
+  if (!streaming_) {
+    // Picked up by start_streaming() once the signal returns.
+    return true;
+  }
+
+  // REQBUFS on the open fd; leases still held by the display keep their old
+  // mappings until they are dropped.
+  stop_streaming();
+  if (!start_streaming()) {
+    syzygy::log::warn("CaptureSession: in-place preset change failed,",
+                      "reopening", device_path_);
+    teardown_buffers();
+    return configure_device();
+  }
+
+  syzygy::log::info("CaptureSession: preset", to_string(preset), "applied in",
+                    syzygy::clock::milliseconds_since(started), "ms");
+  return true;
+}
+
+void CaptureSession::reset_depth_controller() {
+  depth_controller_.reset();
+  if (latency_preset() == LatencyPreset::Adaptive) {
+    depth_controller_ = std::make_unique<QueueDepthController>(
+        kAdaptiveMinDepth, kAdaptiveMaxDepth, kAdaptiveInitialDepth);
+  }
+}
+
+bool CaptureSession::handle_events() {
+  bool source_changed = false;
+  v4l2_event event{};
+  while (xioctl(fd_, VIDIOC_DQEVENT, &event)) {
+    if (event.type == V4L2_EVENT_SOURCE_CHANGE &&
+        (event.u.src_change.changes & V4L2_EVENT_SRC_CH_RESOLUTION)) {
+      source_changed = true;
+    }
+    if (event.pending == 0) {
+      break;
+    }
+  }
+  return !source_changed || handle_source_change();
+}
+
+bool CaptureSession::allocate_buffers(uint32_t count) {
+  std::shared_ptr<LeasePool> pool;
+  if (memory_mode_ == MemoryMode::UserPtr && num_planes_ == 1 &&
+      size_image_ > 0) {
+    const size_t buffer_bytes = (size_image_ + 4095u) & ~size_t{4095};
+    auto arena =
+        std::make_shared<util::HugepageArena>(buffer_bytes * count, true);
+    pool = std::make_shared<LeasePool>(fd_, buffer_type_);
+    pool->set_queue_limit(queue_depth());
+    if (!arena->valid() ||
+        !pool->attach_user_buffers(count, std::move(arena), buffer_bytes)) {
+      syzygy::log::warn("CaptureSession: USERPTR refused, using MMAP",
+                        std::strerror(errno));
+      pool.reset();
+    } else if (!pool->queue_all()) {
+      v4l2_requestbuffers release{};
+      release.type = buffer_type_;
+      release.memory = V4L2_MEMORY_USERPTR;
+      xioctl(fd_, VIDIOC_REQBUFS, &release);
+      syzygy::log::warn("CaptureSession: USERPTR QBUF failed, using MMAP");
+      pool.reset();
     }
-    buffer.start = nullptr;
-    buffer.length = 0;
   }
-  buffers_.clear();
+
+  if (!pool) {
+    pool = std::make_shared<LeasePool>(fd_, buffer_type_);
+    pool->set_queue_limit(queue_depth());
+    if (!pool->map_buffers(count) || !pool->queue_all()) {
+      return false;
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(lease_mutex_);
+  lease_pool_ = std::move(pool);
+  return true;
+}
+
+void CaptureSession::teardown_buffers() {
+  stop_streaming();
   if (fd_ >= 0) {
     close(fd_);
     fd_ = -1;
@@ -316,123 +780,392 @@ void CaptureSession::teardown_buffers() {
 
 void CaptureSession::streaming_loop() {
   while (running_) {
+    if (preset_change_pending_.exchange(false, std::memory_order_acquire) &&
+        !apply_latency_preset(
+            requested_preset_.load(std::memory_order_relaxed))) {
+      escalate("preset change failed", RecoveryAction::ReopenDevice);
+      continue;
+    }
+
+    check_stall();
+    if (fd_ < 0) {
+      // The last reopen failed; check_stall() retries with backoff.
+      std::this_thread::sleep_for(kIdlePollInterval);
+      continue;
+    }
+
     pollfd pfd{};
     pfd.fd = fd_;
-    pfd.events = POLLIN;
+    pfd.events = streaming_ ? (POLLIN | POLLPRI) : POLLPRI;
 
-    const int poll_result = poll(&pfd, 1, 500);
+    const int poll_result = poll(&pfd, 1, streaming_ ? kWatchdogPollMs : 500);
     if (poll_result < 0) {
       if (errno == EINTR) {
         continue;
       }
       syzygy::log::warn("CaptureSession: poll failed", std::strerror(errno));
-      break;
+      escalate("poll failed", RecoveryAction::ReopenDevice);
+      continue;
     }
     if (poll_result == 0) {
       continue;
     }
 
-    v4l2_buffer buf{};
-    buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    buf.memory = V4L2_MEMORY_MMAP;
+    if (pfd.revents & POLLPRI) {
+      if (!handle_events()) {
+        escalate("source change handling failed",
+                 RecoveryAction::ReopenDevice);
+      }
+      continue;
+    }
+    if (!streaming_) {
+      // vb2 reports POLLERR on an idle queue, so poll() will not block.
+      std::this_thread::sleep_for(kIdlePollInterval);
+      continue;
+    }
 
-    if (!xioctl(fd_, VIDIOC_DQBUF, &buf)) {
-      if (errno == EAGAIN) {
+    BufferInfo info{};
+    if (!dequeue_buffer(info)) {
+      // EPIPE: the driver flushed its queue ahead of a source change event.
+      if (errno == EAGAIN || errno == EPIPE) {
         continue;
       }
       syzygy::log::warn("CaptureSession: VIDIOC_DQBUF failed",
                         std::strerror(errno));
-      break;
+      escalate("dequeue failed", RecoveryAction::RestartStream);
+      continue;
     }
+    dequeue_meter_.enter();
+    count_buffer(info);
+    FrameLease lease = lease_pool_->lease(info);
 
-    const auto dq_time = syzygy::clock::now();
-    const auto& buffer = buffers_[buf.index];
-    const auto* src = static_cast<const uint8_t*>(buffer.start);
-
-    Frame frame{};
-    frame.width = width_;
-    frame.height = height_;
-    frame.capture_time = dq_time;
-    frame.dequeue_time = dq_time;
-    frame.stride = frame.width * 3;
-    frame.rgb.resize(static_cast<size_t>(frame.stride) * frame.height);
-
-    if (buf.timestamp.tv_sec != 0 || buf.timestamp.tv_usec != 0) {
-      auto capture_duration = std::chrono::seconds(buf.timestamp.tv_sec) +
-                              std::chrono::microseconds(buf.timestamp.tv_usec);
-      auto steady_capture = syzygy::clock::TimePoint(
-          std::chrono::duration_cast<syzygy::clock::Clock::duration>(
-              capture_duration));
-      frame.capture_time = steady_capture;
+    if (newest_only_.load(std::memory_order_relaxed)) {
+      // Everything but the last ready buffer is stale. Each one is requeued
+      // before the next is leased so the driver queue never runs dry.
+      BufferInfo newer{};
+      while (dequeue_buffer(newer)) {
+        count_buffer(newer);
+        observe_queue(info, 0.0);
+        lease.reset();
+        info = newer;
+        lease = lease_pool_->lease(info);
+        frame_counts_.skipped++;
+      }
     }
 
-    yuyv_to_rgb(src, frame.rgb.data(), frame.width, frame.height);
+    last_frame_time_ = info.dequeue_time;
+    frame_since_start_ = true;
 
-    {
-      std::lock_guard<std::mutex> lock(frame_mutex_);
-      latest_frame_ = std::move(frame);
-      frame_ready_ = true;
+    // Truncated and errored buffers are requeued without being displayed.
+    const bool usable =
+        frame_complete(info) && !(info.flags & V4L2_BUF_FLAG_ERROR);
+    if (!usable) {
+      frame_counts_.errored++;
+    } else if (recovery_step_ != 0) {
+      syzygy::log::info("CaptureSession: frames flowing again on",
+                        device_path_);
+      recovery_step_ = 0;
+    }
+    if (usable && !fit_frame_pool()) {
+      syzygy::log::warn("CaptureSession: unable to resize frame pool");
+    }
+    FrameRef frame = usable ? frame_pool_->acquire() : FrameRef{};
+    double process_ms = 0.0;
+    if (!frame) {
+      dequeue_meter_.abandon();
+      if (usable) {
+        frame_counts_.skipped++;
+      }
+    } else {
+      frame->capture_time = info.capture_time;
+      frame->dequeue_time = info.dequeue_time;
+      frame->sequence = info.sequence;
+      frame->flags = info.flags;
+      frame->field = info.field;
+      frame->driver_timestamp = info.driver_timestamp;
+      dequeue_meter_.leave(
+          syzygy::clock::milliseconds_since(info.dequeue_time));
+      bool accepted = true;
+      if (format_->compressed) {
+        accepted = mjpeg_decoder_->submit(
+            lease, std::move(frame), [this](FrameRef decoded, double ms) {
+              decoded->convert_ms = ms;
+              publish_frame(std::move(decoded));
+            });
+        // Decodes overlap, so each one costs the stream a fraction of its
+        // wall time.
+        process_ms = mjpeg_decoder_->stats().average_decode_ms /
+                     static_cast<double>(mjpeg_decoder_->max_in_flight());
+      } else if (format_->passthrough &&
+                 frame_pool_->matches(width_, height_)) {
+        frame->rgb = std::span<uint8_t>(
+            const_cast<uint8_t*>(lease.data()),
+            static_cast<size_t>(bytes_per_line_[0]) * height_);
+        frame->stride = bytes_per_line_[0];
+        frame->layout = format_->layout;
+        frame->source = lease;
+        publish_frame(std::move(frame));
+      } else if (conversion_pool_) {
+        accepted = conversion_pool_->submit(
+            pool_client_, lease, describe_source(lease), std::move(frame),
+            [this](FrameRef converted, double ms) {
+              converted->convert_ms = ms;
+              publish_frame(std::move(converted));
+            });
+        process_ms = conversion_pool_->client_stats(pool_client_)
+                         .stage.average_ms;
+      } else {
+        accepted = convert_stage_->submit(
+            lease, describe_source(lease), format_->convert, std::move(frame),
+            [this](FrameRef converted, double ms) {
+              converted->convert_ms = ms;
+              publish_frame(std::move(converted));
+            });
+        process_ms = convert_stage_->stats().average_ms;
+      }
+      if (!accepted) {
+        frame_counts_.skipped++;
+      }
     }
+    counters_.store(frame_counts_);
 
-    if (!xioctl(fd_, VIDIOC_QBUF, &buf)) {
-      syzygy::log::warn("CaptureSession: VIDIOC_QBUF failed",
-                        std::strerror(errno));
-      break;
+    // Publishing swaps out the previous lease; it is requeued once the last
+    // consumer holding it lets go.
+    {
+      std::lock_guard<std::mutex> lock(lease_mutex_);
+      std::swap(latest_lease_, lease);
     }
+
+    observe_queue(info, process_ms);
   }
 
   running_ = false;
 }
 
-void CaptureSession::yuyv_to_rgb(const uint8_t* src, uint8_t* dst,
-                                 uint32_t width, uint32_t height) {
-  const bool use_bt709 = (width >= 1280 || height >= 720);
-  // Coefficients scaled by 256 to keep the integer math fast.
-  const int coeff_r_v = use_bt709 ? 459 : 409;
-  const int coeff_g_u = use_bt709 ? 55 : 100;
-  const int coeff_g_v = use_bt709 ? 136 : 208;
-  const int coeff_b_u = use_bt709 ? 541 : 516;
-
-  const size_t pixel_count = static_cast<size_t>(width) * height;
-  for (size_t i = 0; i < pixel_count; i += 2) {
-    const uint8_t y0 = src[0];
-    const uint8_t u = src[1];
-    const uint8_t y1 = src[2];
-    const uint8_t v = src[3];
-    src += 4;
-
-    auto convert = [&](uint8_t y, int16_t u_shift,
-                       int16_t v_shift) -> std::array<uint8_t, 3> {
-      int c = static_cast<int>(y) - 16;
-      if (c < 0) {
-        c = 0;
+bool CaptureSession::dequeue_buffer(BufferInfo& info) {
+  std::array<v4l2_plane, kMaxPlanes> planes{};
+  v4l2_buffer buf{};
+  buf.type = buffer_type_;
+  buf.memory = lease_pool_->memory();
+  if (lease_pool_->multi_planar()) {
+    buf.m.planes = planes.data();
+    buf.length = num_planes_;
+  }
+  if (!xioctl(fd_, VIDIOC_DQBUF, &buf)) {
+    return false;
+  }
+
+  const auto dq_time = syzygy::clock::now();
+  info = BufferInfo{};
+  info.index = buf.index;
+  info.pixel_format = pixel_format_;
+  info.width = width_;
+  info.height = height_;
+  info.bytes_per_line = bytes_per_line_[0];
+  info.sequence = buf.sequence;
+  info.flags = buf.flags;
+  info.field = buf.field;
+  info.capture_time = dq_time;
+  info.dequeue_time = dq_time;
+  if (lease_pool_->multi_planar()) {
+    info.plane_count = num_planes_;
+    for (uint32_t p = 0; p < num_planes_; ++p) {
+      const uint32_t offset =
+          std::min(planes[p].data_offset, planes[p].bytesused);
+      info.plane_offset[p] = offset;
+      info.plane_bytes_used[p] = planes[p].bytesused - offset;
+    }
+  } else {
+    info.plane_bytes_used[0] = buf.bytesused;
+  }
+  info.bytes_used = info.plane_bytes_used[0];
+
+  // Copied timestamps (output-to-capture devices) are on some other
+  // clock; drivers that leave the source unknown are in practice
+  // monotonic.
+  const uint32_t timestamp_type = buf.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK;
+  if (timestamp_type != V4L2_BUF_FLAG_TIMESTAMP_COPY &&
+      (buf.timestamp.tv_sec != 0 || buf.timestamp.tv_usec != 0)) {
+    auto capture_duration = std::chrono::seconds(buf.timestamp.tv_sec) +
+                            std::chrono::microseconds(buf.timestamp.tv_usec);
+    auto steady_capture = syzygy::clock::TimePoint(
+        std::chrono::duration_cast<syzygy::clock::Clock::duration>(
+            capture_duration));
+    info.capture_time = steady_capture;
+    info.driver_timestamp = true;
+  }
+  return true;
+}
+
+void CaptureSession::check_stall() {
+  if (fd_ >= 0 && !streaming_) {
+    // Idle without a signal; source change events restart the stream.
+    return;
+  }
+  const auto now = syzygy::clock::now();
+  const auto timeout = stall_timeout();
+  if (now - last_frame_time_ < timeout || now - last_recovery_time_ < timeout) {
+    return;
+  }
+  escalate("capture stalled");
+}
+
+void CaptureSession::escalate(const char* reason, RecoveryAction at_least) {
+  recovery_step_ =
+      std::max(recovery_step_, static_cast<uint32_t>(at_least));
+  const auto action = static_cast<RecoveryAction>(std::min(
+      recovery_step_, static_cast<uint32_t>(RecoveryAction::ReopenDevice)));
+  recovery_step_++;
+
+  RecoveryEvent event{};
+  event.action = action;
+  event.stalled_ms = syzygy::clock::milliseconds_since(last_frame_time_);
+  const auto started = syzygy::clock::now();
+  event.succeeded = recover(action);
+  event.duration_ms = syzygy::clock::milliseconds_since(started);
+  last_recovery_time_ = syzygy::clock::now();
+  recoveries_.fetch_add(1, std::memory_order_relaxed);
+
+  syzygy::log::warn("CaptureSession:", reason, "on", device_path_, "after",
+                    event.stalled_ms, "ms;", to_string(action),
+                    event.succeeded ? "done in" : "failed after",
+                    event.duration_ms, "ms");
+  RecoveryCallback callback;
+  {
+    std::lock_guard<std::mutex> lock(recovery_mutex_);
+    callback = recovery_callback_;
+  }
+  if (callback) {
+    callback(event);
+  }
+}
+
+bool CaptureSession::recover(RecoveryAction action) {
+  switch (action) {
+    case RecoveryAction::RequeueBuffers:
+      if (!lease_pool_) {
+        return false;
+      }
+      syzygy::log::info("CaptureSession: requeued", lease_pool_->requeue_lost(),
+                        "lost buffers");
+      return true;
+    case RecoveryAction::RestartStream:
+      if (fd_ < 0) {
+        return false;
+      }
+      stop_streaming();
+      return start_streaming();
+    case RecoveryAction::ReopenDevice:
+    default:
+      teardown_buffers();
+      if (!configure_device()) {
+        teardown_buffers();
+        return false;
       }
-      int d = u_shift;
-      int e = v_shift;
-      int r = (298 * c + coeff_r_v * e + 128) >> 8;
-      int g = (298 * c - coeff_g_u * d - coeff_g_v * e + 128) >> 8;
-      int b = (298 * c + coeff_b_u * d + 128) >> 8;
-      r = std::clamp(r, 0, 255);
-      g = std::clamp(g, 0, 255);
-      b = std::clamp(b, 0, 255);
-      return {static_cast<uint8_t>(r), static_cast<uint8_t>(g),
-              static_cast<uint8_t>(b)};
-    };
-
-    const int16_t u_shift = static_cast<int16_t>(u) - 128;
-    const int16_t v_shift = static_cast<int16_t>(v) - 128;
-
-    const auto rgb0 = convert(y0, u_shift, v_shift);
-    const auto rgb1 = convert(y1, u_shift, v_shift);
-
-    dst[0] = rgb0[0];
-    dst[1] = rgb0[1];
-    dst[2] = rgb0[2];
-    dst[3] = rgb1[0];
-    dst[4] = rgb1[1];
-    dst[5] = rgb1[2];
-    dst += 6;
+      return true;
+  }
+}
+
+syzygy::clock::Clock::duration CaptureSession::stall_timeout() const {
+  using Duration = syzygy::clock::Clock::duration;
+  if (fd_ < 0) {
+    constexpr auto kReopenStep =
+        static_cast<uint32_t>(RecoveryAction::ReopenDevice) + 1;
+    const uint32_t retries =
+        recovery_step_ > kReopenStep ? recovery_step_ - kReopenStep : 0;
+    return kReopenRetryInterval *
+           (1u << std::min(retries, kMaxReopenBackoffShift));
+  }
+  const double interval_s = fps_ > 0.0 ? 1.0 / fps_ : 1.0 / 30.0;
+  Duration timeout = std::clamp<Duration>(
+      std::chrono::duration_cast<Duration>(
+          std::chrono::duration<double>(interval_s * kStallFrames)),
+      kMinStallTimeout, kMaxStallTimeout);
+  timeout *= std::min(recovery_step_, kMaxStallSteps) + 1;
+  if (!frame_since_start_) {
+    timeout = std::max<Duration>(timeout, kFirstFrameGrace);
+  }
+  return timeout;
+}
+
+void CaptureSession::count_buffer(const BufferInfo& info) {
+  auto& counts = frame_counts_;
+  if (sequence_valid_) {
+    const uint32_t gap = info.sequence - counts.last_sequence;
+    if (gap > 1 && gap < kMaxSequenceGap) {
+      counts.dropped += gap - 1;
+    }
+  }
+  sequence_valid_ = true;
+  counts.dequeued++;
+  counts.last_sequence = info.sequence;
+  counts.last_capture_time = info.capture_time;
+  counts.last_dequeue_time = info.dequeue_time;
+}
+
+uint32_t CaptureSession::queue_depth() const {
+  return depth_controller_ ? depth_controller_->depth()
+                           : preset_to_buffer_count(latency_preset());
+}
+
+void CaptureSession::observe_queue(const BufferInfo& info, double process_ms) {
+  if (!depth_controller_) {
+    return;
+  }
+  const uint32_t depth = depth_controller_->observe(
+      info.sequence, info.dequeue_time, process_ms,
+      lease_pool_->starvations());
+  if (depth != 0) {
+    lease_pool_->set_queue_limit(depth);
+    syzygy::log::info("CaptureSession: queue depth", depth, "jitter_ms",
+                      depth_controller_->jitter_ms(), "dropped",
+                      depth_controller_->dropped());
+  }
+}
+
+bool CaptureSession::frame_complete(const BufferInfo& info) const {
+  for (uint32_t p = 0; p < info.plane_count; ++p) {
+    const uint64_t needed =
+        memory_plane_bytes(*format_, p, height_, bytes_per_line_[p]);
+    // Some drivers leave bytesused at zero; trust those buffers.
+    const uint32_t used = info.plane_bytes_used[p];
+    if (needed != 0 && used != 0 && used < needed) {
+      return false;
+    }
+  }
+  return true;
+}
+
+SourceImage CaptureSession::describe_source(const FrameLease& lease) const {
+  if (format_->memory_planes <= 1) {
+    return describe_contiguous(*format_, lease.data(), width_, height_,
+                               bytes_per_line_[0]);
+  }
+  SourceImage src{};
+  src.pixel_format = pixel_format_;
+  src.width = width_;
+  src.height = height_;
+  for (uint32_t p = 0; p < format_->memory_planes; ++p) {
+    src.planes[p] = {lease.plane_data(p), bytes_per_line_[p]};
+  }
+  return src;
+}
+
+void CaptureSession::publish_frame(FrameRef frame) {
+  const auto start = syzygy::clock::now();
+  publish_meter_.enter();
+  std::lock_guard<std::mutex> lock(publish_mutex_);
+  // Parallel decoders can finish out of order; never publish backwards.
+  if (frame->capture_time < last_published_capture_) {
+    publish_meter_.abandon();
+    return;
   }
+  last_published_capture_ = frame->capture_time;
+  mailbox_.write_slot() = std::move(frame);
+  mailbox_.publish();
+  // The slot handed back is stale; return its frame to the pool now.
+  mailbox_.write_slot().reset();
+  publish_meter_.leave(syzygy::clock::milliseconds_since(start));
 }
 
 }  // namespace syzygy::capture
@@ -3,25 +3,88 @@
 // Copyright (c) 2025 Zoe Gates <zoe@zeocities.dev>
 
 #include "capture/capture_device.hpp"
+#include "capture/conversion_pool.hpp"
+#include "capture/convert_stage.hpp"
+#include "capture/device_capabilities.hpp"
+#include "capture/frame_pool.hpp"
+#include "capture/lease_pool.hpp"
+#include "capture/mjpeg_decoder.hpp"
+#include "capture/mode_policy.hpp"
+#include "capture/pixel_convert.hpp"
+#include "capture/queue_depth_controller.hpp"
+#include "capture/stage_meter.hpp"
+#include "util/seqlock.hpp"
+#include "util/triple_buffer.hpp"
 
+#include <array>
 #include <atomic>
 #include <condition_variable>
 #include <cstdint>
+#include <ctime>
+#include <functional>
+#include <memory>
 #include <mutex>
-#include <optional>
 #include <string>
 #include <thread>
 #include <vector>
 
 namespace syzygy::capture {
 
-struct Frame {
-  uint32_t width{0};
-  uint32_t height{0};
-  uint32_t stride{0};
-  std::vector<uint8_t> rgb;  // RGB24
-  std::chrono::steady_clock::time_point capture_time;
-  std::chrono::steady_clock::time_point dequeue_time;
+enum class MemoryMode {
+  Mmap,
+  UserPtr  // Hugepage arena owned by the session; falls back to Mmap.
+};
+
+enum class SignalState {
+  Unknown,  // The device does not report signal state (e.g. UVC).
+  Locked,
+  NoSignal
+};
+
+// Escalating steps the stall watchdog takes until frames flow again.
+enum class RecoveryAction {
+  RequeueBuffers,  // Return lost buffers to the driver.
+  RestartStream,   // STREAMOFF, fresh buffers, STREAMON on the open fd.
+  ReopenDevice     // Close and reconfigure from scratch.
+};
+
+struct RecoveryEvent {
+  RecoveryAction action{RecoveryAction::RequeueBuffers};
+  bool succeeded{false};
+  // Time without a frame when the step was taken, and the step itself.
+  double stalled_ms{0.0};
+  double duration_ms{0.0};
+};
+
+// Cumulative frame accounting, republished after every dequeued buffer.
+struct CaptureCounters {
+  uint64_t dequeued{0};
+  // Gaps in the driver's sequence numbers: frames lost before dequeue.
+  uint64_t dropped{0};
+  // Flagged V4L2_BUF_FLAG_ERROR or shorter than the format requires.
+  uint64_t errored{0};
+  // Dequeued but never shown: stale in newest-only mode, or a full stage.
+  uint64_t skipped{0};
+  uint32_t last_sequence{0};
+  syzygy::clock::TimePoint last_capture_time;
+  syzygy::clock::TimePoint last_dequeue_time;
+};
+
+struct CaptureStats {
+  LeasePool::Stats leases;
+  FramePool::Stats frames;
+  uint64_t frame_pool_rebuilds{0};
+  CaptureCounters counters;
+  MjpegDecoder::Stats decoder;
+  // Pipeline stages: DQBUF to hand-off, conversion, mailbox publish.
+  StageStats dequeue;
+  StageStats convert;
+  StageStats publish;
+  // CPU time of the session's capture thread, and of shared-pool workers
+  // converting its frames.
+  double capture_cpu_ms{0.0};
+  double convert_cpu_ms{0.0};
+  uint64_t recoveries{0};
 };
 
 class CaptureSession {
@@ -35,38 +98,195 @@ class CaptureSession {
   bool start(const std::string& device_path, LatencyPreset preset);
   void stop();
 
-  bool set_latency_preset(LatencyPreset preset);
-  LatencyPreset latency_preset() const noexcept { return preset_; }
+  // Applied by the capture thread on the open device: the buffer queue is
+  // rebuilt for the new depth and the negotiated format is kept.
+  void set_latency_preset(LatencyPreset preset);
+  LatencyPreset latency_preset() const noexcept {
+    return preset_.load(std::memory_order_relaxed);
+  }
+
+  // Takes effect on the next start().
+  void set_memory_mode(MemoryMode mode) noexcept { memory_mode_ = mode; }
+  MemoryMode memory_mode() const noexcept { return memory_mode_; }
+
+  // Frames the consumer keeps referenced beyond the display's own, e.g. a
+  // history to match against another input. Takes effect on the next
+  // start().
+  void set_held_frames(uint32_t count) noexcept { held_frames_ = count; }
+
+  // Drain every ready buffer on each wakeup and convert only the newest,
+  // so a pipeline that falls behind skips frames instead of adding latency.
+  void set_newest_only(bool enabled) noexcept {
+    newest_only_.store(enabled, std::memory_order_relaxed);
+  }
+
+  // Mode selection inputs; take effect on the next start() or source change.
+  void set_mode_policy(ModePolicy policy) noexcept {
+    mode_policy_.store(policy, std::memory_order_relaxed);
+  }
+  ModePolicy mode_policy() const noexcept {
+    return mode_policy_.load(std::memory_order_relaxed);
+  }
+  void set_display_refresh_hz(double hz) noexcept {
+    display_refresh_hz_.store(hz, std::memory_order_relaxed);
+  }
+
+  // Converts on a pool shared with other sessions instead of a stage
+  // thread of its own. Takes effect on the next start().
+  void set_conversion_pool(std::shared_ptr<ConversionPool> pool) {
+    conversion_pool_ = std::move(pool);
+  }
+  // Largest picture the consumer draws. With a shared pool, raw frames are
+  // decimated to fit (aspect kept) during conversion; zero keeps the
+  // capture size. Cheap enough to call every display frame.
+  void set_output_size(uint32_t width, uint32_t height) noexcept {
+    output_size_.store((uint64_t{width} << 32) | height,
+                       std::memory_order_relaxed);
+  }
+
+  // EDID profile written to the card on the next start(); empty puts the
+  // card's own EDID back.
+  void set_edid_profile(std::string profile_id) {
+    edid_profile_ = std::move(profile_id);
+  }
+
+  // Called on the capture thread after every watchdog step. May be replaced
+  // while running, e.g. when a window adopts an already started session.
+  using RecoveryCallback = std::function<void(const RecoveryEvent&)>;
+  void set_recovery_callback(RecoveryCallback callback) {
+    std::lock_guard<std::mutex> lock(recovery_mutex_);
+    recovery_callback_ = std::move(callback);
+  }
 
   bool is_running() const noexcept { return running_; }
+  // The node passed to the last start().
+  const std::string& device_path() const noexcept { return device_path_; }
+  SignalState signal_state() const noexcept {
+    return signal_state_.load(std::memory_order_acquire);
+  }
 
-  std::optional<Frame> latest_frame() const;
+  // Consumer side of the frame mailbox; call from a single thread.
+  FrameRef latest_frame();
+  uint64_t frame_generation() const noexcept { return mailbox_.generation(); }
 
- private:
-  struct Buffer {
-    void* start{nullptr};
-    size_t length{0};
-  };
+  // Zero-copy access to the most recent raw buffer. Holding the lease keeps
+  // the buffer away from the driver, so drop it as soon as possible.
+  FrameLease acquire_lease() const;
+
+  CaptureStats stats() const;
+  // Lock-free; cheap enough to call every display frame.
+  CaptureCounters counters() const noexcept { return counters_.load(); }
 
+ private:
   bool configure_device();
+  // Picks and applies the capture mode; with locked DV timings only modes
+  // matching the signal exactly are considered.
+  bool select_mode(bool locked);
+  bool set_format(uint32_t pixel_format, uint32_t width, uint32_t height);
+  bool read_format();
+  // Frame pool at the current output size; rebuilt when that changes.
+  bool fit_frame_pool();
+  void output_dimensions(uint32_t& width, uint32_t& height) const;
+  bool start_streaming();
+  void stop_streaming();
+  SignalState lock_dv_timings();
+  bool handle_events();
+  bool handle_source_change();
+  bool apply_latency_preset(LatencyPreset preset);
+  void reset_depth_controller();
+  bool allocate_buffers(uint32_t count);
   void streaming_loop();
+  // Returns false with errno set when no buffer was ready.
+  bool dequeue_buffer(BufferInfo& info);
+  void observe_queue(const BufferInfo& info, double process_ms);
+  void count_buffer(const BufferInfo& info);
+  // Buffers kept queued with the driver; the rest cover in-flight stages.
+  uint32_t queue_depth() const;
+  // Stall watchdog. Hard failures call escalate() directly, starting no
+  // lower than `at_least`.
+  void check_stall();
+  void escalate(const char* reason,
+                RecoveryAction at_least = RecoveryAction::RequeueBuffers);
+  bool recover(RecoveryAction action);
+  syzygy::clock::Clock::duration stall_timeout() const;
+  bool frame_complete(const BufferInfo& info) const;
+  SourceImage describe_source(const FrameLease& lease) const;
+  void publish_frame(FrameRef frame);
   void teardown_buffers();
-  static void yuyv_to_rgb(const uint8_t* src, uint8_t* dst, uint32_t width, uint32_t height);
 
   std::string device_path_;
-  LatencyPreset preset_{LatencyPreset::UltraLow};
+  std::atomic<LatencyPreset> preset_{LatencyPreset::UltraLow};
+  std::atomic<LatencyPreset> requested_preset_{LatencyPreset::UltraLow};
+  std::atomic<bool> preset_change_pending_{false};
+  std::atomic<bool> newest_only_{false};
+
+  std::mutex recovery_mutex_;
+  RecoveryCallback recovery_callback_;
+  std::atomic<uint64_t> recoveries_{0};
+  // Watchdog state, capture thread only. recovery_step_ is the next action
+  // to try and resets once a usable frame arrives.
+  syzygy::clock::TimePoint last_frame_time_;
+  syzygy::clock::TimePoint last_recovery_time_;
+  bool frame_since_start_{false};
+  uint32_t recovery_step_{0};
+  util::Seqlock<CaptureCounters> counters_;
+  // Capture-thread working copy of counters_.
+  CaptureCounters frame_counts_;
+  bool sequence_valid_{false};
+  MemoryMode memory_mode_{MemoryMode::Mmap};
+  uint32_t held_frames_{0};
+  std::string edid_profile_;
+  std::atomic<ModePolicy> mode_policy_{ModePolicy::MaxQuality};
+  std::atomic<double> display_refresh_hz_{0.0};
+
+  // Serialises producers (capture thread, decoder workers) on the mailbox;
+  // the consumer side never takes it.
+  std::mutex publish_mutex_;
+  util::TripleBuffer<FrameRef> mailbox_;
+  syzygy::clock::TimePoint last_published_capture_;
+  std::shared_ptr<FramePool> frame_pool_;
+  uint64_t frame_pool_rebuilds_{0};
 
-  mutable std::mutex frame_mutex_;
-  Frame latest_frame_;
-  bool frame_ready_{false};
+  mutable std::mutex lease_mutex_;
+  FrameLease latest_lease_;
 
   std::thread worker_;
+  // CPU-time clock of worker_, for stats().
+  clockid_t capture_clock_{};
+  bool capture_clock_valid_{false};
   std::atomic<bool> running_{false};
+  std::atomic<SignalState> signal_state_{SignalState::Unknown};
+  // Capture-thread state once running.
+  bool streaming_{false};
 
   int fd_{-1};
+  // V4L2_BUF_TYPE_VIDEO_CAPTURE or _MPLANE, whichever the device speaks.
+  uint32_t buffer_type_{0};
+  // From the capability cache, or probed when the device is new.
+  DeviceCapabilities capabilities_;
+  uint32_t num_planes_{1};
   uint32_t width_{1280};
   uint32_t height_{720};
-  std::vector<Buffer> buffers_;
+  std::array<uint32_t, kMaxPlanes> bytes_per_line_{};
+  uint32_t size_image_{0};
+  uint32_t pixel_format_{0};
+  double fps_{0.0};
+  // Active DV timings, when the device reports them.
+  uint32_t signal_width_{0};
+  uint32_t signal_height_{0};
+  const PixelFormatInfo* format_{nullptr};
+  std::shared_ptr<LeasePool> lease_pool_;
+  std::unique_ptr<MjpegDecoder> mjpeg_decoder_;
+  // Only without a shared pool.
+  std::unique_ptr<ConvertStage> convert_stage_;
+  std::shared_ptr<ConversionPool> conversion_pool_;
+  uint32_t pool_client_{0};
+  std::atomic<uint64_t> output_size_{0};
+  StageMeter dequeue_meter_;
+  StageMeter publish_meter_;
+  // Only for LatencyPreset::Adaptive; owned by the capture thread once
+  // running.
+  std::unique_ptr<QueueDepthController> depth_controller_;
 };
 
 }  // namespace syzygy::capture
@@ -0,0 +1,236 @@
+#include "capture/conversion_pool.hpp"
+
+#include "syzygy/clock.hpp"
+#include "syzygy/log.hpp"
+
+#include <algorithm>
+#include <ctime>
+#include <fstream>
+#include <set>
+#include <string>
+#include <utility>
+
+#include <pthread.h>
+#include <sched.h>
+
+namespace syzygy::capture {
+
+namespace {
+
+std::string read_topology(int cpu, const char* attribute) {
+  std::ifstream input("/sys/devices/system/cpu/cpu" + std::to_string(cpu) +
+                      "/topology/" + attribute);
+  std::string value;
+  std::getline(input, value);
+  return value;
+}
+
+// The first allowed logical CPU of every physical core. SMT siblings share
+// the core's execution units, so a second worker on one buys little for
+// these memory-bound loops.
+std::vector<int> physical_cores() {
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (::sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+    return {};
+  }
+  std::set<std::pair<std::string, std::string>> seen;
+  std::vector<int> cpus;
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+    if (!CPU_ISSET(cpu, &allowed)) {
+      continue;
+    }
+    const std::string core = read_topology(cpu, "core_id");
+    if (core.empty()) {
+      cpus.push_back(cpu);
+      continue;
+    }
+    if (seen.emplace(read_topology(cpu, "physical_package_id"), core).second) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+int64_t thread_cpu_ns() {
+  timespec ts{};
+  ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1'000'000'000 + ts.tv_nsec;
+}
+
+bool convert(const SourceImage& image, Frame& target) {
+  target.layout = PixelLayout::Rgb24;
+  if (target.width == image.width && target.height == image.height) {
+    const PixelFormatInfo* format = find_pixel_format(image.pixel_format);
+    if (format != nullptr && format->convert != nullptr) {
+      format->convert(image, target.rgb.data(), target.stride);
+      return true;
+    }
+  }
+  return convert_decimated(image, target.rgb.data(), target.width,
+                           target.height, target.stride);
+}
+
+}  // namespace
+
+ConversionPool::ConversionPool(size_t worker_count) {
+  const std::vector<int> cores = physical_cores();
+  if (worker_count == 0) {
+    worker_count = cores.empty()
+                       ? std::max(1u, std::thread::hardware_concurrency())
+                       : cores.size();
+  }
+  workers_.reserve(worker_count);
+  for (size_t i = 0; i < worker_count; ++i) {
+    const int cpu = cores.empty() ? -1 : cores[i % cores.size()];
+    workers_.emplace_back([this, cpu]() { run(cpu); });
+  }
+  syzygy::log::info("ConversionPool:", worker_count, "workers over",
+                    cores.size(), "physical cores");
+}
+
+ConversionPool::~ConversionPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  work_cv_.notify_all();
+  for (auto& worker : workers_) {
+    if (worker.joinable()) {
+      worker.join();
+    }
+  }
+}
+
+uint32_t ConversionPool::add_client() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const uint32_t id = next_id_++;
+  clients_.emplace(id, std::make_shared<Client>());
+  return id;
+}
+
+void ConversionPool::remove_client(uint32_t client) {
+  drain(client);
+  std::lock_guard<std::mutex> lock(mutex_);
+  clients_.erase(client);
+}
+
+bool ConversionPool::submit(uint32_t client, FrameLease source,
+                            const SourceImage& image, FrameRef target,
+                            Completion done) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto it = clients_.find(client);
+    if (it == clients_.end()) {
+      return false;
+    }
+    Client& entry = *it->second;
+    if (entry.queue.size() >= kQueueDepth) {
+      entry.meter.drop();
+      return false;
+    }
+    entry.meter.enter();
+    entry.queue.push_back(
+        Job{std::move(source), image, std::move(target), std::move(done)});
+  }
+  work_cv_.notify_one();
+  return true;
+}
+
+void ConversionPool::drain(uint32_t client) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_cv_.wait(lock, [&]() {
+    const auto it = clients_.find(client);
+    return it == clients_.end() ||
+           (it->second->queue.empty() && !it->second->busy);
+  });
+}
+
+ConversionPool::ClientStats ConversionPool::client_stats(
+    uint32_t client) const {
+  std::shared_ptr<Client> entry;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto it = clients_.find(client);
+    if (it == clients_.end()) {
+      return {};
+    }
+    entry = it->second;
+  }
+  ClientStats stats{};
+  stats.stage = entry->meter.stats();
+  stats.cpu_ms =
+      static_cast<double>(entry->cpu_ns.load(std::memory_order_relaxed)) /
+      1e6;
+  return stats;
+}
+
+std::shared_ptr<ConversionPool::Client> ConversionPool::next_client() {
+  if (clients_.empty()) {
+    return nullptr;
+  }
+  // Start just after the client served last and wrap around.
+  auto it = clients_.upper_bound(last_served_);
+  for (size_t visited = 0; visited < clients_.size(); ++visited) {
+    if (it == clients_.end()) {
+      it = clients_.begin();
+    }
+    if (!it->second->busy && !it->second->queue.empty()) {
+      last_served_ = it->first;
+      return it->second;
+    }
+    ++it;
+  }
+  return nullptr;
+}
+
+void ConversionPool::run(int cpu) {
+  if (cpu >= 0) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set) != 0) {
+      syzygy::log::warn("ConversionPool: unable to pin worker to CPU", cpu);
+    }
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    std::shared_ptr<Client> client;
+    work_cv_.wait(lock, [&]() {
+      client = next_client();
+      return stopping_ || client != nullptr;
+    });
+    if (stopping_) {
+      return;
+    }
+    Job job = std::move(client->queue.front());
+    client->queue.pop_front();
+    client->busy = true;
+    lock.unlock();
+
+    const auto start = syzygy::clock::now();
+    const int64_t cpu_before = thread_cpu_ns();
+    const bool converted = convert(job.image, *job.target);
+    client->cpu_ns.fetch_add(thread_cpu_ns() - cpu_before,
+                             std::memory_order_relaxed);
+    const double convert_ms = syzygy::clock::milliseconds_since(start);
+    if (converted) {
+      client->meter.leave(convert_ms);
+      complete_frame(job.source, job.target, job.done, convert_ms);
+    } else {
+      client->meter.abandon();
+    }
+    job = Job{};
+
+    lock.lock();
+    client->busy = false;
+    // Another worker may have skipped this client while it was busy.
+    if (!client->queue.empty()) {
+      work_cv_.notify_one();
+    }
+    idle_cv_.notify_all();
+  }
+}
+
+}  // namespace syzygy::capture
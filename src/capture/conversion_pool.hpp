@@ -0,0 +1,97 @@
+#pragma once
+
+// Copyright (c) 2025 Zoe Gates <zoe@zeocities.dev>
+//
+// Conversion workers shared by several capture sessions, one per physical
+// core and pinned to it, instead of a converting thread per device. Each
+// session is a client with its own short queue; workers serve clients
+// round-robin and convert at most one frame per client at a time, so
+// frames stay in order and a busy input cannot starve the others. The
+// target frame decides the output size: smaller targets are decimated
+// straight from the capture buffer.
+
+#include "capture/frame_pool.hpp"
+#include "capture/lease_pool.hpp"
+#include "capture/pixel_convert.hpp"
+#include "capture/stage_meter.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace syzygy::capture {
+
+class ConversionPool {
+ public:
+  // Called on a worker thread with the converted frame.
+  using Completion = FrameCompletion;
+
+  struct ClientStats {
+    StageStats stage;
+    // Worker CPU time spent on this client's frames so far.
+    double cpu_ms{0.0};
+  };
+
+  // Zero picks one worker per physical core the process may run on.
+  explicit ConversionPool(size_t worker_count = 0);
+  ~ConversionPool();
+
+  ConversionPool(const ConversionPool&) = delete;
+  ConversionPool& operator=(const ConversionPool&) = delete;
+
+  uint32_t add_client();
+  // Waits for the client's queued frames first.
+  void remove_client(uint32_t client);
+
+  // Returns false (and counts a drop) when the client's queue is full,
+  // releasing `source` right away.
+  bool submit(uint32_t client, FrameLease source, const SourceImage& image,
+              FrameRef target, Completion done);
+
+  // Blocks until every frame the client submitted has completed.
+  void drain(uint32_t client);
+
+  ClientStats client_stats(uint32_t client) const;
+  size_t worker_count() const noexcept { return workers_.size(); }
+  // Per client: queued plus the one being converted.
+  static constexpr size_t max_in_flight() noexcept { return kQueueDepth + 1; }
+
+ private:
+  static constexpr size_t kQueueDepth = 2;
+
+  struct Job {
+    FrameLease source;
+    SourceImage image{};
+    FrameRef target;
+    Completion done;
+  };
+
+  struct Client {
+    std::deque<Job> queue;
+    bool busy{false};
+    StageMeter meter;
+    std::atomic<int64_t> cpu_ns{0};
+  };
+
+  void run(int cpu);
+  // Next client with work and no frame on a worker; requires mutex_.
+  std::shared_ptr<Client> next_client();
+
+  mutable std::mutex mutex_;
+  std::condition_variable work_cv_;
+  std::condition_variable idle_cv_;
+  std::map<uint32_t, std::shared_ptr<Client>> clients_;
+  uint32_t next_id_{1};
+  // Round-robin cursor into clients_.
+  uint32_t last_served_{0};
+  bool stopping_{false};
+  std::vector<std::thread> workers_;
+};
+
+}  // namespace syzygy::capture
@@ -0,0 +1,68 @@
+#include "capture/convert_stage.hpp"
+
+namespace syzygy::capture {
+
+ConvertStage::ConvertStage(size_t queue_depth)
+    : queue_(queue_depth), worker_([this]() { run(); }) {}
+
+ConvertStage::~ConvertStage() {
+  queue_.close();
+  if (worker_.joinable()) {
+    worker_.join();
+  }
+}
+
+bool ConvertStage::submit(FrameLease source, const SourceImage& image,
+                          ConvertFn convert, FrameRef target,
+                          Completion done) {
+  Job job;
+  job.source = std::move(source);
+  job.image = image;
+  job.convert = convert;
+  job.target = std::move(target);
+  job.done = std::move(done);
+
+  in_flight_.fetch_add(1, std::memory_order_acq_rel);
+  meter_.enter();
+  if (!queue_.try_push(job)) {
+    meter_.abandon();
+    {
+      std::lock_guard<std::mutex> lock(drain_mutex_);
+      in_flight_.fetch_sub(1, std::memory_order_acq_rel);
+    }
+    drain_cv_.notify_all();
+    return false;
+  }
+  return true;
+}
+
+void ConvertStage::drain() {
+  std::unique_lock<std::mutex> lock(drain_mutex_);
+  drain_cv_.wait(lock, [this]() {
+    return in_flight_.load(std::memory_order_acquire) == 0;
+  });
+}
+
+void ConvertStage::run() {
+  while (queue_.wait()) {
+    auto job = queue_.try_pop();
+    if (!job) {
+      continue;
+    }
+
+    const auto start = syzygy::clock::now();
+    job->convert(job->image, job->target->rgb.data(), job->target->stride);
+    const double convert_ms = syzygy::clock::milliseconds_since(start);
+    meter_.leave(convert_ms);
+    complete_frame(job->source, job->target, job->done, convert_ms);
+    job.reset();
+
+    {
+      std::lock_guard<std::mutex> lock(drain_mutex_);
+      in_flight_.fetch_sub(1, std::memory_order_acq_rel);
+    }
+    drain_cv_.notify_all();
+  }
+}
+
+}  // namespace syzygy::capture
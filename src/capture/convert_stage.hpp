@@ -0,0 +1,71 @@
+#pragma once
+
+// Copyright (c) 2025 Zoe Gates <zoe@zeocities.dev>
+//
+// Conversion stage of the capture pipeline. The capture thread hands each
+// dequeued buffer over a bounded lock-free queue and goes straight back to
+// VIDIOC_DQBUF, so converting frame N overlaps the DMA of frame N+1. The
+// buffer's lease is dropped, and the buffer requeued, as soon as its
+// conversion finishes.
+
+#include "capture/frame_pool.hpp"
+#include "capture/lease_pool.hpp"
+#include "capture/pixel_convert.hpp"
+#include "capture/stage_meter.hpp"
+#include "util/spsc_queue.hpp"
+
+#include "syzygy/clock.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+namespace syzygy::capture {
+
+class ConvertStage {
+ public:
+  // Called on the stage thread with the converted frame.
+  using Completion = FrameCompletion;
+
+  explicit ConvertStage(size_t queue_depth);
+  ~ConvertStage();
+
+  ConvertStage(const ConvertStage&) = delete;
+  ConvertStage& operator=(const ConvertStage&) = delete;
+
+  // Producer side; a single thread only. Returns false (and counts a drop)
+  // when the queue is full, releasing `source` right away.
+  bool submit(FrameLease source, const SourceImage& image, ConvertFn convert,
+              FrameRef target, Completion done);
+
+  // Blocks until every submitted frame has completed.
+  void drain();
+
+  // Queued plus the one being converted.
+  size_t max_in_flight() const noexcept { return queue_.capacity() + 1; }
+  StageStats stats() const noexcept { return meter_.stats(); }
+
+ private:
+  struct Job {
+    FrameLease source;
+    SourceImage image{};
+    ConvertFn convert{nullptr};
+    FrameRef target;
+    Completion done;
+  };
+
+  void run();
+
+  util::SpscQueue<Job> queue_;
+  StageMeter meter_;
+
+  std::mutex drain_mutex_;
+  std::condition_variable drain_cv_;
+  std::atomic<uint32_t> in_flight_{0};
+  std::thread worker_;
+};
+
+}  // namespace syzygy::capture
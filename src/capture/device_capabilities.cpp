@@ -0,0 +1,363 @@
+#include "capture/device_capabilities.hpp"
+
+#include "capture/v4l2_util.hpp"
+#include "util/paths.hpp"
+
+#include "syzygy/log.hpp"
+
+#include <linux/videodev2.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <fstream>
+#include <istream>
+#include <sstream>
+#include <string_view>
+
+namespace syzygy::capture {
+
+namespace {
+
+// Bump when the file layout or the probing changes meaningfully.
+constexpr int kCacheVersion = 1;
+
+bool parse_size(std::string_view text, uint32_t& width, uint32_t& height) {
+  const auto x = text.find('x');
+  if (x == std::string_view::npos) {
+    return false;
+  }
+  try {
+    width = static_cast<uint32_t>(std::stoul(std::string(text.substr(0, x))));
+    height = static_cast<uint32_t>(std::stoul(std::string(text.substr(x + 1))));
+  } catch (const std::exception&) {
+    return false;
+  }
+  return true;
+}
+
+bool parse_interval(const std::string& text, FrameInterval& interval) {
+  const auto slash = text.find('/');
+  if (slash == std::string::npos) {
+    return false;
+  }
+  try {
+    interval.numerator =
+        static_cast<uint32_t>(std::stoul(text.substr(0, slash)));
+    interval.denominator =
+        static_cast<uint32_t>(std::stoul(text.substr(slash + 1)));
+  } catch (const std::exception&) {
+    return false;
+  }
+  return true;
+}
+
+void probe_sizes(int fd, FormatCapabilities& format) {
+  v4l2_frmsizeenum frmsize{};
+  frmsize.pixel_format = format.pixel_format;
+  for (frmsize.index = 0; xioctl(fd, VIDIOC_ENUM_FRAMESIZES, &frmsize);
+       frmsize.index++) {
+    if (frmsize.type != V4L2_FRMSIZE_TYPE_DISCRETE) {
+      format.size_range = true;
+      format.min_width = frmsize.stepwise.min_width;
+      format.max_width = frmsize.stepwise.max_width;
+      format.min_height = frmsize.stepwise.min_height;
+      format.max_height = frmsize.stepwise.max_height;
+      return;
+    }
+
+    FrameSize size{};
+    size.width = frmsize.discrete.width;
+    size.height = frmsize.discrete.height;
+
+    v4l2_frmivalenum frmival{};
+    frmival.pixel_format = format.pixel_format;
+    frmival.width = size.width;
+    frmival.height = size.height;
+    for (frmival.index = 0;
+         xioctl(fd, VIDIOC_ENUM_FRAMEINTERVALS, &frmival);
+         frmival.index++) {
+      if (frmival.type == V4L2_FRMIVAL_TYPE_DISCRETE) {
+        size.intervals.push_back(
+            {frmival.discrete.numerator, frmival.discrete.denominator});
+      } else {
+        size.intervals.push_back({frmival.stepwise.min.numerator,
+                                  frmival.stepwise.min.denominator});
+        size.intervals.push_back({frmival.stepwise.max.numerator,
+                                  frmival.stepwise.max.denominator});
+        break;
+      }
+    }
+    format.sizes.push_back(std::move(size));
+  }
+}
+
+}  // namespace
+
+bool FormatCapabilities::supports_size(uint32_t width,
+                                       uint32_t height) const {
+  if (size_range) {
+    return width >= min_width && width <= max_width &&
+           height >= min_height && height <= max_height;
+  }
+  if (sizes.empty()) {
+    return true;
+  }
+  return std::any_of(sizes.begin(), sizes.end(), [&](const FrameSize& size) {
+    return size.width == width && size.height == height;
+  });
+}
+
+DeviceCapabilities probe_capabilities(int fd, uint32_t buffer_type,
+                                      bool* complete) {
+  DeviceCapabilities caps{};
+  caps.buffer_type = buffer_type;
+
+  v4l2_fmtdesc fmt_desc{};
+  fmt_desc.type = buffer_type;
+  for (fmt_desc.index = 0; xioctl(fd, VIDIOC_ENUM_FMT, &fmt_desc);
+       fmt_desc.index++) {
+    FormatCapabilities format{};
+    format.pixel_format = fmt_desc.pixelformat;
+    probe_sizes(fd, format);
+    caps.formats.push_back(std::move(format));
+  }
+
+  // Some receivers only answer QUERY_DV_TIMINGS; a missing link still
+  // proves the ioctl exists.
+  v4l2_dv_timings_cap timings_cap{};
+  v4l2_dv_timings timings{};
+  caps.dv_timings =
+      xioctl(fd, VIDIOC_DV_TIMINGS_CAP, &timings_cap) ||
+      xioctl(fd, VIDIOC_QUERY_DV_TIMINGS, &timings) || errno == ENOLINK ||
+      errno == ENOLCK || errno == ERANGE;
+
+  // A zero-count REQBUFS frees nothing but reports what the queue can do.
+  v4l2_requestbuffers req{};
+  req.type = buffer_type;
+  req.memory = V4L2_MEMORY_MMAP;
+  const bool queried = xioctl(fd, VIDIOC_REQBUFS, &req);
+  if (queried) {
+    caps.dma_buf = (req.capabilities & V4L2_BUF_CAP_SUPPORTS_DMABUF) != 0;
+  }
+  if (complete) {
+    *complete = queried;
+  }
+
+  v4l2_edid edid{};
+  caps.edid = xioctl(fd, VIDIOC_G_EDID, &edid);
+  return caps;
+}
+
+CapabilityCache::CapabilityCache() {
+  cache_path_ = util::cache_directory() / "capabilities";
+  load();
+}
+
+std::optional<DeviceCapabilities> CapabilityCache::find(
+    const std::string& driver, const std::string& bus,
+    const std::string& card) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto& entry : entries_) {
+    if (entry.driver == driver && entry.bus == bus && entry.card == card) {
+      return entry;
+    }
+  }
+  return std::nullopt;
+}
+
+std::optional<DeviceCapabilities> CapabilityCache::find_by_path(
+    const std::string& path) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto& entry : entries_) {
+    if (entry.path == path) {
+      return entry;
+    }
+  }
+  return std::nullopt;
+}
+
+void CapabilityCache::store(DeviceCapabilities capabilities) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::erase_if(entries_, [&](const DeviceCapabilities& entry) {
+    return (entry.driver == capabilities.driver &&
+            entry.bus == capabilities.bus &&
+            entry.card == capabilities.card) ||
+           entry.path == capabilities.path;
+  });
+  entries_.push_back(std::move(capabilities));
+  save();
+}
+
+void CapabilityCache::invalidate(const std::string& path) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (std::erase_if(entries_, [&](const DeviceCapabilities& entry) {
+        return entry.path == path;
+      }) != 0) {
+    syzygy::log::info("CapabilityCache: invalidated", path);
+    save();
+  }
+}
+
+void CapabilityCache::load() {
+  std::ifstream input(cache_path_);
+  if (!input.is_open()) {
+    return;
+  }
+
+  std::string line;
+  if (!std::getline(input, line) ||
+      line != "version=" + std::to_string(kCacheVersion)) {
+    return;
+  }
+
+  try {
+    parse(input);
+  } catch (const std::exception& ex) {
+    syzygy::log::warn("CapabilityCache: ignoring corrupt cache",
+                      cache_path_.string(), ex.what());
+    entries_.clear();
+    return;
+  }
+
+  // Entries without a key or a buffer type cannot be matched or used.
+  std::erase_if(entries_, [](const DeviceCapabilities& entry) {
+    return entry.driver.empty() || entry.buffer_type == 0;
+  });
+}
+
+void CapabilityCache::parse(std::istream& input) {
+  std::string line;
+  DeviceCapabilities* device = nullptr;
+  while (std::getline(input, line)) {
+    if (line == "[device]") {
+      device = &entries_.emplace_back();
+      continue;
+    }
+    const auto pos = line.find('=');
+    if (!device || pos == std::string::npos) {
+      continue;
+    }
+    const std::string key = line.substr(0, pos);
+    const std::string value = line.substr(pos + 1);
+
+    if (key == "driver") {
+      device->driver = value;
+    } else if (key == "bus") {
+      device->bus = value;
+    } else if (key == "card") {
+      device->card = value;
+    } else if (key == "path") {
+      device->path = value;
+    } else if (key == "buffer_type") {
+      device->buffer_type = static_cast<uint32_t>(std::stoul(value));
+    } else if (key == "dv_timings") {
+      device->dv_timings = value == "1";
+    } else if (key == "dma_buf") {
+      device->dma_buf = value == "1";
+    } else if (key == "edid") {
+      device->edid = value == "1";
+    } else if (key == "format") {
+      auto& format = device->formats.emplace_back();
+      format.pixel_format =
+          static_cast<uint32_t>(std::stoul(value, nullptr, 16));
+    } else if (key == "range" && !device->formats.empty()) {
+      auto& format = device->formats.back();
+      const auto dash = value.find('-');
+      format.size_range =
+          dash != std::string::npos &&
+          parse_size(std::string_view(value).substr(0, dash),
+                     format.min_width, format.min_height) &&
+          parse_size(std::string_view(value).substr(dash + 1),
+                     format.max_width, format.max_height);
+    } else if (key == "size" && !device->formats.empty()) {
+      std::istringstream fields(value);
+      std::string field;
+      FrameSize size{};
+      if (!(fields >> field) || !parse_size(field, size.width, size.height)) {
+        continue;
+      }
+      FrameInterval interval{};
+      while (fields >> field) {
+        if (parse_interval(field, interval)) {
+          size.intervals.push_back(interval);
+        }
+      }
+      device->formats.back().sizes.push_back(std::move(size));
+    }
+  }
+}
+
+void CapabilityCache::save() const {
+  std::error_code ec;
+  std::filesystem::create_directories(cache_path_.parent_path(), ec);
+  std::ofstream output(cache_path_, std::ios::trunc);
+  if (!output.is_open()) {
+    syzygy::log::warn("CapabilityCache: unable to write", cache_path_.string());
+    return;
+  }
+
+  output << "version=" << kCacheVersion << "\n";
+  for (const auto& entry : entries_) {
+    output << "[device]\n";
+    output << "driver=" << entry.driver << "\n";
+    output << "bus=" << entry.bus << "\n";
+    output << "card=" << entry.card << "\n";
+    output << "path=" << entry.path << "\n";
+    output << "buffer_type=" << entry.buffer_type << "\n";
+    output << "dv_timings=" << (entry.dv_timings ? 1 : 0) << "\n";
+    output << "dma_buf=" << (entry.dma_buf ? 1 : 0) << "\n";
+    output << "edid=" << (entry.edid ? 1 : 0) << "\n";
+    for (const auto& format : entry.formats) {
+      output << "format=" << std::hex << format.pixel_format << std::dec
+             << "\n";
+      if (format.size_range) {
+        output << "range=" << format.min_width << "x" << format.min_height
+               << "-" << format.max_width << "x" << format.max_height << "\n";
+      }
+      for (const auto& size : format.sizes) {
+        output << "size=" << size.width << "x" << size.height;
+        for (const auto& interval : size.intervals) {
+          output << " " << interval.numerator << "/" << interval.denominator;
+        }
+        output << "\n";
+      }
+    }
+  }
+}
+
+CapabilityCache& capability_cache() {
+  static CapabilityCache cache;
+  return cache;
+}
+
+DeviceCapabilities cached_capabilities(int fd, const v4l2_capability& caps,
+                                       uint32_t buffer_type,
+                                       const std::string& path) {
+  const std::string driver = reinterpret_cast<const char*>(caps.driver);
+  const std::string bus = reinterpret_cast<const char*>(caps.bus_info);
+  const std::string card = reinterpret_cast<const char*>(caps.card);
+  auto cached = capability_cache().find(driver, bus, card);
+  if (cached && cached->buffer_type == buffer_type) {
+    // Nodes renumber across replugs; find_by_path() and invalidate() go by
+    // the node the device has now.
+    if (cached->path != path) {
+      cached->path = path;
+      capability_cache().store(*cached);
+    }
+    return std::move(*cached);
+  }
+  bool complete = true;
+  DeviceCapabilities capabilities =
+      probe_capabilities(fd, buffer_type, &complete);
+  capabilities.driver = driver;
+  capabilities.bus = bus;
+  capabilities.card = card;
+  capabilities.path = path;
+  // Probed again once the device is idle.
+  if (complete) {
+    capability_cache().store(capabilities);
+  }
+  return capabilities;
+}
+
+}  // namespace syzygy::capture
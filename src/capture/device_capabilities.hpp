@@ -0,0 +1,105 @@
+#pragma once
+
+// Copyright (c) 2025 Zoe Gates <zoe@zeocities.dev>
+//
+// Everything mode selection needs to know about a capture device, and a
+// persistent cache of it. Walking ENUM_FMT / ENUM_FRAMESIZES /
+// ENUM_FRAMEINTERVALS costs hundreds of milliseconds on some UVC cards, so
+// it runs once per device and the result is kept in the XDG cache
+// directory until udev reports the device changed.
+
+#include <cstdint>
+#include <filesystem>
+#include <iosfwd>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+struct v4l2_capability;
+
+namespace syzygy::capture {
+
+struct FrameInterval {
+  uint32_t numerator{0};
+  uint32_t denominator{0};
+};
+
+struct FrameSize {
+  uint32_t width{0};
+  uint32_t height{0};
+  // Stepwise interval ranges are reduced to their two ends.
+  std::vector<FrameInterval> intervals;
+};
+
+struct FormatCapabilities {
+  uint32_t pixel_format{0};
+  std::vector<FrameSize> sizes;
+  // Set when the driver reports a stepwise or continuous size range.
+  bool size_range{false};
+  uint32_t min_width{0};
+  uint32_t max_width{0};
+  uint32_t min_height{0};
+  uint32_t max_height{0};
+
+  // Drivers that enumerate no sizes at all follow the DV timings.
+  bool supports_size(uint32_t width, uint32_t height) const;
+};
+
+struct DeviceCapabilities {
+  // Cache key, straight from VIDIOC_QUERYCAP.
+  std::string driver;
+  std::string bus;
+  std::string card;
+  // Node the entry was last probed through; udev events name nodes.
+  std::string path;
+  uint32_t buffer_type{0};
+  bool dv_timings{false};
+  bool dma_buf{false};
+  bool edid{false};
+  std::vector<FormatCapabilities> formats;
+};
+
+// Runs the full enumeration on an open, idle device node. `complete` is
+// cleared when the buffer queue could not be queried, e.g. because another
+// fd is streaming, leaving dma_buf unknown rather than false.
+DeviceCapabilities probe_capabilities(int fd, uint32_t buffer_type,
+                                      bool* complete = nullptr);
+
+class CapabilityCache {
+ public:
+  CapabilityCache();
+
+  CapabilityCache(const CapabilityCache&) = delete;
+  CapabilityCache& operator=(const CapabilityCache&) = delete;
+
+  std::optional<DeviceCapabilities> find(const std::string& driver,
+                                         const std::string& bus,
+                                         const std::string& card) const;
+  // Whatever was last probed through `path`; device nodes can be
+  // renumbered, so prefer find() once QUERYCAP has been run.
+  std::optional<DeviceCapabilities> find_by_path(const std::string& path) const;
+  void store(DeviceCapabilities capabilities);
+  // Drops entries probed through `path`, e.g. on a udev "change" event.
+  void invalidate(const std::string& path);
+
+ private:
+  void load();
+  void parse(std::istream& input);
+  void save() const;
+
+  std::filesystem::path cache_path_;
+  mutable std::mutex mutex_;
+  std::vector<DeviceCapabilities> entries_;
+};
+
+// Shared by device enumeration and every capture session.
+CapabilityCache& capability_cache();
+
+// The cached entry for the device behind `caps` (its VIDIOC_QUERYCAP
+// answer), probing `fd` and storing the result under `path` on a miss.
+DeviceCapabilities cached_capabilities(int fd, const v4l2_capability& caps,
+                                       uint32_t buffer_type,
+                                       const std::string& path);
+
+}  // namespace syzygy::capture
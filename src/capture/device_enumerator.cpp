@@ -0,0 +1,54 @@
+#include "capture/device_enumerator.hpp"
+
+#include "syzygy/clock.hpp"
+#include "syzygy/log.hpp"
+
+namespace syzygy::capture {
+
+DeviceEnumerator::DeviceEnumerator(Callback callback)
+    : callback_(std::move(callback)) {
+  thread_ = std::thread([this]() { run(); });
+}
+
+DeviceEnumerator::~DeviceEnumerator() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  cv_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+void DeviceEnumerator::request() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_ = true;
+  }
+  cv_.notify_one();
+}
+
+void DeviceEnumerator::run() {
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this]() { return stopping_ || pending_; });
+      if (stopping_) {
+        return;
+      }
+      pending_ = false;
+    }
+
+    const auto started = syzygy::clock::now();
+    auto devices = enumerate_devices();
+    syzygy::log::info("DeviceEnumerator: found", devices.size(),
+                      "capture devices in",
+                      syzygy::clock::milliseconds_since(started), "ms");
+    if (callback_) {
+      callback_(std::move(devices));
+    }
+  }
+}
+
+}  // namespace syzygy::capture
@@ -0,0 +1,42 @@
+#pragma once
+
+// Copyright (c) 2025 Zoe Gates <zoe@zeocities.dev>
+//
+// Runs enumerate_devices() off the caller's thread. The callback fires on
+// the enumerator's thread; UI code must marshal the result itself.
+
+#include "capture/capture_device.hpp"
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace syzygy::capture {
+
+class DeviceEnumerator {
+ public:
+  using Callback = std::function<void(std::vector<CaptureDevice>)>;
+
+  explicit DeviceEnumerator(Callback callback);
+  ~DeviceEnumerator();
+
+  DeviceEnumerator(const DeviceEnumerator&) = delete;
+  DeviceEnumerator& operator=(const DeviceEnumerator&) = delete;
+
+  // Requests made while a scan is running fold into one more scan.
+  void request();
+
+ private:
+  void run();
+
+  Callback callback_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool pending_{false};
+  bool stopping_{false};
+  std::thread thread_;
+};
+
+}  // namespace syzygy::capture
@@ -1,11 +1,62 @@
 #include "capture/device_monitor.hpp"
 
+#include "capture/device_capabilities.hpp"
+
 #include "syzygy/log.hpp"
 
 #include <libudev.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <string_view>
+
 namespace syzygy::capture {
 
+namespace {
+
+#ifdef SYZYGY_HAVE_UDEV
+DeviceEvent::Action parse_action(const char* action) {
+  const std::string_view name = action ? action : "";
+  if (name == "add") {
+    return DeviceEvent::Action::Add;
+  }
+  if (name == "remove") {
+    return DeviceEvent::Action::Remove;
+  }
+  if (name == "change") {
+    return DeviceEvent::Action::Change;
+  }
+  return DeviceEvent::Action::Other;
+}
+
+// USEC_INITIALIZED is CLOCK_MONOTONIC, the clock steady_clock reads on
+// Linux, so hotplug latency can be measured from udev's own timestamp.
+syzygy::clock::TimePoint event_time(udev_device* device,
+                                    DeviceEvent::Action action) {
+  const auto received = syzygy::clock::now();
+  if (action != DeviceEvent::Action::Add) {
+    return received;
+  }
+  const char* value =
+      udev_device_get_property_value(device, "USEC_INITIALIZED");
+  if (!value) {
+    return received;
+  }
+  char* end = nullptr;
+  const unsigned long long usec = std::strtoull(value, &end, 10);
+  if (end == value || usec == 0) {
+    return received;
+  }
+  const syzygy::clock::TimePoint initialized(
+      std::chrono::duration_cast<syzygy::clock::Clock::duration>(
+          std::chrono::microseconds(usec)));
+  return std::min(initialized, received);
+}
+#endif
+
+}  // namespace
+
 DeviceMonitor::DeviceMonitor(Callback callback)
     : callback_(std::move(callback)) {
   running_ = true;
@@ -55,12 +106,22 @@ void DeviceMonitor::run() {
       udev_device* device = udev_monitor_receive_device(monitor);
       if (device) {
         const char* action = udev_device_get_action(device);
+        const char* devnode = udev_device_get_devnode(device);
         if (action) {
           syzygy::log::info("DeviceMonitor event:", action,
-                            udev_device_get_devnode(device));
+                            devnode ? devnode : "");
+        }
+        DeviceEvent event{};
+        event.action = parse_action(action);
+        event.node = devnode ? devnode : "";
+        event.time = event_time(device, event.action);
+        // Firmware or mode switches show up as "change"; whatever was probed
+        // through the node before may no longer hold.
+        if (devnode && event.action == DeviceEvent::Action::Change) {
+          capability_cache().invalidate(devnode);
         }
         if (callback_) {
-          callback_();
+          callback_(event);
         }
         udev_device_unref(device);
       }
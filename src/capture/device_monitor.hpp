@@ -2,15 +2,30 @@
 
 // Copyright (c) 2025 Zoe Gates <zoe@zeocities.dev>
 
+#include "syzygy/clock.hpp"
+
 #include <atomic>
 #include <functional>
+#include <string>
 #include <thread>
 
 namespace syzygy::capture {
 
+struct DeviceEvent {
+  enum class Action { Add, Remove, Change, Other };
+
+  Action action{Action::Other};
+  // e.g. "/dev/video2"; empty when udev gave no node.
+  std::string node;
+  // For an add, when udev initialised the device; otherwise when the event
+  // arrived.
+  syzygy::clock::TimePoint time;
+};
+
 class DeviceMonitor {
  public:
-  using Callback = std::function<void()>;
+  // Fires on the monitor thread.
+  using Callback = std::function<void(const DeviceEvent& event)>;
 
   explicit DeviceMonitor(Callback callback);
   ~DeviceMonitor();
@@ -0,0 +1,499 @@
+#include "capture/edid.hpp"
+
+#include "capture/v4l2_util.hpp"
+#include "util/paths.hpp"
+
+#include "syzygy/log.hpp"
+
+#include <linux/videodev2.h>
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+namespace syzygy::capture {
+
+namespace {
+
+constexpr size_t kBlockSize = 128;
+constexpr std::array<uint8_t, 8> kHeader{0x00, 0xFF, 0xFF, 0xFF,
+                                         0xFF, 0xFF, 0xFF, 0x00};
+
+struct Timing {
+  uint32_t width;
+  uint32_t height;
+  uint32_t h_front;
+  uint32_t h_sync;
+  uint32_t h_blank;
+  uint32_t v_front;
+  uint32_t v_sync;
+  uint32_t v_blank;
+  uint32_t pixel_clock_khz;
+
+  uint32_t h_total() const { return width + h_blank; }
+  uint32_t v_total() const { return height + v_blank; }
+  double refresh_hz() const {
+    return pixel_clock_khz * 1000.0 / (static_cast<double>(h_total()) *
+                                       static_cast<double>(v_total()));
+  }
+};
+
+// CTA-861 timings for the HD modes, CVT reduced blanking for 1440p.
+constexpr Timing k720p60{1280, 720, 110, 40, 370, 5, 5, 30, 74'250};
+constexpr Timing k720p120{1280, 720, 110, 40, 370, 5, 5, 30, 148'500};
+constexpr Timing k1080p60{1920, 1080, 88, 44, 280, 4, 5, 45, 148'500};
+constexpr Timing k1080p120{1920, 1080, 88, 44, 280, 4, 5, 45, 297'000};
+constexpr Timing k1440p120{2560, 1440, 48, 32, 160, 3, 5, 85, 497'760};
+constexpr Timing k1440p144{2560, 1440, 48, 32, 160, 3, 5, 85, 597'310};
+
+struct VicMode {
+  uint8_t vic;
+  EdidMode mode;
+};
+
+constexpr VicMode kVics[] = {
+    {4, {1280, 720, 60.0}},     {16, {1920, 1080, 60.0}},
+    {19, {1280, 720, 50.0}},    {31, {1920, 1080, 50.0}},
+    {34, {1920, 1080, 30.0}},   {47, {1280, 720, 120.0}},
+    {63, {1920, 1080, 120.0}},  {64, {1920, 1080, 100.0}},
+    {95, {3840, 2160, 30.0}},   {97, {3840, 2160, 60.0}},
+};
+
+struct BuiltinProfile {
+  const char* name;
+  const char* description;
+  std::vector<Timing> timings;  // First one is the preferred mode.
+  std::vector<uint8_t> vics;
+};
+
+const std::vector<BuiltinProfile>& builtin_profiles() {
+  static const std::vector<BuiltinProfile> profiles = {
+      {"1080p60", "1080p60 (compatible)", {k1080p60, k720p60}, {16, 4}},
+      {"1080p120",
+       "1080p120 / 720p120",
+       {k1080p120, k1080p60, k720p120},
+       {63, 16, 47, 4}},
+      {"1440p144",
+       "1440p144 / 1080p120",
+       {k1440p144, k1440p120, k1080p120, k1080p60},
+       {63, 16, 4}},
+  };
+  return profiles;
+}
+
+void write_checksum(uint8_t* block) {
+  uint8_t sum = 0;
+  for (size_t i = 0; i + 1 < kBlockSize; ++i) {
+    sum = static_cast<uint8_t>(sum + block[i]);
+  }
+  block[kBlockSize - 1] = static_cast<uint8_t>(0x100 - sum);
+}
+
+void write_dtd(const Timing& t, uint8_t* out) {
+  // 698 x 393 mm, a 31.5" 16:9 panel.
+  constexpr uint32_t kWidthMm = 698;
+  constexpr uint32_t kHeightMm = 393;
+  const uint32_t clock = t.pixel_clock_khz / 10;
+  out[0] = clock & 0xFF;
+  out[1] = (clock >> 8) & 0xFF;
+  out[2] = t.width & 0xFF;
+  out[3] = t.h_blank & 0xFF;
+  out[4] = static_cast<uint8_t>(((t.width >> 8) << 4) | (t.h_blank >> 8));
+  out[5] = t.height & 0xFF;
+  out[6] = t.v_blank & 0xFF;
+  out[7] = static_cast<uint8_t>(((t.height >> 8) << 4) | (t.v_blank >> 8));
+  out[8] = t.h_front & 0xFF;
+  out[9] = t.h_sync & 0xFF;
+  out[10] = static_cast<uint8_t>(((t.v_front & 0xF) << 4) | (t.v_sync & 0xF));
+  out[11] = static_cast<uint8_t>((((t.h_front >> 8) & 3) << 6) |
+                                 (((t.h_sync >> 8) & 3) << 4) |
+                                 (((t.v_front >> 4) & 3) << 2) |
+                                 ((t.v_sync >> 4) & 3));
+  out[12] = kWidthMm & 0xFF;
+  out[13] = kHeightMm & 0xFF;
+  out[14] = static_cast<uint8_t>(((kWidthMm >> 8) << 4) | (kHeightMm >> 8));
+  // Digital separate sync, both polarities positive.
+  out[17] = 0x1E;
+}
+
+void write_text_descriptor(uint8_t tag, const char* text, uint8_t* out) {
+  out[3] = tag;
+  size_t i = 0;
+  for (; text[i] != '\0' && i < 13; ++i) {
+    out[5 + i] = static_cast<uint8_t>(text[i]);
+  }
+  if (i < 13) {
+    out[5 + i++] = 0x0A;
+  }
+  for (; i < 13; ++i) {
+    out[5 + i] = 0x20;
+  }
+}
+
+std::vector<uint8_t> build_edid(const BuiltinProfile& profile) {
+  std::vector<uint8_t> edid(2 * kBlockSize, 0);
+  uint8_t* base = edid.data();
+  std::copy(kHeader.begin(), kHeader.end(), base);
+  // Manufacturer "SYZ".
+  base[8] = 0x4F;
+  base[9] = 0x3A;
+  // Product code: the preferred refresh rate.
+  base[10] = static_cast<uint8_t>(profile.timings.front().refresh_hz());
+  base[17] = 35;  // 2025
+  base[18] = 1;
+  base[19] = 3;
+  base[20] = 0x80;  // Digital input.
+  base[21] = 70;
+  base[22] = 39;
+  base[23] = 0x78;  // Gamma 2.2.
+  base[24] = 0x0A;  // RGB, preferred timing in the first descriptor.
+  constexpr uint8_t kSrgbChromaticity[] = {0xEE, 0x91, 0xA3, 0x54, 0x4C,
+                                           0x99, 0x26, 0x0F, 0x50, 0x54};
+  std::copy(std::begin(kSrgbChromaticity), std::end(kSrgbChromaticity),
+            base + 25);
+  base[35] = 0x21;  // 640x480@60, 800x600@60.
+  base[36] = 0x08;  // 1024x768@60.
+  std::fill(base + 38, base + 54, 0x01);
+
+  double max_refresh = 0.0;
+  double max_hfreq_khz = 0.0;
+  uint32_t max_clock_khz = 0;
+  for (const auto& timing : profile.timings) {
+    max_refresh = std::max(max_refresh, timing.refresh_hz());
+    max_hfreq_khz = std::max(
+        max_hfreq_khz, static_cast<double>(timing.pixel_clock_khz) /
+                           static_cast<double>(timing.h_total()));
+    max_clock_khz = std::max(max_clock_khz, timing.pixel_clock_khz);
+  }
+
+  const size_t base_dtds = std::min<size_t>(profile.timings.size(), 2);
+  for (size_t i = 0; i < base_dtds; ++i) {
+    write_dtd(profile.timings[i], base + 54 + 18 * i);
+  }
+  uint8_t* descriptor = base + 54 + 18 * base_dtds;
+  // Range limits: 24 Hz up to the fastest mode, GTF default.
+  descriptor[3] = 0xFD;
+  descriptor[5] = 24;
+  descriptor[6] = static_cast<uint8_t>(std::min(255.0, max_refresh + 1.0));
+  descriptor[7] = 15;
+  descriptor[8] = static_cast<uint8_t>(std::min(255.0, max_hfreq_khz + 1.0));
+  descriptor[9] = static_cast<uint8_t>((max_clock_khz + 9'999) / 10'000);
+  descriptor[11] = 0x0A;
+  std::fill(descriptor + 12, descriptor + 18, 0x20);
+  descriptor += 18;
+  write_text_descriptor(0xFC, "Syzygy", descriptor);
+  base[126] = 1;
+  write_checksum(base);
+
+  uint8_t* cta = edid.data() + kBlockSize;
+  cta[0] = 0x02;
+  cta[1] = 0x03;
+  cta[3] = 0x70;  // Basic audio, YCbCr 4:4:4 and 4:2:2.
+  size_t offset = 4;
+  cta[offset++] = static_cast<uint8_t>((2 << 5) | profile.vics.size());
+  for (size_t i = 0; i < profile.vics.size(); ++i) {
+    cta[offset++] =
+        static_cast<uint8_t>(profile.vics[i] | (i == 0 ? 0x80 : 0x00));
+  }
+  // LPCM stereo at 32/44.1/48 kHz, 16/20/24 bit.
+  const uint8_t audio[] = {(1 << 5) | 3, 0x09, 0x07, 0x07};
+  std::copy(std::begin(audio), std::end(audio), cta + offset);
+  offset += sizeof(audio);
+  const uint8_t speakers[] = {(4 << 5) | 3, 0x01, 0x00, 0x00};
+  std::copy(std::begin(speakers), std::end(speakers), cta + offset);
+  offset += sizeof(speakers);
+  // HDMI 1.4 VSDB, physical address 1.0.0.0, max TMDS clock in 5 MHz units,
+  // rounded up so the fastest mode stays within it.
+  const uint8_t tmds = static_cast<uint8_t>(std::min<uint32_t>(
+      255, (std::max<uint32_t>(max_clock_khz, 165'000) + 4'999) / 5'000));
+  const uint8_t hdmi14_tmds = std::min<uint8_t>(tmds, 340 / 5);
+  const uint8_t hdmi[] = {(3 << 5) | 7, 0x03, 0x0C, 0x00, 0x10,
+                          0x00,         0x00, hdmi14_tmds};
+  std::copy(std::begin(hdmi), std::end(hdmi), cta + offset);
+  offset += sizeof(hdmi);
+  if (max_clock_khz > 340'000) {
+    // HDMI Forum VSDB, required above 340 MHz. SCDC_Present, since the
+    // source has to enable scrambling over SCDC at those rates.
+    const uint8_t hf[] = {(3 << 5) | 7, 0xD8, 0x5D, 0xC4, 0x01,
+                          tmds,         0x80, 0x00};
+    std::copy(std::begin(hf), std::end(hf), cta + offset);
+    offset += sizeof(hf);
+  }
+  cta[2] = static_cast<uint8_t>(offset);
+  for (size_t i = base_dtds; i < profile.timings.size(); ++i) {
+    if (offset + 18 > kBlockSize - 1) {
+      break;
+    }
+    write_dtd(profile.timings[i], cta + offset);
+    offset += 18;
+  }
+  write_checksum(cta);
+  return edid;
+}
+
+void parse_dtd(const uint8_t* d, std::vector<EdidMode>& modes) {
+  const uint32_t clock_10khz = d[0] | (d[1] << 8);
+  if (clock_10khz == 0) {
+    return;
+  }
+  const uint32_t width = d[2] | ((d[4] & 0xF0) << 4);
+  const uint32_t h_blank = d[3] | ((d[4] & 0x0F) << 8);
+  uint32_t height = d[5] | ((d[7] & 0xF0) << 4);
+  const uint32_t v_blank = d[6] | ((d[7] & 0x0F) << 8);
+  const uint64_t total = static_cast<uint64_t>(width + h_blank) *
+                         static_cast<uint64_t>(height + v_blank);
+  if (total == 0) {
+    return;
+  }
+  double refresh = clock_10khz * 10'000.0 / static_cast<double>(total);
+  if (d[17] & 0x80) {
+    // Interlaced: the descriptor holds one field.
+    height *= 2;
+  }
+  modes.push_back({width, height, refresh});
+}
+
+bool valid_edid(const std::vector<uint8_t>& data) {
+  return data.size() >= kBlockSize && data.size() % kBlockSize == 0 &&
+         std::equal(kHeader.begin(), kHeader.end(), data.begin());
+}
+
+std::vector<EdidProfile> user_profiles() {
+  std::vector<EdidProfile> profiles;
+  const auto directory = util::config_directory() / "edid";
+  std::error_code ec;
+  for (const auto& entry :
+       std::filesystem::directory_iterator(directory, ec)) {
+    if (!entry.is_regular_file() || entry.path().extension() != ".bin") {
+      continue;
+    }
+    std::ifstream input(entry.path(), std::ios::binary);
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(input)),
+                              std::istreambuf_iterator<char>());
+    if (!valid_edid(data)) {
+      syzygy::log::warn("EDID: ignoring malformed profile",
+                        entry.path().string());
+      continue;
+    }
+    const std::string stem = entry.path().stem().string();
+    profiles.push_back({"user:" + stem, stem, std::move(data)});
+  }
+  std::sort(profiles.begin(), profiles.end(),
+            [](const EdidProfile& a, const EdidProfile& b) {
+              return a.id < b.id;
+            });
+  return profiles;
+}
+
+// Where the card's own EDID is kept while a profile replaces it. A
+// subdirectory, so user_profiles() does not offer it.
+std::filesystem::path original_edid_path(const std::string& card_key) {
+  std::string name = card_key;
+  std::replace_if(
+      name.begin(), name.end(),
+      [](char c) { return !std::isalnum(static_cast<unsigned char>(c)); },
+      '_');
+  return util::config_directory() / "edid" / "original" / (name + ".bin");
+}
+
+// Keeps `current` unless an original is already saved or it is one of our
+// own profiles, i.e. the card still has what an earlier run wrote.
+void save_original_edid(const std::vector<uint8_t>& current,
+                        const std::string& card_key) {
+  const auto path = original_edid_path(card_key);
+  std::error_code ec;
+  if (current.empty() || card_key.empty() ||
+      std::filesystem::exists(path, ec)) {
+    return;
+  }
+  for (const auto& profile : edid_profiles()) {
+    if (profile.data == current) {
+      return;
+    }
+  }
+  std::filesystem::create_directories(path.parent_path(), ec);
+  std::ofstream output(path, std::ios::binary | std::ios::trunc);
+  output.write(reinterpret_cast<const char*>(current.data()),
+               static_cast<std::streamsize>(current.size()));
+  if (!output) {
+    syzygy::log::warn("EDID: unable to save the card's EDID to",
+                      path.string());
+  }
+}
+
+}  // namespace
+
+std::vector<uint8_t> read_edid(int fd) {
+  v4l2_edid request{};
+  if (!xioctl(fd, VIDIOC_G_EDID, &request) || request.blocks == 0) {
+    return {};
+  }
+  std::vector<uint8_t> data(static_cast<size_t>(request.blocks) * kBlockSize);
+  request.start_block = 0;
+  request.edid = data.data();
+  if (!xioctl(fd, VIDIOC_G_EDID, &request)) {
+    return {};
+  }
+  data.resize(static_cast<size_t>(request.blocks) * kBlockSize);
+  return data;
+}
+
+bool write_edid(int fd, const std::vector<uint8_t>& edid) {
+  if (!valid_edid(edid)) {
+    return false;
+  }
+  std::vector<uint8_t> data = edid;
+  v4l2_edid request{};
+  request.blocks = static_cast<uint32_t>(data.size() / kBlockSize);
+  request.edid = data.data();
+  if (xioctl(fd, VIDIOC_S_EDID, &request)) {
+    return true;
+  }
+  if (errno != E2BIG || request.blocks == 0) {
+    syzygy::log::warn("EDID: VIDIOC_S_EDID failed", std::strerror(errno));
+    return false;
+  }
+
+  // The receiver stores fewer blocks; drop the extensions it cannot hold.
+  const uint32_t max_blocks = request.blocks;
+  data.resize(static_cast<size_t>(max_blocks) * kBlockSize);
+  data[126] = static_cast<uint8_t>(max_blocks - 1);
+  write_checksum(data.data());
+  request = {};
+  request.blocks = max_blocks;
+  request.edid = data.data();
+  if (!xioctl(fd, VIDIOC_S_EDID, &request)) {
+    syzygy::log::warn("EDID: VIDIOC_S_EDID failed", std::strerror(errno));
+    return false;
+  }
+  syzygy::log::info("EDID: card holds", max_blocks, "blocks, truncated");
+  return true;
+}
+
+std::vector<EdidMode> edid_modes(const std::vector<uint8_t>& edid) {
+  std::vector<EdidMode> modes;
+  if (!valid_edid(edid)) {
+    return modes;
+  }
+  for (size_t offset = 54; offset < 126; offset += 18) {
+    parse_dtd(edid.data() + offset, modes);
+  }
+  for (size_t block = kBlockSize; block + kBlockSize <= edid.size();
+       block += kBlockSize) {
+    const uint8_t* cta = edid.data() + block;
+    if (cta[0] != 0x02) {
+      continue;
+    }
+    const size_t dtd_offset = std::min<size_t>(cta[2], kBlockSize - 1);
+    for (size_t i = 4; i < dtd_offset;) {
+      const uint8_t tag = cta[i] >> 5;
+      const uint8_t length = cta[i] & 0x1F;
+      if (tag == 2) {
+        for (size_t v = 1; v <= length && i + v < dtd_offset; ++v) {
+          const uint8_t vic = cta[i + v] & 0x7F;
+          for (const auto& known : kVics) {
+            if (known.vic == vic) {
+              modes.push_back(known.mode);
+            }
+          }
+        }
+      }
+      i += 1 + length;
+    }
+    for (size_t offset = dtd_offset; offset + 18 < kBlockSize; offset += 18) {
+      parse_dtd(cta + offset, modes);
+    }
+  }
+
+  // Short video descriptors usually repeat the detailed timings.
+  std::vector<EdidMode> unique;
+  for (const auto& mode : modes) {
+    const bool seen = std::any_of(
+        unique.begin(), unique.end(), [&](const EdidMode& other) {
+          return other.width == mode.width && other.height == mode.height &&
+                 std::abs(other.refresh_hz - mode.refresh_hz) < 0.5;
+        });
+    if (!seen) {
+      unique.push_back(mode);
+    }
+  }
+  return unique;
+}
+
+std::vector<EdidProfile> edid_profiles() {
+  std::vector<EdidProfile> profiles;
+  for (const auto& builtin : builtin_profiles()) {
+    profiles.push_back({std::string("builtin:") + builtin.name,
+                        builtin.description, build_edid(builtin)});
+  }
+  auto user = user_profiles();
+  std::move(user.begin(), user.end(), std::back_inserter(profiles));
+  return profiles;
+}
+
+std::optional<EdidProfile> find_edid_profile(const std::string& id) {
+  for (auto& profile : edid_profiles()) {
+    if (profile.id == id) {
+      return std::move(profile);
+    }
+  }
+  return std::nullopt;
+}
+
+bool apply_edid_profile(int fd, const EdidProfile& profile,
+                        const std::string& card_key) {
+  const auto current = read_edid(fd);
+  // Cards that truncate report only the blocks they kept.
+  const bool applied =
+      current == profile.data ||
+      (!current.empty() && current.size() < profile.data.size() &&
+       std::equal(current.begin(), current.begin() + 126,
+                  profile.data.begin()));
+  if (applied) {
+    return true;
+  }
+  save_original_edid(current, card_key);
+  if (!write_edid(fd, profile.data)) {
+    return false;
+  }
+
+  std::string summary;
+  for (const auto& mode : edid_modes(profile.data)) {
+    summary += std::to_string(mode.width) + "x" + std::to_string(mode.height) +
+               "@" + std::to_string(static_cast<int>(mode.refresh_hz + 0.5)) +
+               " ";
+  }
+  syzygy::log::info("EDID: applied", profile.id, "advertising", summary);
+  return true;
+}
+
+bool restore_card_edid(int fd, const std::string& card_key) {
+  if (card_key.empty()) {
+    return false;
+  }
+  const auto path = original_edid_path(card_key);
+  std::ifstream input(path, std::ios::binary);
+  if (!input) {
+    return false;
+  }
+  const std::vector<uint8_t> original((std::istreambuf_iterator<char>(input)),
+                                      std::istreambuf_iterator<char>());
+  input.close();
+  if (read_edid(fd) != original) {
+    if (!write_edid(fd, original)) {
+      return false;
+    }
+    syzygy::log::info("EDID: restored the card's own EDID");
+  }
+  std::error_code ec;
+  std::filesystem::remove(path, ec);
+  return true;
+}
+
+}  // namespace syzygy::capture
@@ -0,0 +1,50 @@
+#pragma once
+
+// Copyright (c) 2025 Zoe Gates <zoe@zeocities.dev>
+//
+// EDID access for HDMI capture cards. The EDID a receiver advertises decides
+// which modes a source will send, so swapping it is how high refresh modes
+// (1080p120, 1440p144) are unlocked on cards that can capture them.
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace syzygy::capture {
+
+struct EdidMode {
+  uint32_t width{0};
+  uint32_t height{0};
+  double refresh_hz{0.0};
+};
+
+struct EdidProfile {
+  // "builtin:<name>" or "user:<file stem>".
+  std::string id;
+  std::string description;
+  std::vector<uint8_t> data;
+};
+
+// Empty when the device has no EDID (UVC bridges, webcams).
+std::vector<uint8_t> read_edid(int fd);
+bool write_edid(int fd, const std::vector<uint8_t>& edid);
+
+// Detailed timing descriptors from the base block and CTA extensions.
+std::vector<EdidMode> edid_modes(const std::vector<uint8_t>& edid);
+
+// Built-in profiles followed by *.bin files from the config directory.
+std::vector<EdidProfile> edid_profiles();
+std::optional<EdidProfile> find_edid_profile(const std::string& id);
+
+// Writes the profile unless the card already advertises it. The source
+// renegotiates afterwards, which arrives as a V4L2 source change. Cards keep
+// a written EDID until power cycled, so the first write saves the card's
+// own under `card_key` (its bus) for restore_card_edid().
+bool apply_edid_profile(int fd, const EdidProfile& profile,
+                        const std::string& card_key);
+
+// Puts back the EDID saved by apply_edid_profile(), if there is one.
+bool restore_card_edid(int fd, const std::string& card_key);
+
+}  // namespace syzygy::capture
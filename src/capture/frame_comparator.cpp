@@ -0,0 +1,185 @@
+#include "capture/frame_comparator.hpp"
+
+#include "syzygy/clock.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace syzygy::capture {
+
+namespace {
+
+// Sessions publish at most every few milliseconds; a short sleep keeps the
+// pairing close to real time without a wakeup per frame from each side.
+constexpr auto kPollInterval = std::chrono::milliseconds(1);
+// Rows sampled when scoring candidates; 1080p gives 135 rows each.
+constexpr uint32_t kScoreRowStep = 8;
+
+}  // namespace
+
+FrameComparator::FrameComparator(CaptureSession& a, CaptureSession& b)
+    : session_a_(a),
+      session_b_(b),
+      last_b_arrival_(std::chrono::steady_clock::now()) {
+  thread_ = std::thread([this]() { run(); });
+}
+
+FrameComparator::~FrameComparator() {
+  stopping_.store(true, std::memory_order_release);
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+FrameComparator::Pair FrameComparator::latest_pair() {
+  heat_wanted_.store(true, std::memory_order_relaxed);
+  std::lock_guard<std::mutex> lock(pair_mutex_);
+  return pair_;
+}
+
+void FrameComparator::run() {
+  while (!stopping_.load(std::memory_order_acquire)) {
+    const auto now = std::chrono::steady_clock::now();
+    bool busy = poll(session_a_, generation_a_, history_a_);
+    if (poll(session_b_, generation_b_, history_b_)) {
+      last_b_arrival_ = now;
+      busy = true;
+    }
+    while (history_b_.size() > kHistory) {
+      history_b_.pop_front();
+    }
+    while (match_next(now)) {
+      busy = true;
+    }
+    if (!busy) {
+      std::this_thread::sleep_for(kPollInterval);
+    }
+  }
+}
+
+bool FrameComparator::poll(CaptureSession& session, uint64_t& generation,
+                           std::deque<FrameRef>& history) {
+  const uint64_t current = session.frame_generation();
+  if (current == generation) {
+    return false;
+  }
+  generation = current;
+  FrameRef frame = session.latest_frame();
+  if (!frame) {
+    return false;
+  }
+  history.push_back(std::move(frame));
+  return true;
+}
+
+bool FrameComparator::match_next(TimePoint now) {
+  if (history_a_.empty()) {
+    return false;
+  }
+  const FrameRef a = history_a_.front();
+  const TimePoint captured = a->capture_time;
+  // Wait until every B frame that could match has arrived, unless B has
+  // stopped delivering or A's history is full.
+  const bool caught_up = !history_b_.empty() &&
+                         history_b_.back()->capture_time >= captured + kWindow;
+  const bool stalled = now - last_b_arrival_ > 2 * kWindow;
+  if (!caught_up && !stalled && history_a_.size() < kHistory) {
+    return false;
+  }
+  history_a_.pop_front();
+
+  const auto started = syzygy::clock::now();
+  const double expected_ms = median_offset();
+  FrameRef best;
+  uint64_t best_score = 0;
+  double best_offset_ms = 0.0;
+  bool size_mismatch = false;
+  for (const FrameRef& b : history_b_) {
+    const auto gap = b->capture_time - captured;
+    if (gap < -kWindow || gap > kWindow) {
+      continue;
+    }
+    if (b->width != a->width || b->height != a->height) {
+      size_mismatch = true;
+      continue;
+    }
+    const double offset_ms =
+        std::chrono::duration<double, std::milli>(gap).count();
+    const uint64_t score = sampled_difference(*a, *b, kScoreRowStep);
+    // On a still picture every candidate scores the same; stay with the
+    // offset seen so far.
+    const bool better =
+        !best || score < best_score ||
+        (score == best_score && std::abs(offset_ms - expected_ms) <
+                                    std::abs(best_offset_ms - expected_ms));
+    if (better) {
+      best = b;
+      best_score = score;
+      best_offset_ms = offset_ms;
+    }
+  }
+
+  if (!best) {
+    if (size_mismatch) {
+      totals_.size_mismatches++;
+    } else {
+      totals_.unmatched++;
+    }
+    stats_.store(totals_);
+    return true;
+  }
+  record_pair(a, best, best_offset_ms,
+              syzygy::clock::milliseconds_since(started));
+  return true;
+}
+
+void FrameComparator::record_pair(const FrameRef& a, const FrameRef& b,
+                                  double offset_ms, double match_ms) {
+  const auto started = syzygy::clock::now();
+  std::shared_ptr<FrameSnapshot> heat_map;
+  if (heat_wanted_.exchange(false, std::memory_order_relaxed)) {
+    heat_map = std::make_shared<FrameSnapshot>();
+  }
+  FrameDifference difference;
+  compare_frames(*a, *b, difference, heat_map.get());
+
+  offsets_[offset_count_ % offsets_.size()] = offset_ms;
+  offset_count_++;
+
+  totals_.pairs++;
+  totals_.psnr_db = difference.psnr_db;
+  totals_.max_abs_diff = difference.max_abs_diff;
+  totals_.min_psnr_db = totals_.pairs == 1
+                            ? difference.psnr_db
+                            : std::min(totals_.min_psnr_db,
+                                       difference.psnr_db);
+  totals_.worst_abs_diff =
+      std::max<uint32_t>(totals_.worst_abs_diff, difference.max_abs_diff);
+  totals_.offset_ms = median_offset();
+  compare_ms_total_ += match_ms + syzygy::clock::milliseconds_since(started);
+  totals_.compare_ms = compare_ms_total_ / static_cast<double>(totals_.pairs);
+  totals_.valid = true;
+  stats_.store(totals_);
+
+  std::lock_guard<std::mutex> lock(pair_mutex_);
+  pair_.a = a;
+  pair_.b = b;
+  if (heat_map) {
+    pair_.heat_map = std::move(heat_map);
+  }
+  pair_.generation++;
+}
+
+double FrameComparator::median_offset() const {
+  const size_t count = std::min(offset_count_, offsets_.size());
+  if (count == 0) {
+    return 0.0;
+  }
+  std::array<double, 16> sorted = offsets_;
+  const auto middle = sorted.begin() + static_cast<std::ptrdiff_t>(count / 2);
+  std::nth_element(sorted.begin(), middle,
+                   sorted.begin() + static_cast<std::ptrdiff_t>(count));
+  return *middle;
+}
+
+}  // namespace syzygy::capture
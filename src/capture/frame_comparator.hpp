@@ -0,0 +1,116 @@
+#pragma once
+
+// Copyright (c) 2025 Zoe Gates <zoe@zeocities.dev>
+//
+// Pairs the frames of two running sessions that show the same picture and
+// measures how they differ. Each frame of input A is matched against the
+// B frames captured within kWindow of it; a coarse row-sampled score picks
+// the closest, so the pairing follows content rather than trusting the two
+// clocks. The median capture-time gap of recent pairs is the offset
+// between the inputs.
+
+#include "capture/capture_session.hpp"
+#include "capture/frame_compare.hpp"
+#include "capture/frame_pool.hpp"
+#include "capture/frame_snapshot.hpp"
+#include "util/seqlock.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace syzygy::capture {
+
+struct ComparisonStats {
+  uint64_t pairs{0};
+  // A frames with no B frame inside the window.
+  uint64_t unmatched{0};
+  // A frames whose only candidates had another size.
+  uint64_t size_mismatches{0};
+  // Of the last pair; infinite when identical.
+  double psnr_db{0.0};
+  uint32_t max_abs_diff{0};
+  // Worst since the comparator started.
+  double min_psnr_db{0.0};
+  uint32_t worst_abs_diff{0};
+  // How much later B captures the same picture than A (median of recent
+  // pairs); negative when B is ahead.
+  double offset_ms{0.0};
+  // Matching plus the full comparison, per pair.
+  double compare_ms{0.0};
+  bool valid{false};
+};
+
+class FrameComparator {
+ public:
+  static constexpr auto kWindow = std::chrono::milliseconds(50);
+  // Recent frames kept per input; enough for kWindow either side at 60 Hz.
+  static constexpr uint32_t kHistory = 8;
+  // What each session must allow for with set_held_frames(): the history
+  // plus the pair handed to the consumer.
+  static constexpr uint32_t kHeldFrames = kHistory + 1;
+
+  // Becomes the only consumer of both sessions' latest_frame(); they must
+  // outlive the comparator.
+  FrameComparator(CaptureSession& a, CaptureSession& b);
+  ~FrameComparator();
+
+  FrameComparator(const FrameComparator&) = delete;
+  FrameComparator& operator=(const FrameComparator&) = delete;
+
+  struct Pair {
+    FrameRef a;
+    FrameRef b;
+    // Null until one has been computed.
+    std::shared_ptr<const FrameSnapshot> heat_map;
+    uint64_t generation{0};
+  };
+
+  // The most recently compared pair. Heat maps are only drawn while
+  // someone calls this, one per call.
+  Pair latest_pair();
+  ComparisonStats stats() const noexcept { return stats_.load(); }
+
+ private:
+  using TimePoint = std::chrono::steady_clock::time_point;
+
+  void run();
+  // Appends the session's newest frame when there is one; returns whether
+  // it did.
+  bool poll(CaptureSession& session, uint64_t& generation,
+            std::deque<FrameRef>& history);
+  // Matches the oldest A frame once B has caught up with it.
+  bool match_next(TimePoint now);
+  void record_pair(const FrameRef& a, const FrameRef& b, double offset_ms,
+                   double match_ms);
+  double median_offset() const;
+
+  CaptureSession& session_a_;
+  CaptureSession& session_b_;
+
+  // Comparator thread only.
+  std::deque<FrameRef> history_a_;
+  std::deque<FrameRef> history_b_;
+  uint64_t generation_a_{0};
+  uint64_t generation_b_{0};
+  TimePoint last_b_arrival_{};
+  std::array<double, 16> offsets_{};
+  size_t offset_count_{0};
+  double compare_ms_total_{0.0};
+  ComparisonStats totals_{};
+
+  std::atomic<bool> heat_wanted_{true};
+  std::mutex pair_mutex_;
+  Pair pair_;
+
+  util::Seqlock<ComparisonStats> stats_;
+  std::atomic<bool> stopping_{false};
+  std::thread thread_;
+};
+
+}  // namespace syzygy::capture
@@ -0,0 +1,191 @@
+#include "capture/frame_compare.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace syzygy::capture {
+
+namespace {
+
+struct RowTotals {
+  uint64_t sse{0};
+  uint8_t peak{0};
+};
+
+// Squared and largest byte differences over `bytes` bytes; also stores
+// |a - b| per byte when `absdiff` is set.
+void diff_row(const uint8_t* a, const uint8_t* b, size_t bytes,
+              uint8_t* absdiff, RowTotals& totals) {
+  size_t i = 0;
+#if defined(__SSE2__)
+  const __m128i zero = _mm_setzero_si128();
+  // Each 32-bit lane gains at most 4 * 255^2 per step, so rows up to
+  // ~260 KB cannot overflow before the per-row flush below.
+  __m128i sum = zero;
+  __m128i peak = zero;
+  for (; i + 16 <= bytes; i += 16) {
+    const __m128i va =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+    const __m128i vb =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+    const __m128i d =
+        _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+    peak = _mm_max_epu8(peak, d);
+    if (absdiff != nullptr) {
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(absdiff + i), d);
+    }
+    const __m128i lo = _mm_unpacklo_epi8(d, zero);
+    const __m128i hi = _mm_unpackhi_epi8(d, zero);
+    sum = _mm_add_epi32(sum, _mm_madd_epi16(lo, lo));
+    sum = _mm_add_epi32(sum, _mm_madd_epi16(hi, hi));
+  }
+  alignas(16) std::array<uint32_t, 4> lanes{};
+  _mm_store_si128(reinterpret_cast<__m128i*>(lanes.data()), sum);
+  for (const uint32_t lane : lanes) {
+    totals.sse += lane;
+  }
+  alignas(16) std::array<uint8_t, 16> peaks{};
+  _mm_store_si128(reinterpret_cast<__m128i*>(peaks.data()), peak);
+  totals.peak = std::max(totals.peak,
+                         *std::max_element(peaks.begin(), peaks.end()));
+#endif
+  for (; i < bytes; ++i) {
+    const auto d = static_cast<uint8_t>(a[i] > b[i] ? a[i] - b[i]
+                                                    : b[i] - a[i]);
+    totals.sse += static_cast<uint32_t>(d) * d;
+    totals.peak = std::max(totals.peak, d);
+    if (absdiff != nullptr) {
+      absdiff[i] = d;
+    }
+  }
+}
+
+// One frame RGB, the other BGR; rare enough (two passthrough cards with
+// different byte orders) to stay scalar.
+void diff_row_swapped(const uint8_t* a, const uint8_t* b, uint32_t pixels,
+                      uint8_t* absdiff, RowTotals& totals) {
+  for (uint32_t x = 0; x < pixels; ++x) {
+    for (uint32_t c = 0; c < 3; ++c) {
+      const uint8_t va = a[x * 3 + c];
+      const uint8_t vb = b[x * 3 + 2 - c];
+      const auto d = static_cast<uint8_t>(va > vb ? va - vb : vb - va);
+      totals.sse += static_cast<uint32_t>(d) * d;
+      totals.peak = std::max(totals.peak, d);
+      if (absdiff != nullptr) {
+        absdiff[x * 3 + c] = d;
+      }
+    }
+  }
+}
+
+void diff_frame_row(const Frame& a, const Frame& b, uint32_t y,
+                    uint8_t* absdiff, RowTotals& totals) {
+  const uint8_t* row_a = a.rgb.data() + static_cast<size_t>(y) * a.stride;
+  const uint8_t* row_b = b.rgb.data() + static_cast<size_t>(y) * b.stride;
+  if (a.layout == b.layout) {
+    diff_row(row_a, row_b, static_cast<size_t>(a.width) * 3, absdiff, totals);
+  } else {
+    diff_row_swapped(row_a, row_b, a.width, absdiff, totals);
+  }
+}
+
+// Black through blue, green and yellow to red. Differences are amplified
+// four times first: capture noise of a few codes should already show.
+std::array<std::array<uint8_t, 3>, 256> make_heat_palette() {
+  std::array<std::array<uint8_t, 3>, 256> palette{};
+  for (uint32_t v = 0; v < 256; ++v) {
+    const uint32_t t = std::min<uint32_t>(v * 4, 255);
+    const auto ramp = [&](uint32_t from) {
+      return static_cast<uint8_t>(std::min<uint32_t>((t - from) * 4, 255));
+    };
+    if (t < 64) {
+      palette[v] = {0, 0, ramp(0)};
+    } else if (t < 128) {
+      palette[v] = {0, ramp(64), static_cast<uint8_t>(255 - ramp(64))};
+    } else if (t < 192) {
+      palette[v] = {ramp(128), 255, 0};
+    } else {
+      palette[v] = {255, static_cast<uint8_t>(255 - ramp(192)), 0};
+    }
+  }
+  return palette;
+}
+
+const std::array<std::array<uint8_t, 3>, 256>& heat_palette() {
+  static const auto palette = make_heat_palette();
+  return palette;
+}
+
+void paint_heat_row(const uint8_t* absdiff, uint8_t* dst, uint32_t width) {
+  const auto& palette = heat_palette();
+  for (uint32_t x = 0; x < width; ++x) {
+    const uint8_t* d = absdiff + static_cast<size_t>(x) * 6;
+    const uint8_t v = std::max({d[0], d[1], d[2]});
+    const auto& colour = palette[v];
+    dst[x * 3 + 0] = colour[0];
+    dst[x * 3 + 1] = colour[1];
+    dst[x * 3 + 2] = colour[2];
+  }
+}
+
+}  // namespace
+
+bool compare_frames(const Frame& a, const Frame& b, FrameDifference& out,
+                    FrameSnapshot* heat_map) {
+  if (a.width != b.width || a.height != b.height || a.width == 0 ||
+      a.height == 0) {
+    return false;
+  }
+
+  std::vector<uint8_t> absdiff;
+  uint32_t heat_width = 0;
+  uint32_t heat_height = 0;
+  if (heat_map != nullptr) {
+    heat_width = std::max<uint32_t>(1, a.width / 2);
+    heat_height = std::max<uint32_t>(1, a.height / 2);
+    heat_map->width = heat_width;
+    heat_map->height = heat_height;
+    heat_map->rgb.resize(static_cast<size_t>(heat_width) * heat_height * 3);
+    absdiff.resize(static_cast<size_t>(a.width) * 3);
+  }
+
+  RowTotals totals{};
+  for (uint32_t y = 0; y < a.height; ++y) {
+    const bool heat_row =
+        heat_map != nullptr && (y % 2) == 0 && y / 2 < heat_height;
+    diff_frame_row(a, b, y, heat_row ? absdiff.data() : nullptr, totals);
+    if (heat_row) {
+      paint_heat_row(absdiff.data(),
+                     heat_map->rgb.data() +
+                         static_cast<size_t>(y / 2) * heat_width * 3,
+                     heat_width);
+    }
+  }
+
+  const double samples = static_cast<double>(a.width) * a.height * 3.0;
+  out.mse = static_cast<double>(totals.sse) / samples;
+  out.psnr_db = out.mse == 0.0
+                    ? std::numeric_limits<double>::infinity()
+                    : 10.0 * std::log10(255.0 * 255.0 / out.mse);
+  out.max_abs_diff = totals.peak;
+  return true;
+}
+
+uint64_t sampled_difference(const Frame& a, const Frame& b,
+                            uint32_t row_step) {
+  RowTotals totals{};
+  const uint32_t height = std::min(a.height, b.height);
+  for (uint32_t y = 0; y < height; y += std::max<uint32_t>(row_step, 1)) {
+    diff_frame_row(a, b, y, nullptr, totals);
+  }
+  return totals.sse;
+}
+
+}  // namespace syzygy::capture
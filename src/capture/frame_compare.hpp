@@ -0,0 +1,34 @@
+#pragma once
+
+// Copyright (c) 2025 Zoe Gates <zoe@zeocities.dev>
+//
+// Difference metrics between two converted frames of the same size: mean
+// squared error, PSNR, the largest per-channel difference, and optionally a
+// half-resolution heat map of where they differ. The row kernels use SSE2
+// where the target has it.
+
+#include "capture/frame_pool.hpp"
+#include "capture/frame_snapshot.hpp"
+
+#include <cstdint>
+
+namespace syzygy::capture {
+
+struct FrameDifference {
+  double mse{0.0};
+  // Infinite for identical frames.
+  double psnr_db{0.0};
+  uint8_t max_abs_diff{0};
+};
+
+// False when the frames differ in size. `heat_map`, when given, receives a
+// (width / 2) x (height / 2) picture coloured by each pixel's largest
+// channel difference.
+bool compare_frames(const Frame& a, const Frame& b, FrameDifference& out,
+                    FrameSnapshot* heat_map = nullptr);
+
+// Cheap similarity score on every `row_step`-th row only, for picking the
+// best of several candidates; lower is closer. Frames must match in size.
+uint64_t sampled_difference(const Frame& a, const Frame& b, uint32_t row_step);
+
+}  // namespace syzygy::capture
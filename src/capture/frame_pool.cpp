@@ -0,0 +1,162 @@
+#include "capture/frame_pool.hpp"
+
+#include "syzygy/log.hpp"
+
+#include <algorithm>
+#include <bit>
+
+namespace syzygy::capture {
+
+namespace {
+
+constexpr size_t kPageSize = 4096;
+
+size_t round_up(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+}  // namespace
+
+FrameRef::FrameRef(std::shared_ptr<FramePool> pool, uint32_t index) noexcept
+    : pool_(std::move(pool)), index_(index) {}
+
+FrameRef::~FrameRef() {
+  reset();
+}
+
+FrameRef::FrameRef(const FrameRef& other) noexcept
+    : pool_(other.pool_), index_(other.index_) {
+  if (pool_) {
+    pool_->slots_[index_].refs.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+FrameRef& FrameRef::operator=(const FrameRef& other) noexcept {
+  if (this != &other) {
+    if (other.pool_) {
+      other.pool_->slots_[other.index_].refs.fetch_add(
+          1, std::memory_order_relaxed);
+    }
+    reset();
+    pool_ = other.pool_;
+    index_ = other.index_;
+  }
+  return *this;
+}
+
+FrameRef::FrameRef(FrameRef&& other) noexcept
+    : pool_(std::move(other.pool_)), index_(other.index_) {}
+
+FrameRef& FrameRef::operator=(FrameRef&& other) noexcept {
+  if (this != &other) {
+    reset();
+    pool_ = std::move(other.pool_);
+    index_ = other.index_;
+  }
+  return *this;
+}
+
+Frame& FrameRef::operator*() const noexcept {
+  return pool_->slots_[index_].frame;
+}
+
+void FrameRef::reset() noexcept {
+  if (!pool_) {
+    return;
+  }
+  auto pool = std::move(pool_);
+  pool->release(index_);
+}
+
+FramePool::FramePool(uint32_t width, uint32_t height, uint32_t capacity,
+                     bool lock_memory)
+    : width_(width),
+      height_(height),
+      capacity_(std::clamp<uint32_t>(capacity, 1, kMaxCapacity)) {
+  stride_ = width_ * 3;
+  frame_bytes_ = static_cast<size_t>(stride_) * height_;
+  const size_t slot_bytes = round_up(frame_bytes_, kPageSize);
+
+  arena_ = std::make_unique<util::HugepageArena>(slot_bytes * capacity_,
+                                                 lock_memory);
+  if (!arena_->valid()) {
+    capacity_ = 0;
+    return;
+  }
+
+  slots_ = std::make_unique<Slot[]>(capacity_);
+  for (uint32_t i = 0; i < capacity_; ++i) {
+    slots_[i].storage =
+        std::span<uint8_t>(arena_->allocate(slot_bytes), frame_bytes_);
+  }
+  free_mask_.store(capacity_ == 64 ? ~uint64_t{0}
+                                   : ((uint64_t{1} << capacity_) - 1),
+                   std::memory_order_release);
+
+  syzygy::log::info("FramePool", width_, "x", height_, "frames", capacity_,
+                    "MiB", arena_->capacity() / (1024 * 1024),
+                    arena_->hugetlb() ? "hugetlb" : "thp",
+                    arena_->locked() ? "locked" : "unlocked");
+}
+
+FramePool::~FramePool() = default;
+
+FrameRef FramePool::acquire() {
+  uint64_t mask = free_mask_.load(std::memory_order_acquire);
+  while (mask != 0) {
+    const uint32_t index = static_cast<uint32_t>(std::countr_zero(mask));
+    const uint64_t bit = uint64_t{1} << index;
+    if (free_mask_.compare_exchange_weak(mask, mask & ~bit,
+                                         std::memory_order_acq_rel)) {
+      auto& slot = slots_[index];
+      slot.frame.width = width_;
+      slot.frame.height = height_;
+      slot.frame.stride = stride_;
+      slot.frame.rgb = slot.storage;
+      slot.frame.layout = PixelLayout::Rgb24;
+      slot.frame.convert_ms = 0.0;
+      slot.refs.store(1, std::memory_order_relaxed);
+      acquisitions_.fetch_add(1, std::memory_order_relaxed);
+      const uint32_t in_use =
+          in_use_.fetch_add(1, std::memory_order_relaxed) + 1;
+      uint32_t peak = high_water_.load(std::memory_order_relaxed);
+      while (in_use > peak &&
+             !high_water_.compare_exchange_weak(peak, in_use,
+                                                std::memory_order_relaxed)) {
+      }
+      return FrameRef(shared_from_this(), index);
+    }
+  }
+  misses_.fetch_add(1, std::memory_order_relaxed);
+  return {};
+}
+
+FramePool::Stats FramePool::stats() const {
+  Stats stats{};
+  stats.capacity = capacity_;
+  stats.in_use = in_use_.load(std::memory_order_relaxed);
+  stats.high_water = high_water_.load(std::memory_order_relaxed);
+  stats.acquisitions = acquisitions_.load(std::memory_order_relaxed);
+  stats.misses = misses_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void FramePool::release(uint32_t index) noexcept {
+  auto& slot = slots_[index];
+  if (slot.refs.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+    return;
+  }
+  slot.frame.source.reset();
+  in_use_.fetch_sub(1, std::memory_order_relaxed);
+  free_mask_.fetch_or(uint64_t{1} << index, std::memory_order_release);
+}
+
+void complete_frame(FrameLease& source, FrameRef& target,
+                    const FrameCompletion& done, double process_ms) {
+  source.reset();
+  if (done) {
+    done(std::move(target), process_ms);
+  }
+}
+
+}  // namespace syzygy::capture
@@ -0,0 +1,135 @@
+#pragma once
+
+// Copyright (c) 2025 Zoe Gates <zoe@zeocities.dev>
+//
+// Fixed-capacity pool of converted frames. Storage comes from a prefaulted
+// hugepage arena allocated once per negotiated mode; frames are recycled
+// afterwards.
+
+#include "capture/lease_pool.hpp"
+#include "capture/pixel_convert.hpp"
+#include "util/hugepage_arena.hpp"
+
+#include "syzygy/clock.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
+
+namespace syzygy::capture {
+
+class FramePool;
+
+struct Frame {
+  uint32_t width{0};
+  uint32_t height{0};
+  uint32_t stride{0};
+  std::span<uint8_t> rgb;  // Owned by the FramePool unless `source` is set
+  PixelLayout layout{PixelLayout::Rgb24};
+  // Set when rgb borrows a packed-RGB capture buffer instead of pool storage.
+  FrameLease source;
+  std::chrono::steady_clock::time_point capture_time;
+  std::chrono::steady_clock::time_point dequeue_time;
+  // Metadata of the V4L2 buffer the frame came from.
+  uint32_t sequence{0};
+  uint32_t flags{0};  // V4L2_BUF_FLAG_*
+  uint32_t field{0};  // enum v4l2_field
+  // Whether capture_time is the driver's timestamp or only the dequeue time.
+  bool driver_timestamp{false};
+  // Conversion or decode time; zero for passthrough frames.
+  double convert_ms{0.0};
+};
+
+class FrameRef {
+ public:
+  FrameRef() = default;
+  ~FrameRef();
+
+  FrameRef(const FrameRef& other) noexcept;
+  FrameRef& operator=(const FrameRef& other) noexcept;
+  FrameRef(FrameRef&& other) noexcept;
+  FrameRef& operator=(FrameRef&& other) noexcept;
+
+  explicit operator bool() const noexcept { return pool_ != nullptr; }
+
+  Frame& operator*() const noexcept;
+  Frame* operator->() const noexcept { return &**this; }
+
+  void reset() noexcept;
+
+ private:
+  friend class FramePool;
+  FrameRef(std::shared_ptr<FramePool> pool, uint32_t index) noexcept;
+
+  std::shared_ptr<FramePool> pool_;
+  uint32_t index_{0};
+};
+
+class FramePool : public std::enable_shared_from_this<FramePool> {
+ public:
+  static constexpr uint32_t kMaxCapacity = 64;
+
+  struct Stats {
+    uint32_t capacity{0};
+    uint32_t in_use{0};
+    uint32_t high_water{0};
+    uint64_t acquisitions{0};
+    uint64_t misses{0};
+  };
+
+  FramePool(uint32_t width, uint32_t height, uint32_t capacity,
+            bool lock_memory = false);
+  ~FramePool();
+
+  FramePool(const FramePool&) = delete;
+  FramePool& operator=(const FramePool&) = delete;
+
+  // Returns an empty ref when every frame is still referenced.
+  FrameRef acquire();
+
+  bool matches(uint32_t width, uint32_t height) const noexcept {
+    return width == width_ && height == height_;
+  }
+  bool valid() const noexcept { return capacity_ != 0; }
+  uint32_t capacity() const noexcept { return capacity_; }
+  Stats stats() const;
+
+ private:
+  friend class FrameRef;
+
+  struct Slot {
+    Frame frame;
+    std::span<uint8_t> storage;
+    std::atomic<uint32_t> refs{0};
+  };
+
+  void release(uint32_t index) noexcept;
+
+  uint32_t width_{0};
+  uint32_t height_{0};
+  uint32_t capacity_{0};
+  uint32_t stride_{0};
+  size_t frame_bytes_{0};
+  std::unique_ptr<util::HugepageArena> arena_;
+  std::unique_ptr<Slot[]> slots_;
+
+  std::atomic<uint64_t> free_mask_{0};
+  std::atomic<uint32_t> in_use_{0};
+  std::atomic<uint32_t> high_water_{0};
+  std::atomic<uint64_t> acquisitions_{0};
+  std::atomic<uint64_t> misses_{0};
+};
+
+// How the convert stage, the conversion pool and the MJPEG decoder hand
+// over a finished frame, with the time it took.
+using FrameCompletion = std::function<void(FrameRef frame, double process_ms)>;
+
+// Gives `source` back to the driver, then `target` to `done` when set; the
+// buffer is requeued without waiting on whatever the frame is published to.
+void complete_frame(FrameLease& source, FrameRef& target,
+                    const FrameCompletion& done, double process_ms);
+
+}  // namespace syzygy::capture
@@ -0,0 +1,122 @@
+#include "capture/frame_snapshot.hpp"
+
+#include "syzygy/log.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <string_view>
+
+namespace syzygy::capture {
+
+namespace {
+
+constexpr std::string_view kTagPrefix = "# syzygy ";
+// Refuses absurd headers before allocating for them.
+constexpr uint32_t kMaxSnapshotDimension = 8192;
+
+}  // namespace
+
+FrameSnapshot make_snapshot(const Frame& frame, uint32_t max_width) {
+  FrameSnapshot snapshot{};
+  if (frame.width == 0 || frame.height == 0 || frame.rgb.empty()) {
+    return snapshot;
+  }
+  snapshot.width = std::min(frame.width, std::max<uint32_t>(max_width, 1));
+  snapshot.height = std::max<uint32_t>(
+      1, static_cast<uint32_t>(static_cast<uint64_t>(frame.height) *
+                               snapshot.width / frame.width));
+  snapshot.rgb.resize(static_cast<size_t>(snapshot.width) * snapshot.height *
+                      3);
+
+  const bool bgr = frame.layout == PixelLayout::Bgr24;
+  uint8_t* out = snapshot.rgb.data();
+  for (uint32_t y = 0; y < snapshot.height; ++y) {
+    const uint32_t src_y =
+        static_cast<uint32_t>(static_cast<uint64_t>(y) * frame.height /
+                              snapshot.height);
+    const uint8_t* row = frame.rgb.data() +
+                         static_cast<size_t>(src_y) * frame.stride;
+    for (uint32_t x = 0; x < snapshot.width; ++x) {
+      const uint32_t src_x =
+          static_cast<uint32_t>(static_cast<uint64_t>(x) * frame.width /
+                                snapshot.width);
+      const uint8_t* pixel = row + static_cast<size_t>(src_x) * 3;
+      out[0] = bgr ? pixel[2] : pixel[0];
+      out[1] = pixel[1];
+      out[2] = bgr ? pixel[0] : pixel[2];
+      out += 3;
+    }
+  }
+  return snapshot;
+}
+
+bool save_snapshot(const FrameSnapshot& snapshot, const std::string& tag,
+                   const std::filesystem::path& path) {
+  if (snapshot.rgb.empty()) {
+    return false;
+  }
+  std::error_code ec;
+  std::filesystem::create_directories(path.parent_path(), ec);
+  // Written aside and renamed so a crash never leaves half a picture.
+  const auto temp = std::filesystem::path(path).concat(".tmp");
+  {
+    std::ofstream output(temp, std::ios::binary | std::ios::trunc);
+    if (!output.is_open()) {
+      syzygy::log::warn("save_snapshot: unable to write", temp.string());
+      return false;
+    }
+    output << "P6\n" << kTagPrefix << tag << "\n"
+           << snapshot.width << " " << snapshot.height << "\n255\n";
+    output.write(reinterpret_cast<const char*>(snapshot.rgb.data()),
+                 static_cast<std::streamsize>(snapshot.rgb.size()));
+    if (!output) {
+      syzygy::log::warn("save_snapshot: write failed", temp.string());
+      return false;
+    }
+  }
+  std::filesystem::rename(temp, path, ec);
+  if (ec) {
+    syzygy::log::warn("save_snapshot: unable to replace", path.string(),
+                      ec.message());
+    return false;
+  }
+  return true;
+}
+
+std::optional<FrameSnapshot> load_snapshot(const std::filesystem::path& path,
+                                           const std::string& tag) {
+  std::ifstream input(path, std::ios::binary);
+  if (!input.is_open()) {
+    return std::nullopt;
+  }
+
+  std::string magic;
+  std::string comment;
+  if (!std::getline(input, magic) || magic != "P6" ||
+      !std::getline(input, comment) ||
+      comment != std::string(kTagPrefix) + tag) {
+    return std::nullopt;
+  }
+
+  FrameSnapshot snapshot{};
+  uint32_t max_value = 0;
+  input >> snapshot.width >> snapshot.height >> max_value;
+  // Exactly one whitespace byte separates the header from the pixels.
+  input.get();
+  if (!input || max_value != 255 || snapshot.width == 0 ||
+      snapshot.height == 0 || snapshot.width > kMaxSnapshotDimension ||
+      snapshot.height > kMaxSnapshotDimension) {
+    return std::nullopt;
+  }
+
+  snapshot.rgb.resize(static_cast<size_t>(snapshot.width) * snapshot.height *
+                      3);
+  input.read(reinterpret_cast<char*>(snapshot.rgb.data()),
+             static_cast<std::streamsize>(snapshot.rgb.size()));
+  if (!input) {
+    return std::nullopt;
+  }
+  return snapshot;
+}
+
+}  // namespace syzygy::capture
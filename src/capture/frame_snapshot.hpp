@@ -0,0 +1,35 @@
+#pragma once
+
+// Copyright (c) 2025 Zoe Gates <zoe@zeocities.dev>
+//
+// Small owned copies of converted frames, and a binary PPM round trip for
+// them. Used to put the last picture back on screen at startup before the
+// device delivers its first frame.
+
+#include "capture/frame_pool.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace syzygy::capture {
+
+struct FrameSnapshot {
+  uint32_t width{0};
+  uint32_t height{0};
+  // Tightly packed RGB24, whatever the source frame's layout was.
+  std::vector<uint8_t> rgb;
+};
+
+// Point-sampled copy no wider than `max_width`, keeping the aspect ratio.
+FrameSnapshot make_snapshot(const Frame& frame, uint32_t max_width);
+
+// `tag` (e.g. the device node) is stored in a comment and must match on load.
+bool save_snapshot(const FrameSnapshot& snapshot, const std::string& tag,
+                   const std::filesystem::path& path);
+std::optional<FrameSnapshot> load_snapshot(const std::filesystem::path& path,
+                                           const std::string& tag);
+
+}  // namespace syzygy::capture
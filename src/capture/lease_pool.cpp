@@ -0,0 +1,406 @@
+#include "capture/lease_pool.hpp"
+
+#include "capture/v4l2_util.hpp"
+
+#include "syzygy/log.hpp"
+
+#include <fcntl.h>
+#include <linux/videodev2.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace syzygy::capture {
+
+namespace {
+
+int64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             syzygy::clock::now().time_since_epoch())
+      .count();
+}
+
+template <typename T>
+void store_max(std::atomic<T>& target, T value) {
+  T current = target.load(std::memory_order_relaxed);
+  while (value > current &&
+         !target.compare_exchange_weak(current, value,
+                                       std::memory_order_relaxed)) {
+  }
+}
+
+}  // namespace
+
+FrameLease::FrameLease(std::shared_ptr<LeasePool> pool, uint32_t index) noexcept
+    : pool_(std::move(pool)), index_(index) {}
+
+FrameLease::~FrameLease() {
+  reset();
+}
+
+FrameLease::FrameLease(const FrameLease& other) noexcept
+    : pool_(other.pool_), index_(other.index_) {
+  if (pool_) {
+    pool_->acquire(index_);
+  }
+}
+
+FrameLease& FrameLease::operator=(const FrameLease& other) noexcept {
+  if (this != &other) {
+    if (other.pool_) {
+      other.pool_->acquire(other.index_);
+    }
+    reset();
+    pool_ = other.pool_;
+    index_ = other.index_;
+  }
+  return *this;
+}
+
+FrameLease::FrameLease(FrameLease&& other) noexcept
+    : pool_(std::move(other.pool_)), index_(other.index_) {}
+
+FrameLease& FrameLease::operator=(FrameLease&& other) noexcept {
+  if (this != &other) {
+    reset();
+    pool_ = std::move(other.pool_);
+    index_ = other.index_;
+  }
+  return *this;
+}
+
+const uint8_t* FrameLease::plane_data(uint32_t plane) const noexcept {
+  const auto& slot = pool_->slots_[index_];
+  return static_cast<const uint8_t*>(slot.planes[plane].start) +
+         slot.info.plane_offset[plane];
+}
+
+size_t FrameLease::plane_size(uint32_t plane) const noexcept {
+  return pool_->slots_[index_].info.plane_bytes_used[plane];
+}
+
+int FrameLease::dmabuf_fd(uint32_t plane) const noexcept {
+  return pool_->slots_[index_].planes[plane].dmabuf_fd;
+}
+
+const BufferInfo& FrameLease::info() const noexcept {
+  return pool_->slots_[index_].info;
+}
+
+void FrameLease::reset() noexcept {
+  if (!pool_) {
+    return;
+  }
+  auto pool = std::move(pool_);
+  pool->release(index_);
+}
+
+LeasePool::LeasePool(int fd, uint32_t buffer_type)
+    : fd_(fd), buffer_type_(buffer_type), memory_(V4L2_MEMORY_MMAP) {}
+
+LeasePool::~LeasePool() {
+  for (uint32_t i = 0; i < count_; ++i) {
+    for (auto& plane : slots_[i].planes) {
+      if (plane.dmabuf_fd >= 0) {
+        close(plane.dmabuf_fd);
+      }
+      if (memory_ == V4L2_MEMORY_MMAP && plane.start && plane.length) {
+        munmap(plane.start, plane.length);
+      }
+    }
+  }
+}
+
+bool LeasePool::multi_planar() const noexcept {
+  return buffer_type_ == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+}
+
+bool LeasePool::map_buffers(uint32_t count) {
+  memory_ = V4L2_MEMORY_MMAP;
+  v4l2_requestbuffers req{};
+  req.count = count;
+  req.type = buffer_type_;
+  req.memory = memory_;
+
+  if (!xioctl(fd_, VIDIOC_REQBUFS, &req)) {
+    syzygy::log::warn("LeasePool: VIDIOC_REQBUFS failed",
+                      std::strerror(errno));
+    return false;
+  }
+
+  slots_ = std::make_unique<Slot[]>(req.count);
+  count_ = req.count;
+  for (uint32_t i = 0; i < count_; ++i) {
+    std::array<v4l2_plane, kMaxPlanes> planes{};
+    v4l2_buffer buf{};
+    buf.type = buffer_type_;
+    buf.memory = V4L2_MEMORY_MMAP;
+    buf.index = i;
+    if (multi_planar()) {
+      buf.m.planes = planes.data();
+      buf.length = kMaxPlanes;
+    }
+
+    if (!xioctl(fd_, VIDIOC_QUERYBUF, &buf)) {
+      syzygy::log::warn("LeasePool: VIDIOC_QUERYBUF failed",
+                        std::strerror(errno));
+      return false;
+    }
+
+    auto& slot = slots_[i];
+    slot.plane_count = multi_planar() ? buf.length : 1;
+    slot.info.index = i;
+    for (uint32_t p = 0; p < slot.plane_count; ++p) {
+      const size_t length = multi_planar() ? planes[p].length : buf.length;
+      const off_t offset =
+          multi_planar() ? planes[p].m.mem_offset : buf.m.offset;
+      void* start = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED,
+                         fd_, offset);
+      if (start == MAP_FAILED) {
+        syzygy::log::warn("LeasePool: mmap failed", std::strerror(errno));
+        return false;
+      }
+      slot.planes[p].start = start;
+      slot.planes[p].length = length;
+      export_plane(i, p);
+    }
+  }
+  return true;
+}
+
+bool LeasePool::attach_user_buffers(
+    uint32_t count, std::shared_ptr<util::HugepageArena> arena,
+    size_t buffer_bytes) {
+  v4l2_requestbuffers req{};
+  req.count = count;
+  req.type = buffer_type_;
+  req.memory = V4L2_MEMORY_USERPTR;
+
+  if (!xioctl(fd_, VIDIOC_REQBUFS, &req)) {
+    return false;
+  }
+
+  auto slots = std::make_unique<Slot[]>(req.count);
+  for (uint32_t i = 0; i < req.count; ++i) {
+    uint8_t* start = arena->allocate(buffer_bytes);
+    if (!start) {
+      syzygy::log::warn("LeasePool: arena too small for", req.count,
+                        "buffers");
+      req.count = 0;
+      xioctl(fd_, VIDIOC_REQBUFS, &req);
+      return false;
+    }
+    slots[i].planes[0].start = start;
+    slots[i].planes[0].length = buffer_bytes;
+    slots[i].info.index = i;
+  }
+
+  memory_ = V4L2_MEMORY_USERPTR;
+  count_ = req.count;
+  slots_ = std::move(slots);
+  arena_ = std::move(arena);
+  return true;
+}
+
+bool LeasePool::queue_all() {
+  std::lock_guard<std::mutex> lock(queue_mutex_);
+  for (uint32_t i = 0; i < count_; ++i) {
+    if (slots_[i].refs.load(std::memory_order_acquire) != 0) {
+      continue;
+    }
+    if (!queue_or_park_locked(i)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+uint32_t LeasePool::requeue_lost() {
+  std::lock_guard<std::mutex> lock(queue_mutex_);
+  if (fd_ < 0) {
+    return 0;
+  }
+  uint32_t requeued = 0;
+  for (uint32_t i = 0; i < count_; ++i) {
+    if (slots_[i].refs.load(std::memory_order_acquire) != 0 ||
+        slots_[i].queued.load(std::memory_order_relaxed) ||
+        std::find(parked_.begin(), parked_.end(), i) != parked_.end()) {
+      continue;
+    }
+    if (queue_or_park_locked(i) &&
+        slots_[i].queued.load(std::memory_order_relaxed)) {
+      requeued++;
+    }
+  }
+  return requeued;
+}
+
+FrameLease LeasePool::lease(const BufferInfo& info) {
+  auto& slot = slots_[info.index];
+  slot.queued.store(false, std::memory_order_relaxed);
+  slot.info = info;
+  slot.leased_at_ns.store(now_ns(), std::memory_order_relaxed);
+  slot.refs.store(1, std::memory_order_release);
+
+  queued_.fetch_sub(1, std::memory_order_acq_rel);
+  {
+    // Keeps the driver queue at the limit while spare buffers are parked;
+    // the spares exist to cover leases, not to sit idle.
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    unpark_locked();
+    if (queued_.load(std::memory_order_relaxed) == 0) {
+      starvations_.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+  const uint32_t outstanding =
+      outstanding_.fetch_add(1, std::memory_order_relaxed) + 1;
+  store_max(peak_outstanding_, outstanding);
+
+  return FrameLease(shared_from_this(), info.index);
+}
+
+void LeasePool::retire() {
+  std::lock_guard<std::mutex> lock(queue_mutex_);
+  fd_ = -1;
+}
+
+void LeasePool::set_queue_limit(uint32_t limit) {
+  std::lock_guard<std::mutex> lock(queue_mutex_);
+  queue_limit_.store(limit, std::memory_order_relaxed);
+  unpark_locked();
+}
+
+void LeasePool::unpark_locked() {
+  if (fd_ < 0) {
+    return;
+  }
+  const uint32_t limit = queue_limit_.load(std::memory_order_relaxed);
+  while (!parked_.empty() &&
+         queued_.load(std::memory_order_relaxed) < limit) {
+    const uint32_t index = parked_.back();
+    parked_.pop_back();
+    if (!queue_locked(index)) {
+      parked_.push_back(index);
+      return;
+    }
+  }
+}
+
+void LeasePool::set_hold_budget(
+    syzygy::clock::Clock::duration budget) noexcept {
+  hold_budget_ns_.store(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(budget).count(),
+      std::memory_order_relaxed);
+}
+
+LeasePool::Stats LeasePool::stats() const {
+  Stats stats{};
+  stats.buffer_count = count_;
+  stats.outstanding = outstanding_.load(std::memory_order_relaxed);
+  stats.peak_outstanding = peak_outstanding_.load(std::memory_order_relaxed);
+  stats.starvations = starvations_.load(std::memory_order_relaxed);
+  stats.long_holds = long_holds_.load(std::memory_order_relaxed);
+  stats.queue_limit = queue_limit_.load(std::memory_order_relaxed);
+  stats.longest_hold_ms =
+      static_cast<double>(longest_hold_ns_.load(std::memory_order_relaxed)) /
+      1e6;
+
+  {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    stats.parked = static_cast<uint32_t>(parked_.size());
+  }
+
+  const int64_t now = now_ns();
+  const int64_t budget = hold_budget_ns_.load(std::memory_order_relaxed);
+  for (uint32_t i = 0; i < count_; ++i) {
+    if (slots_[i].refs.load(std::memory_order_acquire) == 0) {
+      continue;
+    }
+    const int64_t leased_at =
+        slots_[i].leased_at_ns.load(std::memory_order_relaxed);
+    if (now - leased_at > budget) {
+      stats.overdue++;
+    }
+  }
+  return stats;
+}
+
+void LeasePool::acquire(uint32_t index) noexcept {
+  slots_[index].refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+void LeasePool::release(uint32_t index) noexcept {
+  auto& slot = slots_[index];
+  if (slot.refs.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+    return;
+  }
+
+  const int64_t held =
+      now_ns() - slot.leased_at_ns.load(std::memory_order_relaxed);
+  if (held > hold_budget_ns_.load(std::memory_order_relaxed)) {
+    long_holds_.fetch_add(1, std::memory_order_relaxed);
+  }
+  store_max(longest_hold_ns_, held);
+  outstanding_.fetch_sub(1, std::memory_order_relaxed);
+
+  std::lock_guard<std::mutex> lock(queue_mutex_);
+  if (fd_ >= 0) {
+    queue_or_park_locked(index);
+  }
+}
+
+bool LeasePool::queue_or_park_locked(uint32_t index) {
+  if (queued_.load(std::memory_order_relaxed) >=
+      queue_limit_.load(std::memory_order_relaxed)) {
+    parked_.push_back(index);
+    return true;
+  }
+  return queue_locked(index);
+}
+
+bool LeasePool::queue_locked(uint32_t index) {
+  const auto& slot = slots_[index];
+  std::array<v4l2_plane, kMaxPlanes> planes{};
+  v4l2_buffer buf{};
+  buf.type = buffer_type_;
+  buf.memory = memory_;
+  buf.index = index;
+  if (multi_planar()) {
+    buf.m.planes = planes.data();
+    buf.length = slot.plane_count;
+    if (memory_ == V4L2_MEMORY_USERPTR) {
+      for (uint32_t p = 0; p < slot.plane_count; ++p) {
+        planes[p].m.userptr =
+            reinterpret_cast<unsigned long>(slot.planes[p].start);
+        planes[p].length = static_cast<uint32_t>(slot.planes[p].length);
+      }
+    }
+  } else if (memory_ == V4L2_MEMORY_USERPTR) {
+    buf.m.userptr = reinterpret_cast<unsigned long>(slot.planes[0].start);
+    buf.length = static_cast<uint32_t>(slot.planes[0].length);
+  }
+  if (!xioctl(fd_, VIDIOC_QBUF, &buf)) {
+    syzygy::log::warn("LeasePool: VIDIOC_QBUF failed", std::strerror(errno));
+    return false;
+  }
+  slots_[index].queued.store(true, std::memory_order_relaxed);
+  queued_.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+void LeasePool::export_plane(uint32_t index, uint32_t plane) {
+  v4l2_exportbuffer expbuf{};
+  expbuf.type = buffer_type_;
+  expbuf.index = index;
+  expbuf.plane = plane;
+  expbuf.flags = O_CLOEXEC | O_RDONLY;
+  // Older drivers lack VIDIOC_EXPBUF; the mapping alone is still usable.
+  if (xioctl(fd_, VIDIOC_EXPBUF, &expbuf)) {
+    slots_[index].planes[plane].dmabuf_fd = expbuf.fd;
+  }
+}
+
+}  // namespace syzygy::capture
@@ -0,0 +1,180 @@
+#pragma once
+
+// Copyright (c) 2025 Zoe Gates <zoe@zeocities.dev>
+//
+// Ref-counted leases over dequeued V4L2 buffers. A buffer goes back to the
+// driver with VIDIOC_QBUF when the last lease referencing it is dropped.
+
+#include "util/hugepage_arena.hpp"
+
+#include "syzygy/clock.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace syzygy::capture {
+
+class LeasePool;
+
+// Enough for every format in the conversion table (three-plane 4:2:0).
+constexpr uint32_t kMaxPlanes = 3;
+
+struct BufferInfo {
+  uint32_t index{0};
+  uint32_t pixel_format{0};
+  uint32_t width{0};
+  uint32_t height{0};
+  uint32_t bytes_per_line{0};
+  // Payload of plane 0, excluding the driver's data offset.
+  uint32_t bytes_used{0};
+  uint32_t plane_count{1};
+  std::array<uint32_t, kMaxPlanes> plane_bytes_used{};
+  std::array<uint32_t, kMaxPlanes> plane_offset{};
+  uint32_t sequence{0};
+  uint32_t flags{0};  // V4L2_BUF_FLAG_*
+  uint32_t field{0};  // enum v4l2_field
+  // Driver timestamp when it is on the monotonic clock, else dequeue time.
+  syzygy::clock::TimePoint capture_time;
+  bool driver_timestamp{false};
+  syzygy::clock::TimePoint dequeue_time;
+};
+
+class FrameLease {
+ public:
+  FrameLease() = default;
+  ~FrameLease();
+
+  FrameLease(const FrameLease& other) noexcept;
+  FrameLease& operator=(const FrameLease& other) noexcept;
+  FrameLease(FrameLease&& other) noexcept;
+  FrameLease& operator=(FrameLease&& other) noexcept;
+
+  explicit operator bool() const noexcept { return pool_ != nullptr; }
+
+  const uint8_t* data() const noexcept { return plane_data(0); }
+  size_t size() const noexcept { return plane_size(0); }
+  const uint8_t* plane_data(uint32_t plane) const noexcept;
+  size_t plane_size(uint32_t plane) const noexcept;
+  // DMABUF exported for the plane, or -1 when the driver cannot export.
+  // Owned by the pool; dup() it to keep it past the lease.
+  int dmabuf_fd(uint32_t plane = 0) const noexcept;
+  const BufferInfo& info() const noexcept;
+
+  void reset() noexcept;
+
+ private:
+  friend class LeasePool;
+  FrameLease(std::shared_ptr<LeasePool> pool, uint32_t index) noexcept;
+
+  std::shared_ptr<LeasePool> pool_;
+  uint32_t index_{0};
+};
+
+class LeasePool : public std::enable_shared_from_this<LeasePool> {
+ public:
+  struct Stats {
+    uint32_t buffer_count{0};
+    uint32_t outstanding{0};
+    uint32_t peak_outstanding{0};
+    uint32_t overdue{0};
+    uint32_t queue_limit{0};
+    uint32_t parked{0};
+    uint64_t starvations{0};
+    uint64_t long_holds{0};
+    double longest_hold_ms{0.0};
+  };
+
+  LeasePool(int fd, uint32_t buffer_type);
+  ~LeasePool();
+
+  LeasePool(const LeasePool&) = delete;
+  LeasePool& operator=(const LeasePool&) = delete;
+
+  // Maps every plane of every buffer and exports each plane as a DMABUF.
+  bool map_buffers(uint32_t count);
+  // V4L2_MEMORY_USERPTR capture into application-owned arena memory. Fails
+  // without side effects when the driver refuses USERPTR. Single memory
+  // plane only.
+  bool attach_user_buffers(uint32_t count,
+                           std::shared_ptr<util::HugepageArena> arena,
+                           size_t buffer_bytes);
+  bool queue_all();
+  // Requeues buffers that are neither leased, queued nor parked, e.g. after
+  // a failed VIDIOC_QBUF. Returns how many went back to the driver.
+  uint32_t requeue_lost();
+
+  // Called by the capture thread right after VIDIOC_DQBUF.
+  FrameLease lease(const BufferInfo& info);
+
+  // Stop requeueing released buffers; the fd is about to be closed.
+  void retire();
+
+  // Caps how many buffers sit in the driver queue. Released buffers beyond
+  // the cap are parked instead of requeued, and raising it queues them
+  // again, so depth changes without touching the stream.
+  void set_queue_limit(uint32_t limit);
+  uint32_t queue_limit() const noexcept {
+    return queue_limit_.load(std::memory_order_relaxed);
+  }
+
+  void set_hold_budget(syzygy::clock::Clock::duration budget) noexcept;
+  uint32_t size() const noexcept { return count_; }
+  uint32_t memory() const noexcept { return memory_; }
+  uint32_t buffer_type() const noexcept { return buffer_type_; }
+  bool multi_planar() const noexcept;
+  uint64_t starvations() const noexcept {
+    return starvations_.load(std::memory_order_relaxed);
+  }
+  Stats stats() const;
+
+ private:
+  friend class FrameLease;
+
+  struct Plane {
+    void* start{nullptr};
+    size_t length{0};
+    int dmabuf_fd{-1};
+  };
+
+  struct Slot {
+    std::array<Plane, kMaxPlanes> planes{};
+    uint32_t plane_count{1};
+    BufferInfo info;
+    std::atomic<uint32_t> refs{0};
+    std::atomic<int64_t> leased_at_ns{0};
+    std::atomic<bool> queued{false};
+  };
+
+  void acquire(uint32_t index) noexcept;
+  void release(uint32_t index) noexcept;
+  bool queue_locked(uint32_t index);
+  bool queue_or_park_locked(uint32_t index);
+  // Queues parked buffers until the driver holds queue_limit_ again.
+  void unpark_locked();
+  void export_plane(uint32_t index, uint32_t plane);
+
+  int fd_{-1};
+  uint32_t buffer_type_{0};
+  uint32_t memory_{0};
+  uint32_t count_{0};
+  std::unique_ptr<Slot[]> slots_;
+  std::shared_ptr<util::HugepageArena> arena_;
+
+  mutable std::mutex queue_mutex_;
+  std::vector<uint32_t> parked_;
+  std::atomic<uint32_t> queue_limit_{UINT32_MAX};
+  std::atomic<uint32_t> queued_{0};
+  std::atomic<uint32_t> outstanding_{0};
+  std::atomic<uint32_t> peak_outstanding_{0};
+  std::atomic<uint64_t> starvations_{0};
+  std::atomic<uint64_t> long_holds_{0};
+  std::atomic<int64_t> longest_hold_ns_{0};
+  std::atomic<int64_t> hold_budget_ns_{33'000'000};
+};
+
+}  // namespace syzygy::capture
@@ -0,0 +1,518 @@
+#include "capture/mjpeg_decoder.hpp"
+
+#include "syzygy/clock.hpp"
+#include "syzygy/log.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <csetjmp>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <numeric>
+#include <vector>
+
+#ifdef SYZYGY_HAVE_JPEG
+#include <jpeglib.h>
+#endif
+
+namespace syzygy::capture {
+
+namespace {
+
+// Rows handed to jpeg_read_scanlines() at a time; the largest iMCU height.
+constexpr uint32_t kRowBatch = 16;
+constexpr double kBandSplitMegapixels = 2.0;
+constexpr uint32_t kMaxBands = 4;
+
+std::atomic<double> g_ms_per_megapixel{4.0};
+
+int64_t thread_cpu_ns() {
+  timespec ts{};
+  ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1'000'000'000 + ts.tv_nsec;
+}
+
+// Where a baseline JPEG's restart intervals lie. DC prediction resets at
+// every RSTn marker, so a run of intervals covering whole MCU rows decodes
+// on its own behind a copy of the header with the height patched.
+struct RestartLayout {
+  // Everything up to the end of the SOS segment.
+  size_t header_size{0};
+  // The SOF height field, inside the header.
+  size_t height_offset{0};
+  uint32_t height{0};
+  uint32_t mcu_height{0};
+  uint32_t mcus_per_row{0};
+  uint32_t mcu_rows{0};
+  // MCUs per restart interval, from DRI.
+  uint32_t interval{0};
+  // Entropy-coded bytes of each interval, without the markers.
+  std::vector<std::pair<size_t, size_t>> segments;
+};
+
+uint32_t read_u16(const uint8_t* bytes) {
+  return static_cast<uint32_t>(bytes[0]) << 8 | bytes[1];
+}
+
+// False for anything not split the simple way: no DRI, progressive or
+// arithmetic coding, several scans, or a truncated frame.
+bool find_restart_layout(const uint8_t* data, size_t size,
+                         RestartLayout& layout) {
+  if (size < 4 || data[0] != 0xFF || data[1] != 0xD8) {
+    return false;
+  }
+  uint32_t width = 0;
+  uint32_t components = 0;
+  uint32_t max_h = 1;
+  uint32_t max_v = 1;
+  size_t pos = 2;
+  while (layout.header_size == 0) {
+    if (pos + 4 > size || data[pos] != 0xFF) {
+      return false;
+    }
+    const uint8_t marker = data[pos + 1];
+    if (marker == 0xFF) {
+      pos++;
+      continue;
+    }
+    const size_t length = read_u16(data + pos + 2);
+    if (length < 2 || pos + 2 + length > size) {
+      return false;
+    }
+    const uint8_t* body = data + pos + 4;
+    if (marker == 0xC0 || marker == 0xC1) {
+      if (length < 8) {
+        return false;
+      }
+      layout.height_offset = pos + 5;
+      layout.height = read_u16(body + 1);
+      width = read_u16(body + 3);
+      components = body[5];
+      if (components == 0 || length < 8 + 3 * components) {
+        return false;
+      }
+      for (uint32_t i = 0; i < components; ++i) {
+        max_h = std::max<uint32_t>(max_h, body[7 + 3 * i] >> 4);
+        max_v = std::max<uint32_t>(max_v, body[7 + 3 * i] & 0x0F);
+      }
+    } else if (marker >= 0xC2 && marker <= 0xCF && marker != 0xC4 &&
+               marker != 0xC8 && marker != 0xCC) {
+      return false;
+    } else if (marker == 0xDD) {
+      if (length < 4) {
+        return false;
+      }
+      layout.interval = read_u16(body);
+    } else if (marker == 0xDA) {
+      // One interleaved scan carrying every component.
+      if (components == 0 || length < 3 || body[0] != components) {
+        return false;
+      }
+      layout.header_size = pos + 2 + length;
+    }
+    pos += 2 + length;
+  }
+  if (layout.interval == 0 || layout.height == 0 || width == 0) {
+    return false;
+  }
+  // A single-component scan is not interleaved: its MCU is one block.
+  if (components == 1) {
+    max_h = 1;
+    max_v = 1;
+  }
+  const uint32_t mcu_width = 8 * max_h;
+  layout.mcu_height = 8 * max_v;
+  layout.mcus_per_row = (width + mcu_width - 1) / mcu_width;
+  layout.mcu_rows = (layout.height + layout.mcu_height - 1) / layout.mcu_height;
+
+  layout.segments.clear();
+  size_t begin = layout.header_size;
+  pos = begin;
+  while (true) {
+    const auto* found = static_cast<const uint8_t*>(
+        std::memchr(data + pos, 0xFF, size - pos));
+    if (found == nullptr || found + 1 >= data + size) {
+      return false;
+    }
+    pos = static_cast<size_t>(found - data);
+    const uint8_t marker = data[pos + 1];
+    if (marker == 0x00 || marker == 0xFF) {
+      // Stuffed byte, or fill before a marker.
+      pos += marker == 0x00 ? 2 : 1;
+    } else if (marker >= 0xD0 && marker <= 0xD7) {
+      layout.segments.emplace_back(begin, pos);
+      pos += 2;
+      begin = pos;
+    } else if (marker == 0xD9) {
+      layout.segments.emplace_back(begin, pos);
+      break;
+    } else {
+      return false;
+    }
+  }
+  const uint64_t mcus =
+      static_cast<uint64_t>(layout.mcus_per_row) * layout.mcu_rows;
+  return layout.segments.size() ==
+         (mcus + layout.interval - 1) / layout.interval;
+}
+
+// Header with the band's height, its intervals renumbered from RST0, EOI.
+void build_band(const uint8_t* data, const RestartLayout& layout,
+                uint32_t rows, size_t first_segment, size_t end_segment,
+                std::vector<uint8_t>& out) {
+  out.assign(data, data + layout.header_size);
+  out[layout.height_offset] = static_cast<uint8_t>(rows >> 8);
+  out[layout.height_offset + 1] = static_cast<uint8_t>(rows & 0xFF);
+  for (size_t i = first_segment; i < end_segment; ++i) {
+    if (i > first_segment) {
+      out.push_back(0xFF);
+      out.push_back(static_cast<uint8_t>(0xD0 + (i - first_segment - 1) % 8));
+    }
+    const auto [begin, end] = layout.segments[i];
+    out.insert(out.end(), data + begin, data + end);
+  }
+  out.push_back(0xFF);
+  out.push_back(0xD9);
+}
+
+#ifdef SYZYGY_HAVE_JPEG
+
+struct ErrorManager {
+  jpeg_error_mgr pub;
+  std::jmp_buf jump;
+};
+
+void on_jpeg_error(j_common_ptr cinfo) {
+  auto* err = reinterpret_cast<ErrorManager*>(cinfo->err);
+  std::longjmp(err->jump, 1);
+}
+
+// UVC cards routinely emit frames with minor entropy glitches; libjpeg's
+// warnings for those would flood the log at 60 Hz.
+void ignore_jpeg_message(j_common_ptr, int) {}
+
+// Decodes an image whose top row lands on frame row `image_row`, writing
+// only rows [first_row, first_row + rows); the rest is context.
+bool decode_rows(const uint8_t* data, size_t size, Frame& frame,
+                 uint32_t image_row, uint32_t first_row, uint32_t rows) {
+  jpeg_decompress_struct cinfo{};
+  ErrorManager err{};
+  cinfo.err = jpeg_std_error(&err.pub);
+  err.pub.error_exit = on_jpeg_error;
+  err.pub.emit_message = ignore_jpeg_message;
+
+  if (setjmp(err.jump)) {
+    jpeg_destroy_decompress(&cinfo);
+    return false;
+  }
+
+  jpeg_create_decompress(&cinfo);
+  jpeg_mem_src(&cinfo, const_cast<unsigned char*>(data),
+               static_cast<unsigned long>(size));
+  jpeg_read_header(&cinfo, TRUE);
+  cinfo.out_color_space = JCS_RGB;
+  cinfo.dct_method = JDCT_IFAST;
+  jpeg_start_decompress(&cinfo);
+
+  const uint32_t end = first_row + rows;
+  if (cinfo.output_width != frame.width || cinfo.output_components != 3 ||
+      first_row < image_row || end > frame.height ||
+      end > image_row + cinfo.output_height) {
+    jpeg_destroy_decompress(&cinfo);
+    return false;
+  }
+
+  thread_local std::vector<uint8_t> discard;
+  discard.resize(static_cast<size_t>(frame.width) * 3);
+  JSAMPROW row_pointers[kRowBatch];
+  while (image_row + cinfo.output_scanline < end) {
+    const uint32_t next = image_row + cinfo.output_scanline;
+    const uint32_t batch = std::min<uint32_t>(kRowBatch, end - next);
+    for (uint32_t i = 0; i < batch; ++i) {
+      row_pointers[i] =
+          next + i < first_row
+              ? discard.data()
+              : frame.rgb.data() + static_cast<size_t>(next + i) * frame.stride;
+    }
+    jpeg_read_scanlines(&cinfo, row_pointers, batch);
+  }
+
+  if (cinfo.output_scanline == cinfo.output_height) {
+    jpeg_finish_decompress(&cinfo);
+  } else {
+    jpeg_abort_decompress(&cinfo);
+  }
+  jpeg_destroy_decompress(&cinfo);
+  return true;
+}
+
+bool decode_scaled_rgb(const uint8_t* data, size_t size, uint32_t min_width,
+                       FrameSnapshot& out) {
+  jpeg_decompress_struct cinfo{};
+  ErrorManager err{};
+  cinfo.err = jpeg_std_error(&err.pub);
+  err.pub.error_exit = on_jpeg_error;
+  err.pub.emit_message = ignore_jpeg_message;
+
+  if (setjmp(err.jump)) {
+    jpeg_destroy_decompress(&cinfo);
+    return false;
+  }
+
+  jpeg_create_decompress(&cinfo);
+  jpeg_mem_src(&cinfo, const_cast<unsigned char*>(data),
+               static_cast<unsigned long>(size));
+  jpeg_read_header(&cinfo, TRUE);
+  cinfo.out_color_space = JCS_RGB;
+  cinfo.dct_method = JDCT_IFAST;
+  cinfo.do_fancy_upsampling = FALSE;
+  cinfo.scale_num = 1;
+  cinfo.scale_denom = 8;
+  while (cinfo.scale_denom > 1 &&
+         cinfo.image_width / cinfo.scale_denom < min_width) {
+    cinfo.scale_denom /= 2;
+  }
+  jpeg_start_decompress(&cinfo);
+  if (cinfo.output_components != 3) {
+    jpeg_destroy_decompress(&cinfo);
+    return false;
+  }
+
+  out.width = cinfo.output_width;
+  out.height = cinfo.output_height;
+  out.rgb.resize(static_cast<size_t>(out.width) * out.height * 3);
+  while (cinfo.output_scanline < cinfo.output_height) {
+    JSAMPROW row = out.rgb.data() +
+                   static_cast<size_t>(cinfo.output_scanline) * out.width * 3;
+    jpeg_read_scanlines(&cinfo, &row, 1);
+  }
+  jpeg_finish_decompress(&cinfo);
+  jpeg_destroy_decompress(&cinfo);
+  return true;
+}
+
+#else
+
+bool decode_rows(const uint8_t*, size_t, Frame&, uint32_t, uint32_t,
+                 uint32_t) {
+  return false;
+}
+
+bool decode_scaled_rgb(const uint8_t*, size_t, uint32_t, FrameSnapshot&) {
+  return false;
+}
+
+#endif
+
+}  // namespace
+
+struct MjpegDecoder::Job {
+  struct Band {
+    // What the band writes.
+    uint32_t first_row{0};
+    uint32_t rows{0};
+    // What it decodes: restart intervals [first_segment, end_segment) of
+    // layout, image_rows tall from frame row image_row.
+    uint32_t image_row{0};
+    uint32_t image_rows{0};
+    size_t first_segment{0};
+    size_t end_segment{0};
+  };
+
+  FrameLease source;
+  FrameRef target;
+  Completion done;
+  syzygy::clock::TimePoint start;
+  // Only filled in when the frame is split.
+  RestartLayout layout;
+  std::vector<Band> bands;
+  std::atomic<uint32_t> remaining{0};
+  std::atomic<bool> failed{false};
+};
+
+MjpegDecoder::MjpegDecoder(size_t workers)
+    : workers_(std::max<size_t>(workers, 1)), pool_(workers_) {}
+
+MjpegDecoder::~MjpegDecoder() {
+  drain();
+}
+
+bool MjpegDecoder::available() noexcept {
+#ifdef SYZYGY_HAVE_JPEG
+  return true;
+#else
+  return false;
+#endif
+}
+
+double MjpegDecoder::estimated_ms_per_megapixel() noexcept {
+  return g_ms_per_megapixel.load(std::memory_order_relaxed);
+}
+
+bool MjpegDecoder::decode_scaled(const uint8_t* data, size_t size,
+                                 uint32_t min_width, FrameSnapshot& out) {
+  return decode_scaled_rgb(data, size, min_width, out);
+}
+
+bool MjpegDecoder::submit(FrameLease source, FrameRef target,
+                          Completion done) {
+  uint32_t in_flight = in_flight_.load(std::memory_order_relaxed);
+  do {
+    if (in_flight >= max_in_flight()) {
+      backlog_drops_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+  } while (!in_flight_.compare_exchange_weak(in_flight, in_flight + 1,
+                                             std::memory_order_acq_rel));
+
+  auto job = std::make_shared<Job>();
+  job->source = std::move(source);
+  job->target = std::move(target);
+  job->done = std::move(done);
+  job->start = syzygy::clock::now();
+
+  plan_bands(*job);
+  const auto bands = static_cast<uint32_t>(job->bands.size());
+  job->remaining.store(bands, std::memory_order_relaxed);
+  for (uint32_t band = 0; band < bands; ++band) {
+    pool_.enqueue([this, job, band]() { run_band(job, band); });
+  }
+  return true;
+}
+
+void MjpegDecoder::plan_bands(Job& job) const {
+  const Frame& target = *job.target;
+  const double megapixels =
+      static_cast<double>(target.width) * target.height / 1e6;
+  RestartLayout& layout = job.layout;
+  if (workers_ < 2 || megapixels < kBandSplitMegapixels ||
+      !find_restart_layout(job.source.data(), job.source.size(), layout) ||
+      layout.height != target.height) {
+    job.layout = {};
+    job.bands.push_back({0, target.height, 0, target.height, 0, 0});
+    return;
+  }
+  // Band edges have to fall where an MCU row and an interval both start.
+  const uint32_t step = layout.interval /
+                        std::gcd(layout.interval, layout.mcus_per_row);
+  const uint32_t wanted =
+      static_cast<uint32_t>(std::min<size_t>(workers_, kMaxBands));
+  uint32_t band_mcu_rows = (layout.mcu_rows + wanted - 1) / wanted;
+  band_mcu_rows = (band_mcu_rows + step - 1) / step * step;
+  for (uint32_t row = 0; row < layout.mcu_rows; row += band_mcu_rows) {
+    const uint32_t end = std::min(row + band_mcu_rows, layout.mcu_rows);
+    // A step of context either side: upsampling subsampled chroma reads
+    // the rows across the edge, so seams would otherwise differ.
+    const uint32_t from = row == 0 ? 0 : row - step;
+    const uint32_t to = std::min(end + step, layout.mcu_rows);
+    Job::Band band;
+    band.first_row = row * layout.mcu_height;
+    band.rows = std::min(end * layout.mcu_height, target.height) -
+                band.first_row;
+    band.image_row = from * layout.mcu_height;
+    band.image_rows =
+        std::min(to * layout.mcu_height, target.height) - band.image_row;
+    band.first_segment = static_cast<size_t>(from) * layout.mcus_per_row /
+                         layout.interval;
+    band.end_segment = to == layout.mcu_rows
+                           ? layout.segments.size()
+                           : static_cast<size_t>(to) * layout.mcus_per_row /
+                                 layout.interval;
+    job.bands.push_back(band);
+  }
+}
+
+void MjpegDecoder::drain() {
+  std::unique_lock<std::mutex> lock(drain_mutex_);
+  drain_cv_.wait(lock, [this]() {
+    return in_flight_.load(std::memory_order_acquire) == 0;
+  });
+}
+
+MjpegDecoder::Stats MjpegDecoder::stats() const {
+  Stats stats{};
+  stats.workers = static_cast<uint32_t>(workers_);
+  stats.in_flight = in_flight_.load(std::memory_order_relaxed);
+  stats.last_decode_ms =
+      static_cast<double>(last_decode_ns_.load(std::memory_order_relaxed)) /
+      1e6;
+  stats.average_decode_ms =
+      static_cast<double>(average_decode_ns_.load(std::memory_order_relaxed)) /
+      1e6;
+  stats.decoded = decoded_.load(std::memory_order_relaxed);
+  stats.cpu_ms =
+      static_cast<double>(cpu_ns_.load(std::memory_order_relaxed)) / 1e6;
+  stats.failures = failures_.load(std::memory_order_relaxed);
+  stats.backlog_drops = backlog_drops_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void MjpegDecoder::run_band(const std::shared_ptr<Job>& job, uint32_t band) {
+  if (!job->failed.load(std::memory_order_relaxed)) {
+    const int64_t cpu_before = thread_cpu_ns();
+    const Job::Band& rows = job->bands[band];
+    bool decoded = false;
+    if (job->layout.segments.empty()) {
+      decoded = decode_rows(job->source.data(), job->source.size(),
+                            *job->target, 0, rows.first_row, rows.rows);
+    } else {
+      thread_local std::vector<uint8_t> scratch;
+      build_band(job->source.data(), job->layout, rows.image_rows,
+                 rows.first_segment, rows.end_segment, scratch);
+      decoded = decode_rows(scratch.data(), scratch.size(), *job->target,
+                            rows.image_row, rows.first_row, rows.rows);
+    }
+    if (!decoded) {
+      job->failed.store(true, std::memory_order_relaxed);
+    }
+    // Counted before the last band finishes the job; after that the
+    // decoder may already be gone.
+    cpu_ns_.fetch_add(thread_cpu_ns() - cpu_before,
+                      std::memory_order_relaxed);
+  }
+  if (job->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    finish(job);
+  }
+}
+
+void MjpegDecoder::finish(const std::shared_ptr<Job>& job) {
+  const auto elapsed = syzygy::clock::now() - job->start;
+  const int64_t elapsed_ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+  const double decode_ms = static_cast<double>(elapsed_ns) / 1e6;
+
+  if (job->failed.load(std::memory_order_relaxed)) {
+    failures_.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    last_decode_ns_.store(elapsed_ns, std::memory_order_relaxed);
+    const int64_t average = average_decode_ns_.load(std::memory_order_relaxed);
+    average_decode_ns_.store(
+        average == 0 ? elapsed_ns : average + (elapsed_ns - average) / 8,
+        std::memory_order_relaxed);
+    decoded_.fetch_add(1, std::memory_order_relaxed);
+
+    const double megapixels =
+        static_cast<double>(job->target->width) * job->target->height / 1e6;
+    if (megapixels > 0.0) {
+      const double per_mp = decode_ms / megapixels;
+      const double previous =
+          g_ms_per_megapixel.load(std::memory_order_relaxed);
+      g_ms_per_megapixel.store(previous + (per_mp - previous) * 0.1,
+                               std::memory_order_relaxed);
+    }
+
+    complete_frame(job->source, job->target, job->done, decode_ms);
+  }
+  job->source.reset();
+  job->target.reset();
+  job->done = nullptr;
+
+  // Notified under the lock: drain() may return, and the decoder be
+  // destroyed, as soon as it sees the count reach zero.
+  std::lock_guard<std::mutex> lock(drain_mutex_);
+  in_flight_.fetch_sub(1, std::memory_order_acq_rel);
+  drain_cv_.notify_all();
+}
+
+}  // namespace syzygy::capture
@@ -0,0 +1,91 @@
+#pragma once
+
+// Copyright (c) 2025 Zoe Gates <zoe@zeocities.dev>
+//
+// Multithreaded MJPEG decoder writing RGB24 straight into pooled frames.
+// Several frames can be in flight at once, and large frames that carry
+// restart markers (DRI) are split into horizontal bands at interval
+// boundaries, each decoded on its own worker. Frames without them are
+// decoded whole.
+
+#include "capture/frame_pool.hpp"
+#include "capture/frame_snapshot.hpp"
+#include "capture/lease_pool.hpp"
+#include "util/thread_pool.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace syzygy::capture {
+
+class MjpegDecoder {
+ public:
+  struct Stats {
+    uint32_t workers{0};
+    uint32_t in_flight{0};
+    double last_decode_ms{0.0};
+    double average_decode_ms{0.0};
+    uint64_t decoded{0};
+    // Thread CPU time of every band so far, on all workers.
+    double cpu_ms{0.0};
+    uint64_t failures{0};
+    uint64_t backlog_drops{0};
+  };
+
+  // Called on a worker thread once the frame is fully decoded.
+  using Completion = FrameCompletion;
+
+  explicit MjpegDecoder(size_t workers);
+  ~MjpegDecoder();
+
+  MjpegDecoder(const MjpegDecoder&) = delete;
+  MjpegDecoder& operator=(const MjpegDecoder&) = delete;
+
+  static bool available() noexcept;
+
+  // Measured decode cost shared by every session, used by mode selection.
+  static double estimated_ms_per_megapixel() noexcept;
+
+  // One-off reduced decode on the calling thread for previews. libjpeg's
+  // DCT scaling (down to 1/8) only reconstructs what the smaller output
+  // needs; the result is at least `min_width` wide when the image is.
+  static bool decode_scaled(const uint8_t* data, size_t size,
+                            uint32_t min_width, FrameSnapshot& out);
+
+  // Returns false (and counts a backlog drop) when every worker is busy.
+  bool submit(FrameLease source, FrameRef target, Completion done);
+
+  // Blocks until every submitted frame has completed.
+  void drain();
+
+  size_t workers() const noexcept { return workers_; }
+  size_t max_in_flight() const noexcept { return workers_; }
+  Stats stats() const;
+
+ private:
+  struct Job;
+
+  // Splits the frame when its restart intervals allow it.
+  void plan_bands(Job& job) const;
+  void run_band(const std::shared_ptr<Job>& job, uint32_t band);
+  void finish(const std::shared_ptr<Job>& job);
+
+  size_t workers_{0};
+
+  std::mutex drain_mutex_;
+  std::condition_variable drain_cv_;
+  std::atomic<uint32_t> in_flight_{0};
+  std::atomic<int64_t> last_decode_ns_{0};
+  std::atomic<int64_t> average_decode_ns_{0};
+  std::atomic<uint64_t> decoded_{0};
+  std::atomic<int64_t> cpu_ns_{0};
+  std::atomic<uint64_t> failures_{0};
+  std::atomic<uint64_t> backlog_drops_{0};
+  // Last, so its workers are joined before anything they touch goes away.
+  util::ThreadPool pool_;
+};
+
+}  // namespace syzygy::capture
@@ -0,0 +1,132 @@
+#include "capture/mode_policy.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+
+namespace syzygy::capture {
+
+namespace {
+
+// Share of the raw link rate a UVC stream gets in practice: high speed
+// isochronous tops out near 200 Mbit/s, SuperSpeed well below 5 Gbit/s.
+double usable_link_fraction(double link_mbps) {
+  return link_mbps <= 480.0 ? 0.4 : 0.6;
+}
+
+// Cadence error of showing `fps` frames on a `display_hz` monitor: zero when
+// one rate is an integer multiple of the other.
+double cadence_error(double fps, double display_hz) {
+  const double ratio = std::max(fps, display_hz) / std::min(fps, display_hz);
+  return std::abs(ratio - std::round(ratio));
+}
+
+constexpr double kCadenceTolerance = 0.02;
+constexpr double kJudderPenalty = 0.25;
+
+}  // namespace
+
+double mode_cost_ms(const ModeCandidate& mode, const ModeContext& context) {
+  const double area = static_cast<double>(mode.width) * mode.height;
+  if (mode.format->compressed) {
+    return context.decode_ms_per_megapixel * area / 1e6;
+  }
+  return mode.format->ns_per_pixel * area / 1e6;
+}
+
+std::optional<double> score_mode(ModePolicy policy, const ModeCandidate& mode,
+                                 const ModeContext& context) {
+  if (!mode.format || mode.fps <= 0.0) {
+    return std::nullopt;
+  }
+  const double area = static_cast<double>(mode.width) * mode.height;
+  const double interval_ms = 1000.0 / mode.fps;
+  const double cost_ms = mode_cost_ms(mode, context);
+  if (mode.format->compressed) {
+    // Frames decode in parallel, but each one must still finish within two
+    // frame intervals or the decoder becomes the latency floor.
+    const double workers =
+        static_cast<double>(std::max<size_t>(context.decode_workers, 1));
+    if (cost_ms > 2.0 * interval_ms || cost_ms / workers > interval_ms) {
+      return std::nullopt;
+    }
+  } else if (cost_ms > interval_ms) {
+    return std::nullopt;
+  }
+
+  if (context.usb_link_mbps > 0.0) {
+    const double stream_mbps =
+        area * mode.fps * mode.format->bits_per_pixel / 1e6;
+    if (stream_mbps >
+        context.usb_link_mbps * usable_link_fraction(context.usb_link_mbps)) {
+      return std::nullopt;
+    }
+  }
+
+  // Conversion cost only separates otherwise equivalent modes.
+  const double quality = area * mode.fps - cost_ms;
+  switch (policy) {
+    case ModePolicy::LowestLatency:
+      return -(interval_ms + cost_ms) + area * 1e-9;
+    case ModePolicy::MatchDisplay: {
+      const double display_hz = context.display_refresh_hz;
+      if (display_hz <= 0.0) {
+        return quality;
+      }
+      // Frames beyond the refresh rate are never shown.
+      const double shown = area * std::min(mode.fps, display_hz) - cost_ms;
+      return cadence_error(mode.fps, display_hz) < kCadenceTolerance
+                 ? shown
+                 : shown * kJudderPenalty;
+    }
+    case ModePolicy::MaxQuality:
+    default:
+      return quality;
+  }
+}
+
+double usb_link_mbps(const std::string& device_path) {
+  namespace fs = std::filesystem;
+  const auto node = fs::path(device_path).filename();
+  std::error_code ec;
+  auto dir = fs::canonical(fs::path("/sys/class/video4linux") / node / "device",
+                           ec);
+  if (ec) {
+    return 0.0;
+  }
+  // The node's parent is the UVC interface; the USB device sits above it.
+  for (int depth = 0; depth < 3 && !dir.empty(); ++depth) {
+    std::ifstream speed(dir / "speed");
+    double mbps = 0.0;
+    if (speed >> mbps) {
+      return mbps;
+    }
+    dir = dir.parent_path();
+  }
+  return 0.0;
+}
+
+std::string_view to_string(ModePolicy policy) {
+  switch (policy) {
+    case ModePolicy::LowestLatency:
+      return "lowest_latency";
+    case ModePolicy::MatchDisplay:
+      return "match_display";
+    case ModePolicy::MaxQuality:
+    default:
+      return "max_quality";
+  }
+}
+
+std::optional<ModePolicy> mode_policy_from_string(std::string_view name) {
+  for (const auto policy : {ModePolicy::MaxQuality, ModePolicy::LowestLatency,
+                            ModePolicy::MatchDisplay}) {
+    if (to_string(policy) == name) {
+      return policy;
+    }
+  }
+  return std::nullopt;
+}
+
+}  // namespace syzygy::capture
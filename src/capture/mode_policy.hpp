@@ -0,0 +1,55 @@
+#pragma once
+
+// Copyright (c) 2025 Zoe Gates <zoe@zeocities.dev>
+//
+// Policies that rank the capture modes a device offers. Every policy
+// rejects modes the host cannot sustain (conversion or decode slower than
+// the frame interval, more data than the USB link carries) and then orders
+// the rest by its own goal.
+
+#include "capture/pixel_convert.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace syzygy::capture {
+
+enum class ModePolicy {
+  MaxQuality,     // Largest area * fps.
+  LowestLatency,  // Shortest frame interval plus conversion time.
+  MatchDisplay    // Capture rate with an even cadence on the monitor.
+};
+
+struct ModeCandidate {
+  const PixelFormatInfo* format{nullptr};
+  uint32_t width{0};
+  uint32_t height{0};
+  double fps{0.0};
+};
+
+struct ModeContext {
+  // Zero when unknown; MatchDisplay then behaves like MaxQuality.
+  double display_refresh_hz{0.0};
+  // Negotiated USB link speed; zero for non-USB devices.
+  double usb_link_mbps{0.0};
+  size_t decode_workers{1};
+  double decode_ms_per_megapixel{0.0};
+};
+
+// Time to turn one frame of the candidate into RGB on a single core.
+double mode_cost_ms(const ModeCandidate& mode, const ModeContext& context);
+
+// Higher is better; nullopt when the mode cannot be sustained.
+std::optional<double> score_mode(ModePolicy policy, const ModeCandidate& mode,
+                                 const ModeContext& context);
+
+// Link speed from sysfs for /dev/videoN nodes backed by a USB device.
+double usb_link_mbps(const std::string& device_path);
+
+std::string_view to_string(ModePolicy policy);
+std::optional<ModePolicy> mode_policy_from_string(std::string_view name);
+
+}  // namespace syzygy::capture
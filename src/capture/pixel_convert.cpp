@@ -0,0 +1,388 @@
+#include "capture/pixel_convert.hpp"
+
+#include <linux/videodev2.h>
+
+#include <algorithm>
+
+namespace syzygy::capture {
+
+namespace {
+
+struct Coefficients {
+  int r_v;
+  int g_u;
+  int g_v;
+  int b_u;
+};
+
+Coefficients coefficients_for(uint32_t width, uint32_t height) {
+  const bool use_bt709 = (width >= 1280 || height >= 720);
+  // Coefficients scaled by 256 to keep the integer math fast.
+  if (use_bt709) {
+    return {459, 55, 136, 541};
+  }
+  return {409, 100, 208, 516};
+}
+
+inline uint8_t clamp_u8(int value) {
+  return static_cast<uint8_t>(std::clamp(value, 0, 255));
+}
+
+inline void yuv_to_rgb(uint8_t y, int d, int e, const Coefficients& k,
+                       uint8_t* dst) {
+  int c = static_cast<int>(y) - 16;
+  if (c < 0) {
+    c = 0;
+  }
+  const int luma = 298 * c + 128;
+  dst[0] = clamp_u8((luma + k.r_v * e) >> 8);
+  dst[1] = clamp_u8((luma - k.g_u * d - k.g_v * e) >> 8);
+  dst[2] = clamp_u8((luma + k.b_u * d) >> 8);
+}
+
+// Packed 4:2:2, parameterised on the byte offsets within each macropixel.
+template <int kY0, int kU, int kY1, int kV>
+void convert_packed_422(const SourceImage& src, uint8_t* dst,
+                        uint32_t dst_stride) {
+  const auto k = coefficients_for(src.width, src.height);
+  const auto& plane = src.planes[0];
+  for (uint32_t row = 0; row < src.height; ++row) {
+    const uint8_t* in = plane.data + static_cast<size_t>(row) * plane.stride;
+    uint8_t* out = dst + static_cast<size_t>(row) * dst_stride;
+    for (uint32_t x = 0; x + 1 < src.width; x += 2) {
+      const int d = static_cast<int>(in[kU]) - 128;
+      const int e = static_cast<int>(in[kV]) - 128;
+      yuv_to_rgb(in[kY0], d, e, k, out);
+      yuv_to_rgb(in[kY1], d, e, k, out + 3);
+      in += 4;
+      out += 6;
+    }
+  }
+}
+
+// NV12/NV21 (kChromaShift = 1) and NV16/NV61 (kChromaShift = 0).
+template <uint32_t kChromaShift, bool kSwapUV>
+void convert_semi_planar(const SourceImage& src, uint8_t* dst,
+                         uint32_t dst_stride) {
+  const auto k = coefficients_for(src.width, src.height);
+  const auto& luma = src.planes[0];
+  const auto& chroma = src.planes[1];
+  for (uint32_t row = 0; row < src.height; ++row) {
+    const uint8_t* y_in = luma.data + static_cast<size_t>(row) * luma.stride;
+    const uint8_t* uv_in =
+        chroma.data + static_cast<size_t>(row >> kChromaShift) * chroma.stride;
+    uint8_t* out = dst + static_cast<size_t>(row) * dst_stride;
+    for (uint32_t x = 0; x + 1 < src.width; x += 2) {
+      const int d = static_cast<int>(uv_in[kSwapUV ? 1 : 0]) - 128;
+      const int e = static_cast<int>(uv_in[kSwapUV ? 0 : 1]) - 128;
+      yuv_to_rgb(y_in[0], d, e, k, out);
+      yuv_to_rgb(y_in[1], d, e, k, out + 3);
+      y_in += 2;
+      uv_in += 2;
+      out += 6;
+    }
+  }
+}
+
+// Three-plane 4:2:0 (YU12/I420).
+void convert_yuv420(const SourceImage& src, uint8_t* dst,
+                    uint32_t dst_stride) {
+  const auto k = coefficients_for(src.width, src.height);
+  const auto& luma = src.planes[0];
+  const auto& cb = src.planes[1];
+  const auto& cr = src.planes[2];
+  for (uint32_t row = 0; row < src.height; ++row) {
+    const uint8_t* y_in = luma.data + static_cast<size_t>(row) * luma.stride;
+    const uint8_t* u_in = cb.data + static_cast<size_t>(row >> 1) * cb.stride;
+    const uint8_t* v_in = cr.data + static_cast<size_t>(row >> 1) * cr.stride;
+    uint8_t* out = dst + static_cast<size_t>(row) * dst_stride;
+    for (uint32_t x = 0; x + 1 < src.width; x += 2) {
+      const int d = static_cast<int>(*u_in++) - 128;
+      const int e = static_cast<int>(*v_in++) - 128;
+      yuv_to_rgb(y_in[0], d, e, k, out);
+      yuv_to_rgb(y_in[1], d, e, k, out + 3);
+      y_in += 2;
+      out += 6;
+    }
+  }
+}
+
+// Source column or row sampled for each output one: the centre of the span
+// it covers.
+inline uint32_t sample_position(uint32_t index, uint32_t dst_size,
+                                uint32_t src_size) {
+  return static_cast<uint32_t>(
+      (2 * static_cast<uint64_t>(index) + 1) * src_size / (2 * dst_size));
+}
+
+// `sample(row, x, out)` writes one RGB24 pixel for source column x of the
+// row selected by `row(sy)`; only sampled rows and columns are read.
+template <typename Row, typename Sample>
+void decimate(const SourceImage& src, uint8_t* dst, uint32_t dst_width,
+              uint32_t dst_height, uint32_t dst_stride, Row row,
+              Sample sample) {
+  for (uint32_t y = 0; y < dst_height; ++y) {
+    const auto source_row = row(sample_position(y, dst_height, src.height));
+    uint8_t* out = dst + static_cast<size_t>(y) * dst_stride;
+    for (uint32_t x = 0; x < dst_width; ++x) {
+      sample(source_row, sample_position(x, dst_width, src.width), out);
+      out += 3;
+    }
+  }
+}
+
+struct PlanarRow {
+  const uint8_t* y;
+  const uint8_t* u;
+  const uint8_t* v;
+};
+
+template <int kY0, int kU, int kY1, int kV>
+void decimate_packed_422(const SourceImage& src, uint8_t* dst,
+                         uint32_t dst_width, uint32_t dst_height,
+                         uint32_t dst_stride) {
+  const auto k = coefficients_for(src.width, src.height);
+  const auto& plane = src.planes[0];
+  decimate(
+      src, dst, dst_width, dst_height, dst_stride,
+      [&](uint32_t sy) {
+        return plane.data + static_cast<size_t>(sy) * plane.stride;
+      },
+      [&](const uint8_t* in, uint32_t sx, uint8_t* out) {
+        const uint8_t* macropixel = in + static_cast<size_t>(sx >> 1) * 4;
+        yuv_to_rgb(macropixel[(sx & 1) ? kY1 : kY0],
+                   static_cast<int>(macropixel[kU]) - 128,
+                   static_cast<int>(macropixel[kV]) - 128, k, out);
+      });
+}
+
+template <uint32_t kChromaShift, bool kSwapUV>
+void decimate_semi_planar(const SourceImage& src, uint8_t* dst,
+                          uint32_t dst_width, uint32_t dst_height,
+                          uint32_t dst_stride) {
+  const auto k = coefficients_for(src.width, src.height);
+  const auto& luma = src.planes[0];
+  const auto& chroma = src.planes[1];
+  decimate(
+      src, dst, dst_width, dst_height, dst_stride,
+      [&](uint32_t sy) {
+        const uint8_t* uv = chroma.data + static_cast<size_t>(
+                                              sy >> kChromaShift) *
+                                              chroma.stride;
+        return PlanarRow{luma.data + static_cast<size_t>(sy) * luma.stride,
+                         uv, uv};
+      },
+      [&](const PlanarRow& in, uint32_t sx, uint8_t* out) {
+        const uint8_t* uv = in.u + (sx & ~1u);
+        yuv_to_rgb(in.y[sx], static_cast<int>(uv[kSwapUV ? 1 : 0]) - 128,
+                   static_cast<int>(uv[kSwapUV ? 0 : 1]) - 128, k, out);
+      });
+}
+
+void decimate_yuv420(const SourceImage& src, uint8_t* dst, uint32_t dst_width,
+                     uint32_t dst_height, uint32_t dst_stride) {
+  const auto k = coefficients_for(src.width, src.height);
+  const auto& luma = src.planes[0];
+  const auto& cb = src.planes[1];
+  const auto& cr = src.planes[2];
+  decimate(
+      src, dst, dst_width, dst_height, dst_stride,
+      [&](uint32_t sy) {
+        return PlanarRow{luma.data + static_cast<size_t>(sy) * luma.stride,
+                         cb.data + static_cast<size_t>(sy >> 1) * cb.stride,
+                         cr.data + static_cast<size_t>(sy >> 1) * cr.stride};
+      },
+      [&](const PlanarRow& in, uint32_t sx, uint8_t* out) {
+        yuv_to_rgb(in.y[sx], static_cast<int>(in.u[sx >> 1]) - 128,
+                   static_cast<int>(in.v[sx >> 1]) - 128, k, out);
+      });
+}
+
+template <bool kSwapRB>
+void decimate_rgb(const SourceImage& src, uint8_t* dst, uint32_t dst_width,
+                  uint32_t dst_height, uint32_t dst_stride) {
+  const auto& plane = src.planes[0];
+  decimate(
+      src, dst, dst_width, dst_height, dst_stride,
+      [&](uint32_t sy) {
+        return plane.data + static_cast<size_t>(sy) * plane.stride;
+      },
+      [](const uint8_t* in, uint32_t sx, uint8_t* out) {
+        const uint8_t* pixel = in + static_cast<size_t>(sx) * 3;
+        out[0] = pixel[kSwapRB ? 2 : 0];
+        out[1] = pixel[1];
+        out[2] = pixel[kSwapRB ? 0 : 2];
+      });
+}
+
+constexpr PixelFormatInfo kFormats[] = {
+    {V4L2_PIX_FMT_YUYV, 1, 1, convert_packed_422<0, 1, 2, 3>, 1.0, 16.0, false,
+     false, PixelLayout::Rgb24},
+    {V4L2_PIX_FMT_YVYU, 1, 1, convert_packed_422<0, 3, 2, 1>, 1.0, 16.0, false,
+     false, PixelLayout::Rgb24},
+    {V4L2_PIX_FMT_UYVY, 1, 1, convert_packed_422<1, 0, 3, 2>, 1.0, 16.0, false,
+     false, PixelLayout::Rgb24},
+    {V4L2_PIX_FMT_NV12, 2, 1, convert_semi_planar<1, false>, 0.9, 12.0, false,
+     false, PixelLayout::Rgb24},
+    {V4L2_PIX_FMT_NV21, 2, 1, convert_semi_planar<1, true>, 0.9, 12.0, false,
+     false, PixelLayout::Rgb24},
+    {V4L2_PIX_FMT_NV16, 2, 1, convert_semi_planar<0, false>, 1.0, 16.0, false,
+     false, PixelLayout::Rgb24},
+    {V4L2_PIX_FMT_NV61, 2, 1, convert_semi_planar<0, true>, 1.0, 16.0, false,
+     false, PixelLayout::Rgb24},
+    {V4L2_PIX_FMT_YUV420, 3, 1, convert_yuv420, 0.9, 12.0, false, false,
+     PixelLayout::Rgb24},
+    // Non-contiguous variants exposed by mplane-only drivers; the kernels
+    // only see plane pointers, so they are shared with the formats above.
+    {V4L2_PIX_FMT_NV12M, 2, 2, convert_semi_planar<1, false>, 0.9, 12.0,
+     false, false, PixelLayout::Rgb24},
+    {V4L2_PIX_FMT_NV21M, 2, 2, convert_semi_planar<1, true>, 0.9, 12.0, false,
+     false, PixelLayout::Rgb24},
+    {V4L2_PIX_FMT_NV16M, 2, 2, convert_semi_planar<0, false>, 1.0, 16.0,
+     false, false, PixelLayout::Rgb24},
+    {V4L2_PIX_FMT_NV61M, 2, 2, convert_semi_planar<0, true>, 1.0, 16.0, false,
+     false, PixelLayout::Rgb24},
+    {V4L2_PIX_FMT_YUV420M, 3, 3, convert_yuv420, 0.9, 12.0, false, false,
+     PixelLayout::Rgb24},
+    {V4L2_PIX_FMT_RGB24, 1, 1, nullptr, 0.0, 24.0, true, false,
+     PixelLayout::Rgb24},
+    {V4L2_PIX_FMT_BGR24, 1, 1, nullptr, 0.0, 24.0, true, false,
+     PixelLayout::Bgr24},
+    // Decode cost is measured at runtime by MjpegDecoder.
+    {V4L2_PIX_FMT_MJPEG, 1, 1, nullptr, 0.0, 3.0, false, true,
+     PixelLayout::Rgb24},
+};
+
+}  // namespace
+
+const PixelFormatInfo* find_pixel_format(uint32_t pixel_format) {
+  for (const auto& format : kFormats) {
+    if (format.pixel_format == pixel_format) {
+      return &format;
+    }
+  }
+  return nullptr;
+}
+
+SourceImage describe_contiguous(const PixelFormatInfo& format,
+                                const uint8_t* data, uint32_t width,
+                                uint32_t height, uint32_t bytes_per_line) {
+  SourceImage src{};
+  src.pixel_format = format.pixel_format;
+  src.width = width;
+  src.height = height;
+  src.planes[0] = {data, bytes_per_line};
+
+  const size_t luma_bytes = static_cast<size_t>(bytes_per_line) * height;
+  switch (format.pixel_format) {
+    case V4L2_PIX_FMT_NV12:
+    case V4L2_PIX_FMT_NV21:
+    case V4L2_PIX_FMT_NV16:
+    case V4L2_PIX_FMT_NV61:
+      src.planes[1] = {data + luma_bytes, bytes_per_line};
+      break;
+    case V4L2_PIX_FMT_YUV420: {
+      const uint32_t chroma_stride = bytes_per_line / 2;
+      const size_t chroma_bytes =
+          static_cast<size_t>(chroma_stride) * ((height + 1) / 2);
+      src.planes[1] = {data + luma_bytes, chroma_stride};
+      src.planes[2] = {data + luma_bytes + chroma_bytes, chroma_stride};
+      break;
+    }
+    default:
+      break;
+  }
+  return src;
+}
+
+uint64_t contiguous_frame_bytes(const PixelFormatInfo& format,
+                                uint32_t height, uint32_t bytes_per_line) {
+  const uint64_t luma = static_cast<uint64_t>(bytes_per_line) * height;
+  switch (format.pixel_format) {
+    case V4L2_PIX_FMT_NV12:
+    case V4L2_PIX_FMT_NV21:
+    case V4L2_PIX_FMT_YUV420:
+      return luma + luma / 2;
+    case V4L2_PIX_FMT_NV16:
+    case V4L2_PIX_FMT_NV61:
+      return luma * 2;
+    case V4L2_PIX_FMT_MJPEG:
+      return 0;
+    default:
+      return luma;
+  }
+}
+
+uint64_t memory_plane_bytes(const PixelFormatInfo& format, uint32_t plane,
+                            uint32_t height, uint32_t bytes_per_line) {
+  if (format.memory_planes <= 1) {
+    return contiguous_frame_bytes(format, height, bytes_per_line);
+  }
+  if (plane == 0) {
+    return static_cast<uint64_t>(bytes_per_line) * height;
+  }
+  switch (format.pixel_format) {
+    case V4L2_PIX_FMT_NV16M:
+    case V4L2_PIX_FMT_NV61M:
+      return static_cast<uint64_t>(bytes_per_line) * height;
+    default:
+      return static_cast<uint64_t>(bytes_per_line) * ((height + 1) / 2);
+  }
+}
+
+bool convert_decimated(const SourceImage& src, uint8_t* dst,
+                       uint32_t dst_width, uint32_t dst_height,
+                       uint32_t dst_stride) {
+  if (dst_width == 0 || dst_height == 0 || dst_width > src.width ||
+      dst_height > src.height) {
+    return false;
+  }
+  switch (src.pixel_format) {
+    case V4L2_PIX_FMT_YUYV:
+      decimate_packed_422<0, 1, 2, 3>(src, dst, dst_width, dst_height,
+                                      dst_stride);
+      return true;
+    case V4L2_PIX_FMT_YVYU:
+      decimate_packed_422<0, 3, 2, 1>(src, dst, dst_width, dst_height,
+                                      dst_stride);
+      return true;
+    case V4L2_PIX_FMT_UYVY:
+      decimate_packed_422<1, 0, 3, 2>(src, dst, dst_width, dst_height,
+                                      dst_stride);
+      return true;
+    case V4L2_PIX_FMT_NV12:
+    case V4L2_PIX_FMT_NV12M:
+      decimate_semi_planar<1, false>(src, dst, dst_width, dst_height,
+                                     dst_stride);
+      return true;
+    case V4L2_PIX_FMT_NV21:
+    case V4L2_PIX_FMT_NV21M:
+      decimate_semi_planar<1, true>(src, dst, dst_width, dst_height,
+                                    dst_stride);
+      return true;
+    case V4L2_PIX_FMT_NV16:
+    case V4L2_PIX_FMT_NV16M:
+      decimate_semi_planar<0, false>(src, dst, dst_width, dst_height,
+                                     dst_stride);
+      return true;
+    case V4L2_PIX_FMT_NV61:
+    case V4L2_PIX_FMT_NV61M:
+      decimate_semi_planar<0, true>(src, dst, dst_width, dst_height,
+                                    dst_stride);
+      return true;
+    case V4L2_PIX_FMT_YUV420:
+    case V4L2_PIX_FMT_YUV420M:
+      decimate_yuv420(src, dst, dst_width, dst_height, dst_stride);
+      return true;
+    case V4L2_PIX_FMT_RGB24:
+      decimate_rgb<false>(src, dst, dst_width, dst_height, dst_stride);
+      return true;
+    case V4L2_PIX_FMT_BGR24:
+      decimate_rgb<true>(src, dst, dst_width, dst_height, dst_stride);
+      return true;
+    default:
+      return false;
+  }
+}
+
+}  // namespace syzygy::capture
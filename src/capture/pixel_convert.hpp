@@ -0,0 +1,74 @@
+#pragma once
+
+// Copyright (c) 2025 Zoe Gates <zoe@zeocities.dev>
+//
+// Conversion kernels from the common 8-bit V4L2 capture formats to the
+// packed RGB layout the display consumes.
+
+#include <array>
+#include <cstdint>
+
+namespace syzygy::capture {
+
+enum class PixelLayout {
+  Rgb24,
+  Bgr24
+};
+
+struct PlaneView {
+  const uint8_t* data{nullptr};
+  uint32_t stride{0};
+};
+
+struct SourceImage {
+  uint32_t pixel_format{0};
+  uint32_t width{0};
+  uint32_t height{0};
+  std::array<PlaneView, 3> planes{};
+};
+
+using ConvertFn = void (*)(const SourceImage& src, uint8_t* dst,
+                           uint32_t dst_stride);
+
+struct PixelFormatInfo {
+  uint32_t pixel_format;
+  uint32_t plane_count;
+  // Separate buffers per frame; 1 unless this is an mplane-only "M" format
+  // whose planes live in their own allocations.
+  uint32_t memory_planes;
+  // Null for passthrough and compressed formats.
+  ConvertFn convert;
+  // Rough single-core cost, used to rank otherwise equivalent modes.
+  double ns_per_pixel;
+  // Average bits per pixel on the wire (estimated for compressed formats).
+  double bits_per_pixel;
+  bool passthrough;
+  bool compressed;
+  PixelLayout layout;
+};
+
+// Returns nullptr for formats the capture path cannot consume.
+const PixelFormatInfo* find_pixel_format(uint32_t pixel_format);
+
+// Plane layout of a buffer holding every plane back to back.
+SourceImage describe_contiguous(const PixelFormatInfo& format,
+                                const uint8_t* data, uint32_t width,
+                                uint32_t height, uint32_t bytes_per_line);
+
+// Bytes a contiguous buffer must hold for the frame to be complete.
+uint64_t contiguous_frame_bytes(const PixelFormatInfo& format,
+                                uint32_t height, uint32_t bytes_per_line);
+
+// Same, for one memory plane of a format with separate plane allocations.
+uint64_t memory_plane_bytes(const PixelFormatInfo& format, uint32_t plane,
+                            uint32_t height, uint32_t bytes_per_line);
+
+// Point-samples a dst_width x dst_height RGB24 image out of `src`, reading
+// only the source pixels that land in the output, for previews far smaller
+// than the frame. Handles the raw formats above, not MJPEG, and only
+// shrinks; returns false otherwise.
+bool convert_decimated(const SourceImage& src, uint8_t* dst,
+                       uint32_t dst_width, uint32_t dst_height,
+                       uint32_t dst_stride);
+
+}  // namespace syzygy::capture
@@ -0,0 +1,124 @@
+#include "capture/queue_depth_controller.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace syzygy::capture {
+
+namespace {
+
+// Roughly a second at 60 fps; long enough that a single late frame does not
+// decide anything on its own.
+constexpr uint32_t kWindowFrames = 64;
+constexpr uint32_t kInitialCalmWindows = 4;
+constexpr uint32_t kMaxCalmWindows = 64;
+constexpr double kSmoothing = 1.0 / 16.0;
+
+// Headroom the queue must have left before a buffer is taken away: arrivals
+// and processing both need to sit well inside one frame interval.
+constexpr double kShrinkJitterFraction = 0.25;
+constexpr double kShrinkProcessFraction = 0.5;
+
+// Sequence jumps this large are a restarted counter, not dropped frames.
+constexpr uint32_t kMaxSequenceGap = 1000;
+
+}  // namespace
+
+QueueDepthController::QueueDepthController(uint32_t min_depth,
+                                           uint32_t max_depth,
+                                           uint32_t initial_depth)
+    : min_depth_(min_depth),
+      max_depth_(std::max(min_depth, max_depth)),
+      depth_(std::clamp(initial_depth, min_depth, max_depth_)),
+      calm_needed_(kInitialCalmWindows) {}
+
+void QueueDepthController::reset(double fps) {
+  fixed_interval_ = fps > 0.0;
+  interval_ms_ = fixed_interval_ ? 1000.0 / fps : 0.0;
+  primed_ = false;
+  jitter_ms_ = 0.0;
+  process_ms_ = 0.0;
+  window_frames_ = 0;
+  window_drops_ = 0;
+  calm_windows_ = 0;
+}
+
+uint32_t QueueDepthController::observe(uint32_t sequence,
+                                       syzygy::clock::TimePoint dequeue_time,
+                                       double process_ms,
+                                       uint64_t starvations) {
+  if (!primed_) {
+    primed_ = true;
+    last_sequence_ = sequence;
+    last_dequeue_ = dequeue_time;
+    last_starvations_ = starvations;
+    process_ms_ = process_ms;
+    return 0;
+  }
+
+  const uint32_t gap = sequence - last_sequence_;
+  if (gap > 1 && gap < kMaxSequenceGap) {
+    window_drops_ += gap - 1;
+    dropped_ += gap - 1;
+  }
+  // The driver had nothing to fill; the next frame may already be lost
+  // even if the sequence counter does not show it.
+  if (starvations != last_starvations_) {
+    window_drops_++;
+  }
+  last_sequence_ = sequence;
+  last_starvations_ = starvations;
+
+  const double delta_ms =
+      std::chrono::duration<double, std::milli>(dequeue_time - last_dequeue_)
+          .count();
+  last_dequeue_ = dequeue_time;
+  if (!fixed_interval_) {
+    interval_ms_ = interval_ms_ == 0.0
+                       ? delta_ms
+                       : interval_ms_ + (delta_ms - interval_ms_) * kSmoothing;
+  }
+  // Dropped frames show up as long gaps, which are not arrival jitter.
+  const double expected = interval_ms_ * std::max<uint32_t>(gap, 1);
+  jitter_ms_ += (std::abs(delta_ms - expected) - jitter_ms_) * kSmoothing;
+  process_ms_ += (process_ms - process_ms_) * kSmoothing;
+
+  if (++window_frames_ < kWindowFrames) {
+    return 0;
+  }
+  return evaluate_window();
+}
+
+uint32_t QueueDepthController::evaluate_window() {
+  const uint32_t drops = window_drops_;
+  window_frames_ = 0;
+  window_drops_ = 0;
+
+  if (drops > 0) {
+    calm_windows_ = 0;
+    if (last_change_was_shrink_) {
+      calm_needed_ = std::min(calm_needed_ * 2, kMaxCalmWindows);
+    }
+    if (depth_ >= max_depth_) {
+      return 0;
+    }
+    depth_++;
+    last_change_was_shrink_ = false;
+    return depth_;
+  }
+
+  if (++calm_windows_ < calm_needed_ || depth_ <= min_depth_) {
+    return 0;
+  }
+  calm_windows_ = 0;
+  if (interval_ms_ <= 0.0 ||
+      jitter_ms_ > interval_ms_ * kShrinkJitterFraction ||
+      process_ms_ > interval_ms_ * kShrinkProcessFraction) {
+    return 0;
+  }
+  depth_--;
+  last_change_was_shrink_ = true;
+  return depth_;
+}
+
+}  // namespace syzygy::capture
@@ -0,0 +1,61 @@
+#pragma once
+
+// Copyright (c) 2025 Zoe Gates <zoe@zeocities.dev>
+//
+// Picks the driver queue depth for the Adaptive latency preset. Every
+// queued buffer is a frame of latency, so the controller runs with as few as
+// it can and only adds one back when frames start going missing.
+
+#include "syzygy/clock.hpp"
+
+#include <cstdint>
+
+namespace syzygy::capture {
+
+class QueueDepthController {
+ public:
+  QueueDepthController(uint32_t min_depth, uint32_t max_depth,
+                       uint32_t initial_depth);
+
+  // Forgets per-stream history; call whenever streaming (re)starts. A zero
+  // fps makes the controller learn the interval from arrivals.
+  void reset(double fps);
+
+  // Feeds one dequeued buffer. `starvations` is the lease pool's running
+  // count of times the driver queue ran dry. Returns the new depth when it
+  // should change, 0 otherwise.
+  uint32_t observe(uint32_t sequence, syzygy::clock::TimePoint dequeue_time,
+                   double process_ms, uint64_t starvations);
+
+  uint32_t depth() const noexcept { return depth_; }
+  double jitter_ms() const noexcept { return jitter_ms_; }
+  uint64_t dropped() const noexcept { return dropped_; }
+
+ private:
+  uint32_t evaluate_window();
+
+  uint32_t min_depth_;
+  uint32_t max_depth_;
+  uint32_t depth_;
+
+  double interval_ms_{0.0};
+  bool fixed_interval_{false};
+  bool primed_{false};
+  uint32_t last_sequence_{0};
+  syzygy::clock::TimePoint last_dequeue_;
+  uint64_t last_starvations_{0};
+
+  double jitter_ms_{0.0};
+  double process_ms_{0.0};
+  uint32_t window_frames_{0};
+  uint32_t window_drops_{0};
+  uint32_t calm_windows_{0};
+  // Calm windows required before shrinking; doubled whenever a shrink has
+  // to be undone so the depth does not oscillate.
+  uint32_t calm_needed_;
+  bool last_change_was_shrink_{false};
+
+  uint64_t dropped_{0};
+};
+
+}  // namespace syzygy::capture
@@ -0,0 +1,77 @@
+#pragma once
+
+// Copyright (c) 2025 Zoe Gates <zoe@zeocities.dev>
+//
+// Occupancy and timing for one stage of the capture pipeline
+// (dequeue -> convert -> publish).
+
+#include <atomic>
+#include <cstdint>
+
+namespace syzygy::capture {
+
+struct StageStats {
+  // Frames currently inside the stage, queued ones included.
+  uint32_t occupancy{0};
+  uint32_t peak_occupancy{0};
+  uint64_t processed{0};
+  // Frames the stage turned away because it was full.
+  uint64_t drops{0};
+  double last_ms{0.0};
+  double average_ms{0.0};
+};
+
+class StageMeter {
+ public:
+  void enter() noexcept {
+    const uint32_t occupancy =
+        occupancy_.fetch_add(1, std::memory_order_relaxed) + 1;
+    uint32_t peak = peak_.load(std::memory_order_relaxed);
+    while (occupancy > peak &&
+           !peak_.compare_exchange_weak(peak, occupancy,
+                                        std::memory_order_relaxed)) {
+    }
+  }
+
+  void leave(double elapsed_ms) noexcept {
+    occupancy_.fetch_sub(1, std::memory_order_relaxed);
+    processed_.fetch_add(1, std::memory_order_relaxed);
+    const int64_t elapsed_ns = static_cast<int64_t>(elapsed_ms * 1e6);
+    last_ns_.store(elapsed_ns, std::memory_order_relaxed);
+    const int64_t average = average_ns_.load(std::memory_order_relaxed);
+    average_ns_.store(
+        average == 0 ? elapsed_ns : average + (elapsed_ns - average) / 8,
+        std::memory_order_relaxed);
+  }
+
+  // For a frame that entered but was abandoned.
+  void abandon() noexcept {
+    occupancy_.fetch_sub(1, std::memory_order_relaxed);
+    drops_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void drop() noexcept { drops_.fetch_add(1, std::memory_order_relaxed); }
+
+  StageStats stats() const noexcept {
+    StageStats stats{};
+    stats.occupancy = occupancy_.load(std::memory_order_relaxed);
+    stats.peak_occupancy = peak_.load(std::memory_order_relaxed);
+    stats.processed = processed_.load(std::memory_order_relaxed);
+    stats.drops = drops_.load(std::memory_order_relaxed);
+    stats.last_ms =
+        static_cast<double>(last_ns_.load(std::memory_order_relaxed)) / 1e6;
+    stats.average_ms =
+        static_cast<double>(average_ns_.load(std::memory_order_relaxed)) / 1e6;
+    return stats;
+  }
+
+ private:
+  std::atomic<uint32_t> occupancy_{0};
+  std::atomic<uint32_t> peak_{0};
+  std::atomic<uint64_t> processed_{0};
+  std::atomic<uint64_t> drops_{0};
+  std::atomic<int64_t> last_ns_{0};
+  std::atomic<int64_t> average_ns_{0};
+};
+
+}  // namespace syzygy::capture
@@ -0,0 +1,394 @@
+#include "capture/thumbnail_grabber.hpp"
+
+#include "capture/device_capabilities.hpp"
+#include "capture/mjpeg_decoder.hpp"
+#include "capture/pixel_convert.hpp"
+#include "capture/v4l2_util.hpp"
+
+#include "syzygy/clock.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <linux/videodev2.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace syzygy::capture {
+
+namespace {
+
+constexpr uint32_t kBufferCount = 2;
+// UVC cameras commonly need a few hundred milliseconds to start streaming.
+constexpr int kFrameTimeoutMs = 1500;
+constexpr int kCancelPollMs = 50;
+
+struct Mode {
+  const PixelFormatInfo* format{nullptr};
+  uint32_t width{0};
+  uint32_t height{0};
+  FrameInterval interval{};
+  double bytes_per_second{std::numeric_limits<double>::max()};
+};
+
+double interval_fps(const FrameInterval& interval) {
+  if (interval.numerator == 0 || interval.denominator == 0) {
+    return 30.0;
+  }
+  return static_cast<double>(interval.denominator) /
+         static_cast<double>(interval.numerator);
+}
+
+// The mode that costs the least on the bus: previews run next to a live
+// capture, often on the same USB controller.
+Mode cheapest_mode(const DeviceCapabilities& capabilities,
+                   uint32_t signal_width, uint32_t signal_height) {
+  Mode best{};
+  auto consider = [&](const PixelFormatInfo* format, uint32_t width,
+                      uint32_t height, FrameInterval interval) {
+    const double cost = static_cast<double>(width) * height *
+                        format->bits_per_pixel / 8.0 * interval_fps(interval);
+    if (cost < best.bytes_per_second ||
+        (cost == best.bytes_per_second &&
+         format->ns_per_pixel < best.format->ns_per_pixel)) {
+      best = Mode{format, width, height, interval, cost};
+    }
+  };
+
+  for (const auto& caps : capabilities.formats) {
+    const PixelFormatInfo* format = find_pixel_format(caps.pixel_format);
+    // Planes in separate allocations would need a second mapping per
+    // buffer; nothing that only offers those is worth it for a preview.
+    if (format == nullptr || format->memory_planes != 1 ||
+        (format->convert == nullptr && !format->compressed &&
+         !format->passthrough)) {
+      continue;
+    }
+    if (signal_width != 0) {
+      if (caps.supports_size(signal_width, signal_height)) {
+        consider(format, signal_width, signal_height, {});
+      }
+      continue;
+    }
+    for (const auto& size : caps.sizes) {
+      // The slowest interval the size offers.
+      FrameInterval slowest{};
+      for (const auto& interval : size.intervals) {
+        if (slowest.denominator == 0 ||
+            interval_fps(interval) < interval_fps(slowest)) {
+          slowest = interval;
+        }
+      }
+      consider(format, size.width, size.height, slowest);
+    }
+    if (caps.size_range) {
+      consider(format, caps.min_width, caps.min_height, {});
+    }
+  }
+  return best;
+}
+
+class Grab {
+ public:
+  explicit Grab(int fd) : fd_(fd) {}
+  ~Grab() {
+    if (streaming_) {
+      xioctl(fd_, VIDIOC_STREAMOFF, &buffer_type_);
+    }
+    for (const auto& [address, length] : mappings_) {
+      ::munmap(address, length);
+    }
+    if (requested_) {
+      v4l2_requestbuffers req{};
+      req.type = buffer_type_;
+      req.memory = V4L2_MEMORY_MMAP;
+      xioctl(fd_, VIDIOC_REQBUFS, &req);
+    }
+    ::close(fd_);
+  }
+
+  Grab(const Grab&) = delete;
+  Grab& operator=(const Grab&) = delete;
+
+  bool start(uint32_t buffer_type) {
+    buffer_type_ = buffer_type;
+    v4l2_requestbuffers req{};
+    req.type = buffer_type_;
+    req.memory = V4L2_MEMORY_MMAP;
+    req.count = kBufferCount;
+    if (!xioctl(fd_, VIDIOC_REQBUFS, &req) || req.count == 0) {
+      return false;
+    }
+    requested_ = true;
+
+    for (uint32_t index = 0; index < req.count; ++index) {
+      v4l2_buffer buffer{};
+      v4l2_plane plane{};
+      prepare(buffer, plane, index);
+      if (!xioctl(fd_, VIDIOC_QUERYBUF, &buffer)) {
+        return false;
+      }
+      const bool mplane = buffer_type_ == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+      const size_t length = mplane ? plane.length : buffer.length;
+      const off_t offset = mplane ? plane.m.mem_offset : buffer.m.offset;
+      void* address = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd_,
+                             offset);
+      if (address == MAP_FAILED) {
+        return false;
+      }
+      mappings_.emplace_back(address, length);
+      if (!xioctl(fd_, VIDIOC_QBUF, &buffer)) {
+        return false;
+      }
+    }
+
+    if (!xioctl(fd_, VIDIOC_STREAMON, &buffer_type_)) {
+      return false;
+    }
+    streaming_ = true;
+    return true;
+  }
+
+  // Waits for a frame the driver did not flag as corrupt. Returns the
+  // mapping and the payload size, or nothing on timeout.
+  std::pair<const uint8_t*, size_t> next_frame(
+      clock::TimePoint deadline, const std::atomic<bool>* cancel) {
+    for (;;) {
+      if (cancel != nullptr && cancel->load(std::memory_order_relaxed)) {
+        return {nullptr, 0};
+      }
+      const int remaining_ms = static_cast<int>(
+          std::chrono::duration_cast<std::chrono::milliseconds>(
+              deadline - clock::now())
+              .count());
+      if (remaining_ms <= 0) {
+        return {nullptr, 0};
+      }
+      pollfd pfd{fd_, POLLIN, 0};
+      const int ready =
+          ::poll(&pfd, 1, std::min(remaining_ms, kCancelPollMs));
+      if (ready == 0 || (ready < 0 && errno == EINTR)) {
+        continue;
+      }
+      if (ready <= 0 || (pfd.revents & (POLLERR | POLLHUP))) {
+        return {nullptr, 0};
+      }
+
+      v4l2_buffer buffer{};
+      v4l2_plane plane{};
+      prepare(buffer, plane, 0);
+      if (!xioctl(fd_, VIDIOC_DQBUF, &buffer)) {
+        if (errno == EAGAIN) {
+          continue;
+        }
+        return {nullptr, 0};
+      }
+      const bool mplane = buffer_type_ == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+      const size_t used = mplane ? plane.bytesused : buffer.bytesused;
+      if ((buffer.flags & V4L2_BUF_FLAG_ERROR) || used == 0 ||
+          buffer.index >= mappings_.size()) {
+        xioctl(fd_, VIDIOC_QBUF, &buffer);
+        continue;
+      }
+      return {static_cast<const uint8_t*>(mappings_[buffer.index].first),
+              used};
+    }
+  }
+
+ private:
+  void prepare(v4l2_buffer& buffer, v4l2_plane& plane, uint32_t index) const {
+    buffer.type = buffer_type_;
+    buffer.memory = V4L2_MEMORY_MMAP;
+    buffer.index = index;
+    if (buffer_type_ == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE) {
+      buffer.m.planes = &plane;
+      buffer.length = 1;
+    }
+  }
+
+  int fd_;
+  uint32_t buffer_type_{V4L2_BUF_TYPE_VIDEO_CAPTURE};
+  bool requested_{false};
+  bool streaming_{false};
+  std::vector<std::pair<void*, size_t>> mappings_;
+};
+
+ThumbnailStatus from_errno(int error) {
+  return error == EBUSY ? ThumbnailStatus::Busy : ThumbnailStatus::Failed;
+}
+
+bool shrink(const SourceImage& source, uint32_t max_width,
+            FrameSnapshot& out) {
+  const uint32_t width = std::min(max_width, source.width);
+  const uint32_t height = std::max<uint32_t>(
+      1, static_cast<uint32_t>(static_cast<uint64_t>(source.height) * width /
+                               std::max<uint32_t>(source.width, 1)));
+  FrameSnapshot snapshot{width, height, {}};
+  snapshot.rgb.resize(static_cast<size_t>(width) * height * 3);
+  if (!convert_decimated(source, snapshot.rgb.data(), width, height,
+                         width * 3)) {
+    return false;
+  }
+  out = std::move(snapshot);
+  return true;
+}
+
+}  // namespace
+
+ThumbnailResult grab_thumbnail(const std::string& path, uint32_t max_width,
+                               const std::atomic<bool>* cancel) {
+  const auto started = clock::now();
+  ThumbnailResult result{};
+  auto finish = [&](ThumbnailStatus status) {
+    result.status = status;
+    result.grab_ms = clock::milliseconds_since(started);
+    return std::move(result);
+  };
+
+  const int fd = ::open(path.c_str(), O_RDWR | O_NONBLOCK);
+  if (fd < 0) {
+    return finish(from_errno(errno));
+  }
+  Grab grab(fd);
+
+  v4l2_capability caps{};
+  if (!xioctl(fd, VIDIOC_QUERYCAP, &caps)) {
+    return finish(ThumbnailStatus::Failed);
+  }
+  const uint32_t device_caps = (caps.capabilities & V4L2_CAP_DEVICE_CAPS)
+                                   ? caps.device_caps
+                                   : caps.capabilities;
+  if (!(device_caps & V4L2_CAP_STREAMING)) {
+    return finish(ThumbnailStatus::Unsupported);
+  }
+  const uint32_t buffer_type = (device_caps & V4L2_CAP_VIDEO_CAPTURE)
+                                   ? V4L2_BUF_TYPE_VIDEO_CAPTURE
+                                   : V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+
+  const DeviceCapabilities capabilities =
+      cached_capabilities(fd, caps, buffer_type, path);
+
+  uint32_t signal_width = 0;
+  uint32_t signal_height = 0;
+  if (capabilities.dv_timings) {
+    v4l2_dv_timings timings{};
+    if (!xioctl(fd, VIDIOC_QUERY_DV_TIMINGS, &timings)) {
+      return finish(errno == ENOLINK || errno == ENOLCK || errno == ERANGE
+                        ? ThumbnailStatus::NoSignal
+                        : ThumbnailStatus::Failed);
+    }
+    if (!xioctl(fd, VIDIOC_S_DV_TIMINGS, &timings)) {
+      return finish(from_errno(errno));
+    }
+    signal_width = timings.bt.width;
+    signal_height = timings.bt.height;
+  }
+
+  const Mode mode = cheapest_mode(capabilities, signal_width, signal_height);
+  if (mode.format == nullptr) {
+    return finish(ThumbnailStatus::Unsupported);
+  }
+
+  v4l2_format fmt{};
+  fmt.type = buffer_type;
+  if (buffer_type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE) {
+    fmt.fmt.pix_mp.width = mode.width;
+    fmt.fmt.pix_mp.height = mode.height;
+    fmt.fmt.pix_mp.pixelformat = mode.format->pixel_format;
+    fmt.fmt.pix_mp.field = V4L2_FIELD_NONE;
+  } else {
+    fmt.fmt.pix.width = mode.width;
+    fmt.fmt.pix.height = mode.height;
+    fmt.fmt.pix.pixelformat = mode.format->pixel_format;
+    fmt.fmt.pix.field = V4L2_FIELD_NONE;
+  }
+  if (!xioctl(fd, VIDIOC_S_FMT, &fmt)) {
+    return finish(from_errno(errno));
+  }
+
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint32_t pixel_format = 0;
+  uint32_t bytes_per_line = 0;
+  if (buffer_type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE) {
+    width = fmt.fmt.pix_mp.width;
+    height = fmt.fmt.pix_mp.height;
+    pixel_format = fmt.fmt.pix_mp.pixelformat;
+    bytes_per_line = fmt.fmt.pix_mp.plane_fmt[0].bytesperline;
+  } else {
+    width = fmt.fmt.pix.width;
+    height = fmt.fmt.pix.height;
+    pixel_format = fmt.fmt.pix.pixelformat;
+    bytes_per_line = fmt.fmt.pix.bytesperline;
+  }
+  // The driver may have substituted its own choice.
+  const PixelFormatInfo* format = find_pixel_format(pixel_format);
+  if (format == nullptr || format->memory_planes != 1) {
+    return finish(ThumbnailStatus::Unsupported);
+  }
+
+  if (signal_width == 0 && mode.interval.denominator != 0) {
+    v4l2_streamparm parm{};
+    parm.type = buffer_type;
+    parm.parm.capture.timeperframe = {mode.interval.numerator,
+                                      mode.interval.denominator};
+    xioctl(fd, VIDIOC_S_PARM, &parm);
+  }
+
+  if (!grab.start(buffer_type)) {
+    return finish(from_errno(errno));
+  }
+  const auto [data, size] = grab.next_frame(
+      clock::now() + std::chrono::milliseconds(kFrameTimeoutMs), cancel);
+  if (data == nullptr) {
+    return finish(ThumbnailStatus::Failed);
+  }
+
+  if (format->compressed) {
+    FrameSnapshot decoded;
+    if (!MjpegDecoder::decode_scaled(data, size, max_width, decoded)) {
+      return finish(ThumbnailStatus::Failed);
+    }
+    if (decoded.width <= max_width) {
+      result.image = std::move(decoded);
+      return finish(ThumbnailStatus::Ok);
+    }
+    SourceImage source{V4L2_PIX_FMT_RGB24, decoded.width, decoded.height, {}};
+    source.planes[0] = {decoded.rgb.data(), decoded.width * 3};
+    return finish(shrink(source, max_width, result.image)
+                      ? ThumbnailStatus::Ok
+                      : ThumbnailStatus::Failed);
+  }
+
+  if (size < contiguous_frame_bytes(*format, height, bytes_per_line)) {
+    return finish(ThumbnailStatus::Failed);
+  }
+  const SourceImage source =
+      describe_contiguous(*format, data, width, height, bytes_per_line);
+  return finish(shrink(source, max_width, result.image)
+                    ? ThumbnailStatus::Ok
+                    : ThumbnailStatus::Unsupported);
+}
+
+std::string_view to_string(ThumbnailStatus status) {
+  switch (status) {
+    case ThumbnailStatus::Ok:
+      return "ok";
+    case ThumbnailStatus::NoSignal:
+      return "no signal";
+    case ThumbnailStatus::Busy:
+      return "busy";
+    case ThumbnailStatus::Unsupported:
+      return "unsupported";
+    case ThumbnailStatus::Failed:
+      break;
+  }
+  return "failed";
+}
+
+}  // namespace syzygy::capture
@@ -0,0 +1,40 @@
+#pragma once
+
+// Copyright (c) 2025 Zoe Gates <zoe@zeocities.dev>
+//
+// One-shot preview capture from a device nobody is streaming from: open,
+// pick the cheapest mode on the wire, take a single good frame and shrink
+// it to a thumbnail. Everything is torn down again before returning.
+
+#include "capture/frame_snapshot.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace syzygy::capture {
+
+enum class ThumbnailStatus {
+  Ok,
+  NoSignal,     // HDMI receiver without a locked input.
+  Busy,         // Another process is streaming from the node.
+  Unsupported,  // No format the preview path can convert.
+  Failed
+};
+
+struct ThumbnailResult {
+  ThumbnailStatus status{ThumbnailStatus::Failed};
+  FrameSnapshot image;
+  // Wall time the grab took, for logging.
+  double grab_ms{0.0};
+};
+
+// Blocks for at most a couple of seconds. The thumbnail is no wider than
+// `max_width`. Setting `cancel` ends the wait for a frame early.
+ThumbnailResult grab_thumbnail(const std::string& path, uint32_t max_width,
+                               const std::atomic<bool>* cancel = nullptr);
+
+std::string_view to_string(ThumbnailStatus status);
+
+}  // namespace syzygy::capture
@@ -0,0 +1,294 @@
+#include "capture/thumbnail_service.hpp"
+
+#include "util/thread_pool.hpp"
+
+#include "syzygy/clock.hpp"
+#include "syzygy/log.hpp"
+
+#include <algorithm>
+#include <ctime>
+
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace syzygy::capture {
+
+namespace {
+
+constexpr size_t kWorkers = 2;
+// With a live session only one preview device streams at a time.
+constexpr uint32_t kMaxInFlightIdle = 2;
+constexpr uint32_t kMaxInFlightActive = 1;
+constexpr auto kRefreshInterval = std::chrono::seconds(2);
+// Busy, unplugged or signal-less devices are not worth a retry every pass.
+constexpr auto kRetryInterval = std::chrono::seconds(10);
+// Share of one core all previews together may use.
+constexpr double kCpuBudget = 0.02;
+constexpr int kWorkerNice = 10;
+
+// "usb-0000:00:14.0-3.2" -> "usb-0000:00:14.0". Empty for anything that is
+// not USB; PCIe capture cards each have their own lanes.
+std::string usb_controller(const std::string& bus) {
+  if (bus.rfind("usb-", 0) != 0) {
+    return {};
+  }
+  return bus.substr(0, bus.find('-', 4));
+}
+
+double thread_cpu_ms() {
+  timespec ts{};
+  ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return static_cast<double>(ts.tv_sec) * 1e3 +
+         static_cast<double>(ts.tv_nsec) / 1e6;
+}
+
+void lower_thread_priority() {
+  thread_local bool lowered = false;
+  if (lowered) {
+    return;
+  }
+  lowered = true;
+  // Linux applies the nice value per thread.
+  const auto tid = static_cast<id_t>(::syscall(SYS_gettid));
+  if (::setpriority(PRIO_PROCESS, tid, kWorkerNice) != 0) {
+    syzygy::log::warn("ThumbnailService: unable to lower worker priority");
+  }
+}
+
+}  // namespace
+
+void GrabTracker::begin(const std::string& path) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  busy_.push_back(path);
+}
+
+void GrabTracker::end(const std::string& path) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto it = std::find(busy_.begin(), busy_.end(), path);
+  if (it != busy_.end()) {
+    busy_.erase(it);
+  }
+  cv_.notify_all();
+}
+
+bool GrabTracker::wait_released(const std::string& path,
+                                std::chrono::milliseconds timeout) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  const bool released = cv_.wait_for(lock, timeout, [&]() {
+    return std::find(busy_.begin(), busy_.end(), path) == busy_.end();
+  });
+  if (!released) {
+    syzygy::log::warn("GrabTracker: preview grab still holds", path);
+  }
+  return released;
+}
+
+ThumbnailService::ThumbnailService(uint32_t max_width, Callback callback)
+    : max_width_(max_width),
+      callback_(std::move(callback)),
+      grabs_(std::make_shared<GrabTracker>()),
+      pool_(std::make_unique<util::ThreadPool>(kWorkers)) {
+  thread_ = std::thread([this]() { run(); });
+}
+
+ThumbnailService::~ThumbnailService() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  cv_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  // Lets grabs already running finish; queued ones see stopping_.
+  pool_.reset();
+}
+
+void ThumbnailService::set_devices(const std::vector<CaptureDevice>& devices) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<Entry> entries;
+    entries.reserve(devices.size());
+    for (const auto& device : devices) {
+      const auto existing =
+          std::find_if(entries_.begin(), entries_.end(),
+                       [&](const Entry& e) { return e.path == device.path; });
+      if (existing != entries_.end()) {
+        entries.push_back(*existing);
+      } else {
+        Entry entry;
+        entry.path = device.path;
+        entry.controller = usb_controller(device.bus);
+        entry.cancel = std::make_shared<std::atomic<bool>>(false);
+        entries.push_back(std::move(entry));
+      }
+    }
+    // In-flight grabs for devices that went away still count until they
+    // return.
+    entries_ = std::move(entries);
+    active_controller_.clear();
+    for (const auto& entry : entries_) {
+      if (entry.path == active_path_) {
+        active_controller_ = entry.controller;
+      }
+    }
+  }
+  cv_.notify_all();
+}
+
+void ThumbnailService::set_active_device(const std::string& path) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    active_path_ = path;
+    active_controller_.clear();
+    for (const auto& entry : entries_) {
+      if (entry.path == path) {
+        active_controller_ = entry.controller;
+        entry.cancel->store(true, std::memory_order_relaxed);
+      }
+    }
+  }
+  cv_.notify_all();
+}
+
+void ThumbnailService::set_enabled(bool enabled) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    enabled_ = enabled;
+    if (!enabled) {
+      for (const auto& entry : entries_) {
+        if (entry.in_flight) {
+          entry.cancel->store(true, std::memory_order_relaxed);
+        }
+      }
+    }
+  }
+  cv_.notify_all();
+}
+
+uint32_t ThumbnailService::in_flight_limit() const {
+  return active_path_.empty() ? kMaxInFlightIdle : kMaxInFlightActive;
+}
+
+bool ThumbnailService::schedulable(const Entry& entry) const {
+  if (entry.in_flight || entry.path == active_path_) {
+    return false;
+  }
+  return active_path_.empty() || entry.controller.empty() ||
+         entry.controller != active_controller_;
+}
+
+ThumbnailService::Entry* ThumbnailService::next_due(
+    syzygy::clock::TimePoint now) {
+  if (in_flight_ >= in_flight_limit() || now < resume_at_) {
+    return nullptr;
+  }
+  Entry* next = nullptr;
+  for (auto& entry : entries_) {
+    if (!schedulable(entry) || entry.due > now) {
+      continue;
+    }
+    if (next == nullptr || entry.due < next->due) {
+      next = &entry;
+    }
+  }
+  return next;
+}
+
+void ThumbnailService::run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stopping_) {
+    if (!enabled_) {
+      cv_.wait(lock);
+      continue;
+    }
+    const auto now = syzygy::clock::now();
+    if (Entry* entry = next_due(now)) {
+      entry->in_flight = true;
+      entry->cancel->store(false, std::memory_order_relaxed);
+      in_flight_++;
+      grabs_->begin(entry->path);
+      pool_->enqueue([this, path = entry->path, cancel = entry->cancel]() {
+        grab(path, cancel);
+      });
+      continue;
+    }
+
+    // A finishing grab notifies; nothing else can free a slot.
+    if (in_flight_ >= in_flight_limit()) {
+      cv_.wait(lock);
+      continue;
+    }
+    // Sleep until the earliest entry next_due() could pick. Skipped
+    // entries (the live device, its controller) stay overdue and must not
+    // count, or this would spin.
+    auto wake = now + kRefreshInterval;
+    for (const auto& entry : entries_) {
+      if (schedulable(entry)) {
+        wake = std::min(wake, entry.due);
+      }
+    }
+    cv_.wait_until(lock, std::max(wake, resume_at_));
+  }
+}
+
+void ThumbnailService::grab(const std::string& path,
+                            std::shared_ptr<std::atomic<bool>> cancel) {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (stopping_ || !enabled_ || cancel->load(std::memory_order_relaxed)) {
+      for (auto& entry : entries_) {
+        if (entry.path == path) {
+          entry.in_flight = false;
+        }
+      }
+      in_flight_--;
+      lock.unlock();
+      grabs_->end(path);
+      cv_.notify_all();
+      return;
+    }
+  }
+
+  lower_thread_priority();
+  const double cpu_before = thread_cpu_ms();
+  ThumbnailResult result = grab_thumbnail(path, max_width_, cancel.get());
+  const double cpu_ms = thread_cpu_ms() - cpu_before;
+  const ThumbnailStatus status = result.status;
+  const double grab_ms = result.grab_ms;
+
+  if (callback_ && !cancel->load(std::memory_order_relaxed)) {
+    callback_(path, std::move(result));
+  }
+
+  bool status_changed = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto now = syzygy::clock::now();
+    for (auto& entry : entries_) {
+      if (entry.path != path) {
+        continue;
+      }
+      entry.in_flight = false;
+      entry.due = now + (status == ThumbnailStatus::Ok ? kRefreshInterval
+                                                       : kRetryInterval);
+      status_changed = entry.last_status != status;
+      entry.last_status = status;
+    }
+    in_flight_--;
+    const auto gap = std::chrono::duration_cast<
+        syzygy::clock::Clock::duration>(
+        std::chrono::duration<double, std::milli>(cpu_ms / kCpuBudget));
+    resume_at_ = std::max(resume_at_, now + gap);
+  }
+  grabs_->end(path);
+  cv_.notify_all();
+
+  if (status_changed) {
+    syzygy::log::info("ThumbnailService:", path, to_string(status), "in",
+                      grab_ms, "ms,", cpu_ms, "ms CPU");
+  }
+}
+
+}  // namespace syzygy::capture
@@ -0,0 +1,110 @@
+#pragma once
+
+// Copyright (c) 2025 Zoe Gates <zoe@zeocities.dev>
+//
+// Keeps a low-rate preview of every capture device that is not the one
+// being watched. Grabs run one frame at a time on a small, low-priority
+// pool and are spaced out so their CPU time stays within a fixed share of
+// one core. While a session is live, devices behind the same USB host
+// controller are left alone so previews never take its bandwidth.
+
+#include "capture/capture_device.hpp"
+#include "capture/thumbnail_grabber.hpp"
+
+#include "syzygy/clock.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace syzygy::util {
+class ThreadPool;
+}
+
+namespace syzygy::capture {
+
+// Which device nodes preview grabs hold open. Shared with whoever starts
+// sessions, so opening a device can wait for its grab on a worker thread
+// and outlive the service.
+class GrabTracker {
+ public:
+  // A grab that has seen its cancel flag finishes within one
+  // open/S_FMT/STREAMOFF cycle, plus a probe on a cache miss.
+  static constexpr std::chrono::milliseconds kReleaseTimeout{3000};
+
+  void begin(const std::string& path);
+  void end(const std::string& path);
+  // False when a grab still holds `path` after `timeout`.
+  bool wait_released(const std::string& path,
+                     std::chrono::milliseconds timeout = kReleaseTimeout);
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::vector<std::string> busy_;
+};
+
+class ThumbnailService {
+ public:
+  // Fires on a pool thread; UI code must marshal the result itself.
+  using Callback =
+      std::function<void(const std::string& path, ThumbnailResult result)>;
+
+  ThumbnailService(uint32_t max_width, Callback callback);
+  ~ThumbnailService();
+
+  ThumbnailService(const ThumbnailService&) = delete;
+  ThumbnailService& operator=(const ThumbnailService&) = delete;
+
+  void set_devices(const std::vector<CaptureDevice>& devices);
+  // The device the live session streams from, or "" when none is running.
+  // Call before opening it: cancels a preview grab of that device, which
+  // the opener then waits out with grabs()->wait_released().
+  void set_active_device(const std::string& path);
+  // Disabling cancels the grabs in flight.
+  void set_enabled(bool enabled);
+  const std::shared_ptr<GrabTracker>& grabs() const noexcept { return grabs_; }
+
+ private:
+  struct Entry {
+    std::string path;
+    std::string controller;
+    syzygy::clock::TimePoint due{};
+    bool in_flight{false};
+    std::shared_ptr<std::atomic<bool>> cancel;
+    ThumbnailStatus last_status{ThumbnailStatus::Ok};
+  };
+
+  void run();
+  void grab(const std::string& path,
+            std::shared_ptr<std::atomic<bool>> cancel);
+  // These require mutex_.
+  uint32_t in_flight_limit() const;
+  // Whether the entry may be grabbed once due, ignoring the CPU gap.
+  bool schedulable(const Entry& entry) const;
+  // Next entry allowed to run now.
+  Entry* next_due(syzygy::clock::TimePoint now);
+
+  const uint32_t max_width_;
+  Callback callback_;
+  std::shared_ptr<GrabTracker> grabs_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::vector<Entry> entries_;
+  std::string active_path_;
+  std::string active_controller_;
+  syzygy::clock::TimePoint resume_at_{};
+  uint32_t in_flight_{0};
+  bool enabled_{false};
+  bool stopping_{false};
+  std::unique_ptr<util::ThreadPool> pool_;
+  std::thread thread_;
+};
+
+}  // namespace syzygy::capture
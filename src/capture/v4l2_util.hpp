@@ -0,0 +1,32 @@
+#pragma once
+
+// Copyright (c) 2025 Zoe Gates <zoe@zeocities.dev>
+//
+// Small helpers shared by the V4L2 capture code.
+
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <string>
+#include <sys/ioctl.h>
+
+namespace syzygy::capture {
+
+inline bool xioctl(int fd, unsigned long request, void* arg) {
+  int r;
+  do {
+    r = ioctl(fd, request, arg);
+  } while (r == -1 && errno == EINTR);
+  return r != -1;
+}
+
+inline std::string fourcc_to_string(uint32_t code) {
+  std::array<char, 5> fourcc{};
+  fourcc[0] = static_cast<char>(code & 0xFF);
+  fourcc[1] = static_cast<char>((code >> 8) & 0xFF);
+  fourcc[2] = static_cast<char>((code >> 16) & 0xFF);
+  fourcc[3] = static_cast<char>((code >> 24) & 0xFF);
+  return std::string(fourcc.data());
+}
+
+}  // namespace syzygy::capture
@@ -1,30 +1,31 @@
 #include "settings/settings_manager.hpp"
 
+#include "util/paths.hpp"
+
 #include "syzygy/log.hpp"
 
 #include <cmath>
-#include <cstdlib>
 #include <fstream>
 #include <sstream>
+#include <string_view>
 
 namespace syzygy::settings {
 
 namespace {
 
-std::filesystem::path config_directory() {
-  if (const char* xdg = std::getenv("XDG_CONFIG_HOME")) {
-    return std::filesystem::path(xdg) / "syzygy";
-  }
-  if (const char* home = std::getenv("HOME")) {
-    return std::filesystem::path(home) / ".config" / "syzygy";
-  }
-  return std::filesystem::temp_directory_path() / "syzygy";
+constexpr std::string_view kEdidProfilePrefix = "edid_profile.";
+constexpr std::string_view kModePolicyPrefix = "mode_policy.";
+
+std::string lookup(const std::map<std::string, std::string>& values,
+                   const std::string& key) {
+  const auto it = values.find(key);
+  return it == values.end() ? std::string{} : it->second;
 }
 
 }  // namespace
 
 SettingsManager::SettingsManager() {
-  config_path_ = config_directory() / "config.ini";
+  config_path_ = util::config_directory() / "config.ini";
   load();
 }
 
@@ -53,6 +54,20 @@ void SettingsManager::load() {
       data_.last_video_device = value;
     } else if (key == "audio_gain") {
       data_.audio_gain = std::stod(value);
+    } else if (key == "userptr_capture") {
+      data_.userptr_capture = value == "1";
+    } else if (key == "newest_only") {
+      data_.newest_only = value == "1";
+    } else if (key == "thumbnails") {
+      data_.thumbnails = value == "1";
+    } else if (key == "latency_preset") {
+      if (const auto preset = capture::latency_preset_from_string(value)) {
+        data_.latency_preset = *preset;
+      }
+    } else if (key.rfind(kEdidProfilePrefix, 0) == 0) {
+      data_.edid_profiles[key.substr(kEdidProfilePrefix.size())] = value;
+    } else if (key.rfind(kModePolicyPrefix, 0) == 0) {
+      data_.mode_policies[key.substr(kModePolicyPrefix.size())] = value;
     }
   }
 }
@@ -65,6 +80,17 @@ void SettingsManager::save() const {
   }
   output << "last_video_device=" << data_.last_video_device << "\n";
   output << "audio_gain=" << data_.audio_gain << "\n";
+  output << "userptr_capture=" << (data_.userptr_capture ? 1 : 0) << "\n";
+  output << "newest_only=" << (data_.newest_only ? 1 : 0) << "\n";
+  output << "thumbnails=" << (data_.thumbnails ? 1 : 0) << "\n";
+  output << "latency_preset=" << capture::to_string(data_.latency_preset)
+         << "\n";
+  for (const auto& [device, profile] : data_.edid_profiles) {
+    output << kEdidProfilePrefix << device << "=" << profile << "\n";
+  }
+  for (const auto& [device, policy] : data_.mode_policies) {
+    output << kModePolicyPrefix << device << "=" << policy << "\n";
+  }
 }
 
 void SettingsManager::set_last_video_device(const std::string& device_path) {
@@ -83,4 +109,58 @@ void SettingsManager::set_audio_gain(double gain) {
   save();
 }
 
+void SettingsManager::set_userptr_capture(bool enabled) {
+  if (data_.userptr_capture == enabled) {
+    return;
+  }
+  data_.userptr_capture = enabled;
+  save();
+}
+
+void SettingsManager::set_latency_preset(capture::LatencyPreset preset) {
+  if (data_.latency_preset == preset) {
+    return;
+  }
+  data_.latency_preset = preset;
+  save();
+}
+
+void SettingsManager::set_thumbnails(bool enabled) {
+  if (data_.thumbnails == enabled) {
+    return;
+  }
+  data_.thumbnails = enabled;
+  save();
+}
+
+void SettingsManager::set_edid_profile(const std::string& device_key,
+                                       const std::string& profile_id) {
+  if (edid_profile(device_key) == profile_id) {
+    return;
+  }
+  if (profile_id.empty()) {
+    data_.edid_profiles.erase(device_key);
+  } else {
+    data_.edid_profiles[device_key] = profile_id;
+  }
+  save();
+}
+
+std::string SettingsManager::edid_profile(const std::string& device_key) const {
+  return lookup(data_.edid_profiles, device_key);
+}
+
+void SettingsManager::set_mode_policy(const std::string& device_key,
+                                      const std::string& policy) {
+  if (mode_policy(device_key) == policy) {
+    return;
+  }
+  data_.mode_policies[device_key] = policy;
+  save();
+}
+
+std::string SettingsManager::mode_policy(const std::string& device_key) const {
+  return lookup(data_.mode_policies, device_key);
+}
+
 }  // namespace syzygy::settings
@@ -5,6 +5,7 @@
 #include "capture/capture_device.hpp"
 
 #include <filesystem>
+#include <map>
 #include <optional>
 #include <string>
 
@@ -13,6 +14,15 @@ namespace syzygy::settings {
 struct SettingsData {
   std::string last_video_device;
   double audio_gain{1.0};
+  bool userptr_capture{false};
+  capture::LatencyPreset latency_preset{capture::LatencyPreset::Adaptive};
+  bool newest_only{false};
+  // Live previews of the other devices in the device picker.
+  bool thumbnails{true};
+  // EDID profile id per device, keyed by bus info.
+  std::map<std::string, std::string> edid_profiles;
+  // Mode selection policy name per device, keyed like edid_profiles.
+  std::map<std::string, std::string> mode_policies;
 };
 
 class SettingsManager {
@@ -23,6 +33,16 @@ class SettingsManager {
 
   void set_last_video_device(const std::string& device_path);
   void set_audio_gain(double gain);
+  void set_userptr_capture(bool enabled);
+  void set_latency_preset(capture::LatencyPreset preset);
+  void set_thumbnails(bool enabled);
+  // An empty profile leaves the card's EDID alone.
+  void set_edid_profile(const std::string& device_key,
+                        const std::string& profile_id);
+  std::string edid_profile(const std::string& device_key) const;
+  void set_mode_policy(const std::string& device_key,
+                       const std::string& policy);
+  std::string mode_policy(const std::string& device_key) const;
 
  private:
   void load();
@@ -0,0 +1,85 @@
+#include "util/hugepage_arena.hpp"
+
+#include "syzygy/log.hpp"
+
+#include <linux/mman.h>
+#include <sys/mman.h>
+
+#include <cerrno>
+#include <cstring>
+
+namespace syzygy::util {
+
+namespace {
+
+constexpr size_t kPageSize = 4096;
+
+size_t round_up(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+}  // namespace
+
+HugepageArena::HugepageArena(size_t bytes, bool lock_memory) {
+  if (bytes == 0) {
+    return;
+  }
+  capacity_ = round_up(bytes, kHugePageSize);
+
+  // Explicit hugetlbfs pages first; they only exist if the admin reserved
+  // them via vm.nr_hugepages.
+  void* mapping =
+      mmap(nullptr, capacity_, PROT_READ | PROT_WRITE,
+           MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_HUGE_2MB |
+               MAP_POPULATE,
+           -1, 0);
+  if (mapping != MAP_FAILED) {
+    mapping_ = mapping;
+    mapping_bytes_ = capacity_;
+    base_ = static_cast<uint8_t*>(mapping);
+    hugetlb_ = true;
+  } else {
+    // Fall back to transparent hugepages on a 2 MB aligned window.
+    mapping_bytes_ = capacity_ + kHugePageSize;
+    mapping = mmap(nullptr, mapping_bytes_, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+      syzygy::log::warn("HugepageArena: mmap failed", std::strerror(errno));
+      mapping_bytes_ = 0;
+      capacity_ = 0;
+      return;
+    }
+    mapping_ = mapping;
+    const auto address = reinterpret_cast<uintptr_t>(mapping);
+    base_ = reinterpret_cast<uint8_t*>(round_up(address, kHugePageSize));
+    madvise(base_, capacity_, MADV_HUGEPAGE);
+    for (size_t offset = 0; offset < capacity_; offset += kPageSize) {
+      base_[offset] = 0;
+    }
+  }
+
+  if (lock_memory) {
+    if (mlock(base_, capacity_) == 0) {
+      locked_ = true;
+    } else {
+      syzygy::log::warn("HugepageArena: mlock failed", std::strerror(errno));
+    }
+  }
+}
+
+HugepageArena::~HugepageArena() {
+  if (mapping_) {
+    munmap(mapping_, mapping_bytes_);
+  }
+}
+
+uint8_t* HugepageArena::allocate(size_t bytes, size_t alignment) {
+  const size_t offset = round_up(used_, alignment);
+  if (!base_ || offset + bytes > capacity_) {
+    return nullptr;
+  }
+  used_ = offset + bytes;
+  return base_ + offset;
+}
+
+}  // namespace syzygy::util
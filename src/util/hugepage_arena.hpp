@@ -0,0 +1,43 @@
+#pragma once
+
+// Copyright (c) 2025 Zoe Gates <zoe@zeocities.dev>
+//
+// Bump allocator over a 2 MB hugepage-backed mapping. The mapping is
+// prefaulted up front (and optionally mlock'ed) so no allocation from it
+// ever takes a page fault on the streaming path.
+
+#include <cstddef>
+#include <cstdint>
+
+namespace syzygy::util {
+
+class HugepageArena {
+ public:
+  static constexpr size_t kHugePageSize = 2 * 1024 * 1024;
+
+  HugepageArena(size_t bytes, bool lock_memory);
+  ~HugepageArena();
+
+  HugepageArena(const HugepageArena&) = delete;
+  HugepageArena& operator=(const HugepageArena&) = delete;
+
+  // Returns nullptr once the arena is exhausted.
+  uint8_t* allocate(size_t bytes, size_t alignment = 4096);
+
+  bool valid() const noexcept { return base_ != nullptr; }
+  size_t capacity() const noexcept { return capacity_; }
+  size_t used() const noexcept { return used_; }
+  bool hugetlb() const noexcept { return hugetlb_; }
+  bool locked() const noexcept { return locked_; }
+
+ private:
+  void* mapping_{nullptr};
+  size_t mapping_bytes_{0};
+  uint8_t* base_{nullptr};
+  size_t capacity_{0};
+  size_t used_{0};
+  bool hugetlb_{false};
+  bool locked_{false};
+};
+
+}  // namespace syzygy::util
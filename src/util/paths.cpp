@@ -0,0 +1,27 @@
+#include "util/paths.hpp"
+
+#include <cstdlib>
+
+namespace syzygy::util {
+
+std::filesystem::path config_directory() {
+  if (const char* xdg = std::getenv("XDG_CONFIG_HOME")) {
+    return std::filesystem::path(xdg) / "syzygy";
+  }
+  if (const char* home = std::getenv("HOME")) {
+    return std::filesystem::path(home) / ".config" / "syzygy";
+  }
+  return std::filesystem::temp_directory_path() / "syzygy";
+}
+
+std::filesystem::path cache_directory() {
+  if (const char* xdg = std::getenv("XDG_CACHE_HOME")) {
+    return std::filesystem::path(xdg) / "syzygy";
+  }
+  if (const char* home = std::getenv("HOME")) {
+    return std::filesystem::path(home) / ".cache" / "syzygy";
+  }
+  return std::filesystem::temp_directory_path() / "syzygy";
+}
+
+}  // namespace syzygy::util
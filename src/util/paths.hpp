@@ -0,0 +1,17 @@
+#pragma once
+
+// Copyright (c) 2025 Zoe Gates <zoe@zeocities.dev>
+//
+// XDG base directories for Syzygy's own files.
+
+#include <filesystem>
+
+namespace syzygy::util {
+
+// $XDG_CONFIG_HOME/syzygy, falling back to ~/.config/syzygy.
+std::filesystem::path config_directory();
+
+// $XDG_CACHE_HOME/syzygy, falling back to ~/.cache/syzygy.
+std::filesystem::path cache_directory();
+
+}  // namespace syzygy::util
@@ -0,0 +1,70 @@
+#pragma once
+
+// Copyright (c) 2025 Zoe Gates <zoe@zeocities.dev>
+//
+// Single-writer sequence lock for small trivially copyable snapshots. The
+// writer never blocks; readers retry while a write is in progress. The
+// payload is stored as relaxed atomic words so torn reads are detected
+// rather than being data races.
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace syzygy::util {
+
+template <typename T>
+class Seqlock {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "Seqlock payloads are copied word by word");
+
+ public:
+  Seqlock() { store(T{}); }
+
+  Seqlock(const Seqlock&) = delete;
+  Seqlock& operator=(const Seqlock&) = delete;
+
+  // Writer side; one thread only.
+  void store(const T& value) noexcept {
+    std::array<uint64_t, kWords> words{};
+    std::memcpy(words.data(), &value, sizeof(T));
+
+    const uint32_t sequence = sequence_.load(std::memory_order_relaxed);
+    sequence_.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < kWords; ++i) {
+      words_[i].store(words[i], std::memory_order_relaxed);
+    }
+    sequence_.store(sequence + 2, std::memory_order_release);
+  }
+
+  T load() const noexcept {
+    std::array<uint64_t, kWords> words{};
+    for (;;) {
+      const uint32_t before = sequence_.load(std::memory_order_acquire);
+      if (before & 1) {
+        continue;
+      }
+      for (size_t i = 0; i < kWords; ++i) {
+        words[i] = words_[i].load(std::memory_order_relaxed);
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (sequence_.load(std::memory_order_relaxed) == before) {
+        break;
+      }
+    }
+    T value;
+    std::memcpy(static_cast<void*>(&value), words.data(), sizeof(T));
+    return value;
+  }
+
+ private:
+  static constexpr size_t kWords = (sizeof(T) + 7) / 8;
+
+  std::atomic<uint32_t> sequence_{0};
+  std::array<std::atomic<uint64_t>, kWords> words_{};
+};
+
+}  // namespace syzygy::util
@@ -0,0 +1,111 @@
+#pragma once
+
+// Copyright (c) 2025 Zoe Gates <zoe@zeocities.dev>
+//
+// Bounded lock-free single-producer/single-consumer ring. Neither side takes
+// a lock; the consumer can sleep on the ring with wait() until the producer
+// pushes or close() is called.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+namespace syzygy::util {
+
+template <typename T>
+class SpscQueue {
+ public:
+  // Capacity is rounded up to a power of two.
+  explicit SpscQueue(size_t capacity)
+      : capacity_(round_up(capacity)),
+        mask_(capacity_ - 1),
+        slots_(std::make_unique<T[]>(capacity_)) {}
+
+  SpscQueue(const SpscQueue&) = delete;
+  SpscQueue& operator=(const SpscQueue&) = delete;
+
+  size_t capacity() const noexcept { return capacity_; }
+
+  size_t size() const noexcept {
+    return static_cast<size_t>(tail_.load(std::memory_order_acquire) -
+                               head_.load(std::memory_order_acquire));
+  }
+
+  // Producer side. Leaves `value` untouched when the ring is full.
+  bool try_push(T& value) {
+    const uint64_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) >= capacity_) {
+      return false;
+    }
+    slots_[tail & mask_] = std::move(value);
+    tail_.store(tail + 1, std::memory_order_release);
+    wake(false);
+    return true;
+  }
+
+  // Consumer side.
+  std::optional<T> try_pop() {
+    const uint64_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return std::nullopt;
+    }
+    std::optional<T> value(std::move(slots_[head & mask_]));
+    slots_[head & mask_] = T{};
+    head_.store(head + 1, std::memory_order_release);
+    return value;
+  }
+
+  // Consumer side: blocks until an item is available or the queue is
+  // closed. Returns false once closed and drained.
+  bool wait() {
+    for (;;) {
+      // Read the wake counter first so a push racing the checks below
+      // still ends the wait.
+      const uint32_t seen = wakeups_.load(std::memory_order_acquire);
+      if (tail_.load(std::memory_order_acquire) !=
+          head_.load(std::memory_order_relaxed)) {
+        return true;
+      }
+      if (closed_.load(std::memory_order_acquire)) {
+        return false;
+      }
+      wakeups_.wait(seen, std::memory_order_acquire);
+    }
+  }
+
+  // Wakes the consumer for good; items already pushed can still be popped.
+  void close() {
+    closed_.store(true, std::memory_order_release);
+    wake(true);
+  }
+
+ private:
+  void wake(bool all) {
+    wakeups_.fetch_add(1, std::memory_order_release);
+    if (all) {
+      wakeups_.notify_all();
+    } else {
+      wakeups_.notify_one();
+    }
+  }
+
+  static size_t round_up(size_t value) {
+    size_t capacity = 1;
+    while (capacity < value) {
+      capacity <<= 1;
+    }
+    return capacity;
+  }
+
+  const size_t capacity_;
+  const size_t mask_;
+  std::unique_ptr<T[]> slots_;
+  alignas(64) std::atomic<uint64_t> head_{0};
+  alignas(64) std::atomic<uint64_t> tail_{0};
+  std::atomic<uint32_t> wakeups_{0};
+  std::atomic<bool> closed_{false};
+};
+
+}  // namespace syzygy::util
@@ -0,0 +1,73 @@
+#pragma once
+
+// Copyright (c) 2025 Zoe Gates <zoe@zeocities.dev>
+//
+// Wait-free single-producer/single-consumer mailbox. The producer fills the
+// back slot and publishes it; the consumer always reads the freshest slot
+// without copying or blocking the producer.
+
+#include <atomic>
+#include <cstdint>
+
+namespace syzygy::util {
+
+template <typename T>
+class TripleBuffer {
+ public:
+  TripleBuffer() = default;
+
+  TripleBuffer(const TripleBuffer&) = delete;
+  TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+  // Producer side: the slot to fill before calling publish().
+  T& write_slot() noexcept { return slots_[back_]; }
+
+  void publish() noexcept {
+    const uint8_t previous =
+        middle_.exchange(static_cast<uint8_t>(back_ | kFreshBit),
+                         std::memory_order_acq_rel);
+    back_ = previous & kIndexMask;
+    generation_.fetch_add(1, std::memory_order_release);
+  }
+
+  // Consumer side: swaps in the newest published slot if there is one. The
+  // returned pointer stays valid until the next read() or reset().
+  const T* read() noexcept {
+    if (middle_.load(std::memory_order_relaxed) & kFreshBit) {
+      const uint8_t previous =
+          middle_.exchange(front_, std::memory_order_acq_rel);
+      front_ = previous & kIndexMask;
+      has_front_ = true;
+    }
+    return has_front_ ? &slots_[front_] : nullptr;
+  }
+
+  // Bumped on every publish so readers can skip work when nothing changed.
+  uint64_t generation() const noexcept {
+    return generation_.load(std::memory_order_acquire);
+  }
+
+  // Drops every slot. Only safe while neither side is active.
+  void reset() {
+    for (auto& slot : slots_) {
+      slot = T{};
+    }
+    back_ = 0;
+    front_ = 1;
+    middle_.store(2, std::memory_order_relaxed);
+    has_front_ = false;
+  }
+
+ private:
+  static constexpr uint8_t kFreshBit = 0x4;
+  static constexpr uint8_t kIndexMask = 0x3;
+
+  T slots_[3]{};
+  alignas(64) uint8_t back_{0};
+  alignas(64) uint8_t front_{1};
+  bool has_front_{false};
+  alignas(64) std::atomic<uint8_t> middle_{2};
+  std::atomic<uint64_t> generation_{0};
+};
+
+}  // namespace syzygy::util